@@ -515,6 +515,26 @@ size_t HardwareSerial::readBytes(uint8_t *buffer, size_t length)
     return uartReadBytes(_uart, buffer, length, (uint32_t)getTimeout());
 }
 
+bool HardwareSerial::hasPeekBufferAPI() const
+{
+    return true;
+}
+
+size_t HardwareSerial::peekAvailable()
+{
+    return uartPeekAvailable(_uart);
+}
+
+const char* HardwareSerial::peekBuffer()
+{
+    return (const char*)uartPeekBuffer(_uart);
+}
+
+void HardwareSerial::peekConsume(size_t size)
+{
+    uartPeekConsume(_uart, size);
+}
+
 void HardwareSerial::flush(void)
 {
     uartFlush(_uart);
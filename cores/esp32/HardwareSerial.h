@@ -124,6 +124,11 @@ public:
     {
         return readBytes((uint8_t *) buffer, length);
     }
+    // buffered source interface, serves the UART RX staging buffer
+    bool hasPeekBufferAPI() const;
+    size_t peekAvailable();
+    const char* peekBuffer();
+    void peekConsume(size_t size);
     void flush(void);
     void flush( bool txOnly);
     size_t write(uint8_t);
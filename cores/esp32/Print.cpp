@@ -32,6 +32,210 @@ extern "C" {
     #include "time.h"
 }
 
+// Formatter ///////////////////////////////////////////////////////////////////
+
+// printf() output is collected in a small stack buffer and handed to write()
+// in chunks, so neither the formatted length nor the heap matters
+#ifndef PRINTF_CHUNK_SIZE
+#define PRINTF_CHUNK_SIZE 64
+#endif
+
+namespace {
+
+class PrintChunker
+{
+public:
+    PrintChunker(Print &out) : _out(out), _len(0), _written(0) {}
+
+    void put(char c)
+    {
+        if(_len == sizeof(_buf)) {
+            flush();
+        }
+        _buf[_len++] = c;
+    }
+
+    void put(const char *data, size_t len)
+    {
+        if(len > sizeof(_buf) - _len) {
+            flush();
+            if(len >= sizeof(_buf)) {
+                _written += _out.write((const uint8_t *) data, len);
+                return;
+            }
+        }
+        memcpy(_buf + _len, data, len);
+        _len += len;
+    }
+
+    void pad(char c, int count)
+    {
+        while(count-- > 0) {
+            put(c);
+        }
+    }
+
+    // characters produced so far, for %n
+    size_t count() const
+    {
+        return _written + _len;
+    }
+
+    size_t flush()
+    {
+        if(_len) {
+            _written += _out.write((const uint8_t *) _buf, _len);
+            _len = 0;
+        }
+        return _written;
+    }
+
+private:
+    Print &_out;
+    char _buf[PRINTF_CHUNK_SIZE];
+    size_t _len;
+    size_t _written;
+};
+
+enum FormatLength {
+    LEN_INT,
+    LEN_CHAR,
+    LEN_SHORT,
+    LEN_LONG,
+    LEN_LONG_LONG,
+    LEN_LONG_DOUBLE
+};
+
+struct FormatSpec {
+    bool left = false;
+    bool plus = false;
+    bool space = false;
+    bool alt = false;
+    bool zero = false;
+    int width = 0;
+    int precision = -1;
+};
+
+void formatString(PrintChunker &out, const char *str, size_t len, const FormatSpec &f)
+{
+    int padding = f.width - (int) len;
+    if(!f.left) {
+        out.pad(' ', padding);
+    }
+    out.put(str, len);
+    if(f.left) {
+        out.pad(' ', padding);
+    }
+}
+
+void formatInteger(PrintChunker &out, unsigned long long value, unsigned base, bool upper, char sign, const char *prefix, const FormatSpec &f)
+{
+    const char *digitChars = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char buf[8 * sizeof(value) / 3 + 2];
+    char *end = buf + sizeof(buf);
+    char *str = end;
+
+    // 32-bit division is much cheaper on the target, use it whenever the value fits
+    if(value <= 0xFFFFFFFFULL) {
+        uint32_t v = (uint32_t) value;
+        do {
+            *--str = digitChars[v % base];
+            v /= base;
+        } while(v);
+    } else {
+        do {
+            *--str = digitChars[value % base];
+            value /= base;
+        } while(value);
+    }
+    // an explicit zero precision prints nothing for zero
+    if(f.precision == 0 && str[0] == '0' && str + 1 == end) {
+        str = end;
+    }
+
+    int len = end - str;
+    int prefixLen = strlen(prefix);
+    int zeros = (f.precision > len) ? f.precision - len : 0;
+    if(base == 8 && f.alt && zeros == 0 && (len == 0 || *str != '0')) {
+        zeros = 1;
+    }
+    int padding = f.width - len - zeros - prefixLen - (sign ? 1 : 0);
+    if(f.zero && !f.left && f.precision < 0 && padding > 0) {
+        zeros += padding;
+        padding = 0;
+    }
+
+    if(!f.left) {
+        out.pad(' ', padding);
+    }
+    if(sign) {
+        out.put(sign);
+    }
+    out.put(prefix, prefixLen);
+    out.pad('0', zeros);
+    out.put(str, len);
+    if(f.left) {
+        out.pad(' ', padding);
+    }
+}
+
+// floating point conversions are left to the C library, formatted without the
+// field width into a stack buffer. Output longer than 63 characters (%f of
+// values beyond about 1e50, or precisions above about 50) is truncated.
+__attribute__((noinline)) void formatFloat(PrintChunker &out, char conv, double value, const FormatSpec &f)
+{
+    char spec[10];
+    char *s = spec;
+    *s++ = '%';
+    if(f.plus) {
+        *s++ = '+';
+    }
+    if(f.space) {
+        *s++ = ' ';
+    }
+    if(f.alt) {
+        *s++ = '#';
+    }
+    *s++ = '.';
+    *s++ = '*';
+    *s++ = conv;
+    *s = '\0';
+
+    char temp[64];
+    int len = snprintf(temp, sizeof(temp), spec, f.precision, value);
+    if(len < 0) {
+        return;
+    }
+    if(len >= (int) sizeof(temp)) {
+        len = sizeof(temp) - 1;
+    }
+
+    int padding = f.width - len;
+    const char *str = temp;
+    if(padding > 0 && f.zero && !f.left && isfinite(value)) {
+        if(*str == '-' || *str == '+' || *str == ' ') {
+            out.put(*str++);
+            len--;
+        }
+        if((conv == 'a' || conv == 'A') && len >= 2) {
+            out.put(str, 2);
+            str += 2;
+            len -= 2;
+        }
+        out.pad('0', padding);
+        padding = 0;
+    }
+    if(!f.left) {
+        out.pad(' ', padding);
+    }
+    out.put(str, len);
+    if(f.left) {
+        out.pad(' ', padding);
+    }
+}
+
+} // namespace
+
 // Public Methods //////////////////////////////////////////////////////////////
 
 /* default implementation: may be overridden */
@@ -46,34 +250,199 @@ size_t Print::write(const uint8_t *buffer, size_t size)
 
 size_t Print::printf(const char *format, ...)
 {
-    char loc_buf[64];
-    char * temp = loc_buf;
     va_list arg;
-    va_list copy;
     va_start(arg, format);
-    va_copy(copy, arg);
-    int len = vsnprintf(temp, sizeof(loc_buf), format, copy);
-    va_end(copy);
-    if(len < 0) {
-        va_end(arg);
-        return 0;
-    }
-    if(len >= (int)sizeof(loc_buf)){  // comparation of same sign type for the compiler
-        temp = (char*) malloc(len+1);
-        if(temp == NULL) {
-            va_end(arg);
-            return 0;
-        }
-        len = vsnprintf(temp, len+1, format, arg);
-    }
+    size_t len = vprintf(format, arg);
     va_end(arg);
-    len = write((uint8_t*)temp, len);
-    if(temp != loc_buf){
-        free(temp);
-    }
     return len;
 }
 
+size_t Print::vprintf(const char *format, va_list arg)
+{
+    PrintChunker out(*this);
+    const char *p = format;
+
+    while(*p) {
+        const char *spec = strchr(p, '%');
+        if(spec == NULL) {
+            out.put(p, strlen(p));
+            break;
+        }
+        out.put(p, spec - p);
+        p = spec + 1;
+
+        FormatSpec f;
+        for(;; p++) {
+            if(*p == '-') {
+                f.left = true;
+            } else if(*p == '+') {
+                f.plus = true;
+            } else if(*p == ' ') {
+                f.space = true;
+            } else if(*p == '#') {
+                f.alt = true;
+            } else if(*p == '0') {
+                f.zero = true;
+            } else {
+                break;
+            }
+        }
+        if(*p == '*') {
+            f.width = va_arg(arg, int);
+            if(f.width < 0) {
+                f.left = true;
+                f.width = -f.width;
+            }
+            p++;
+        } else {
+            while(*p >= '0' && *p <= '9') {
+                f.width = f.width * 10 + (*p++ - '0');
+            }
+        }
+        if(*p == '.') {
+            p++;
+            f.precision = 0;
+            if(*p == '*') {
+                f.precision = va_arg(arg, int);
+                if(f.precision < 0) {
+                    f.precision = -1;
+                }
+                p++;
+            } else {
+                while(*p >= '0' && *p <= '9') {
+                    f.precision = f.precision * 10 + (*p++ - '0');
+                }
+            }
+        }
+
+        FormatLength length = LEN_INT;
+        switch(*p) {
+        case 'h':
+            length = (*++p == 'h') ? (p++, LEN_CHAR) : LEN_SHORT;
+            break;
+        case 'l':
+            length = (*++p == 'l') ? (p++, LEN_LONG_LONG) : LEN_LONG;
+            break;
+        case 'q':
+            length = LEN_LONG_LONG;
+            p++;
+            break;
+        case 'z':
+        case 't':
+            length = (sizeof(size_t) == sizeof(long)) ? LEN_LONG : LEN_INT;
+            p++;
+            break;
+        case 'j':
+            length = LEN_LONG_LONG;
+            p++;
+            break;
+        case 'L':
+            length = LEN_LONG_DOUBLE;
+            p++;
+            break;
+        }
+
+        char conv = *p;
+        if(conv == '\0') {
+            out.put(spec, p - spec);
+            break;
+        }
+        p++;
+
+        switch(conv) {
+        case '%':
+            out.put('%');
+            break;
+        case 'c': {
+            char c = (char) va_arg(arg, int);
+            formatString(out, &c, 1, f);
+            break;
+        }
+        case 's': {
+            const char *str = va_arg(arg, const char *);
+            if(str == NULL) {
+                str = "(null)";
+            }
+            size_t len = (f.precision >= 0) ? strnlen(str, f.precision) : strlen(str);
+            formatString(out, str, len, f);
+            break;
+        }
+        case 'd':
+        case 'i': {
+            long long value;
+            switch(length) {
+            case LEN_CHAR:      value = (signed char) va_arg(arg, int); break;
+            case LEN_SHORT:     value = (short) va_arg(arg, int); break;
+            case LEN_LONG:      value = va_arg(arg, long); break;
+            case LEN_LONG_LONG: value = va_arg(arg, long long); break;
+            default:            value = va_arg(arg, int); break;
+            }
+            char sign = (value < 0) ? '-' : f.plus ? '+' : f.space ? ' ' : 0;
+            unsigned long long magnitude = (value < 0) ? 0ULL - (unsigned long long) value : (unsigned long long) value;
+            formatInteger(out, magnitude, 10, false, sign, "", f);
+            break;
+        }
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'p': {
+            unsigned long long value;
+            if(conv == 'p') {
+                value = (uintptr_t) va_arg(arg, void *);
+            } else {
+                switch(length) {
+                case LEN_CHAR:      value = (unsigned char) va_arg(arg, unsigned int); break;
+                case LEN_SHORT:     value = (unsigned short) va_arg(arg, unsigned int); break;
+                case LEN_LONG:      value = va_arg(arg, unsigned long); break;
+                case LEN_LONG_LONG: value = va_arg(arg, unsigned long long); break;
+                default:            value = va_arg(arg, unsigned int); break;
+                }
+            }
+            if(conv == 'u') {
+                formatInteger(out, value, 10, false, 0, "", f);
+            } else if(conv == 'o') {
+                formatInteger(out, value, 8, false, 0, "", f);
+            } else if(conv == 'p') {
+                formatInteger(out, value, 16, false, 0, "0x", f);
+            } else {
+                const char *prefix = (f.alt && value) ? ((conv == 'X') ? "0X" : "0x") : "";
+                formatInteger(out, value, 16, conv == 'X', 0, prefix, f);
+            }
+            break;
+        }
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A': {
+            double value = (length == LEN_LONG_DOUBLE) ? (double) va_arg(arg, long double) : va_arg(arg, double);
+            formatFloat(out, conv, value, f);
+            break;
+        }
+        case 'n': {
+            size_t count = out.count();
+            switch(length) {
+            case LEN_CHAR:      *va_arg(arg, signed char *) = count; break;
+            case LEN_SHORT:     *va_arg(arg, short *) = count; break;
+            case LEN_LONG:      *va_arg(arg, long *) = count; break;
+            case LEN_LONG_LONG: *va_arg(arg, long long *) = count; break;
+            default:            *va_arg(arg, int *) = count; break;
+            }
+            break;
+        }
+        default:
+            // unknown conversion, emit it as written
+            out.put(spec, p - spec);
+            break;
+        }
+    }
+    return out.flush();
+}
+
 size_t Print::print(const String &s)
 {
     return write(s.c_str(), s.length());
@@ -106,12 +475,10 @@ size_t Print::print(unsigned int n, int base)
 
 size_t Print::print(long n, int base)
 {
-    int t = 0;
     if (base == 10 && n < 0) {
-        t = print('-');
-        n = -n;
+        return printNumber(0 - static_cast<unsigned long>(n), base, true);
     }
-    return printNumber(static_cast<unsigned long>(n), base) + t;
+    return printNumber(static_cast<unsigned long>(n), base);
 }
 
 size_t Print::print(unsigned long n, int base)
@@ -125,12 +492,10 @@ size_t Print::print(unsigned long n, int base)
 
 size_t Print::print(long long n, int base)
 {
-    int t = 0;
     if (base == 10 && n < 0) {
-        t = print('-');
-        n = -n;
+        return printNumber(0 - static_cast<unsigned long long>(n), base, true);
     }
-    return printNumber(static_cast<unsigned long long>(n), base) + t;
+    return printNumber(static_cast<unsigned long long>(n), base);
 }
 
 size_t Print::print(unsigned long long n, int base)
@@ -166,6 +531,19 @@ size_t Print::print(struct tm * timeinfo, const char * format)
     return print(buf);
 }
 
+size_t Print::printFormatPart(const char *&format)
+{
+    const char *placeholder = strstr(format, "{}");
+    if(placeholder == NULL) {
+        size_t n = print(format);
+        format += strlen(format);
+        return n;
+    }
+    size_t n = write(format, placeholder - format);
+    format = placeholder + 2;
+    return n;
+}
+
 size_t Print::println(void)
 {
     return print("\r\n");
@@ -264,9 +642,9 @@ size_t Print::println(struct tm * timeinfo, const char * format)
 
 // Private Methods /////////////////////////////////////////////////////////////
 
-size_t Print::printNumber(unsigned long n, uint8_t base)
+size_t Print::printNumber(unsigned long n, uint8_t base, bool negative)
 {
-    char buf[8 * sizeof(n) + 1]; // Assumes 8-bit chars plus zero byte.
+    char buf[8 * sizeof(n) + 2]; // Assumes 8-bit chars plus sign and zero byte.
     char *str = &buf[sizeof(buf) - 1];
 
     *str = '\0';
@@ -283,12 +661,15 @@ size_t Print::printNumber(unsigned long n, uint8_t base)
         *--str = c < 10 ? c + '0' : c + 'A' - 10;
     } while (n);
 
+    if(negative) {
+        *--str = '-';
+    }
     return write(str);
 }
 
-size_t Print::printNumber(unsigned long long n, uint8_t base)
+size_t Print::printNumber(unsigned long long n, uint8_t base, bool negative)
 {
-    char buf[8 * sizeof(n) + 1]; // Assumes 8-bit chars plus zero byte.
+    char buf[8 * sizeof(n) + 2]; // Assumes 8-bit chars plus sign and zero byte.
     char* str = &buf[sizeof(buf) - 1];
 
     *str = '\0';
@@ -306,13 +687,14 @@ size_t Print::printNumber(unsigned long long n, uint8_t base)
         *--str = c < 10 ? c + '0' : c + 'A' - 10;
     } while (n);
 
+    if(negative) {
+        *--str = '-';
+    }
     return write(str);
 }
 
 size_t Print::printFloat(double number, uint8_t digits)
 {
-    size_t n = 0;
-
     if(isnan(number)) {
         return print("nan");
     }
@@ -326,9 +708,12 @@ size_t Print::printFloat(double number, uint8_t digits)
         return print("ovf");    // constant determined empirically
     }
 
+    // the whole number is assembled here and written at once
+    PrintChunker out(*this);
+
     // Handle negative numbers
     if(number < 0.0) {
-        n += print('-');
+        out.put('-');
         number = -number;
     }
 
@@ -343,20 +728,26 @@ size_t Print::printFloat(double number, uint8_t digits)
     // Extract the integer part of the number and print it
     unsigned long int_part = (unsigned long) number;
     double remainder = number - (double) int_part;
-    n += print(int_part);
+    char buf[8 * sizeof(int_part) + 1];
+    char *str = &buf[sizeof(buf)];
+    do {
+        *--str = '0' + int_part % 10;
+        int_part /= 10;
+    } while(int_part);
+    out.put(str, &buf[sizeof(buf)] - str);
 
     // Print the decimal point, but only if there are digits beyond
     if(digits > 0) {
-        n += print(".");
+        out.put('.');
     }
 
     // Extract digits from the remainder one at a time
     while(digits-- > 0) {
         remainder *= 10.0;
         int toPrint = int(remainder);
-        n += print(toPrint);
+        out.put('0' + toPrint);
         remainder -= toPrint;
     }
 
-    return n;
+    return out.flush();
 }
@@ -22,6 +22,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdarg.h>
 
 #include "WString.h"
 #include "Printable.h"
@@ -35,10 +36,13 @@ class Print
 {
 private:
     int write_error;
-    size_t printNumber(unsigned long, uint8_t);
-    size_t printNumber(unsigned long long, uint8_t);
+    size_t printNumber(unsigned long, uint8_t, bool negative = false);
+    size_t printNumber(unsigned long long, uint8_t, bool negative = false);
     size_t printFloat(double, uint8_t);
 protected:
+    // writes format up to the next "{}" placeholder and moves format past it
+    size_t printFormatPart(const char *&format);
+
     void setWriteError(int err = 1)
     {
         write_error = err;
@@ -73,6 +77,7 @@ public:
     }
 
     size_t printf(const char * format, ...)  __attribute__ ((format (printf, 2, 3)));
+    size_t vprintf(const char * format, va_list arg);
 
     // add availableForWrite to make compatible with Arduino Print.h
     // default to zero, meaning "a single write may block"
@@ -93,6 +98,22 @@ public:
     size_t print(const Printable&);
     size_t print(struct tm * timeinfo, const char * format = NULL);
 
+    // print("T={} H={}", t, h) prints each argument with the matching print() overload
+    // in place of the next "{}", so argument types are checked at compile time.
+    // Arguments without a placeholder are appended.
+    template<typename T, typename... Args>
+    size_t print(const char * format, const T &value, const Args &... args)
+    {
+        size_t n = printFormatPart(format);
+        n += print(value);
+        return n + print(format, args...);
+    }
+    template<typename T, typename... Args>
+    size_t print(const __FlashStringHelper *format, const T &value, const Args &... args)
+    {
+        return print(reinterpret_cast<const char *>(format), value, args...);
+    }
+
     size_t println(const __FlashStringHelper *ifsh) { return println(reinterpret_cast<const char *>(ifsh)); }
     size_t println(const String &s);
     size_t println(const char[]);
@@ -108,6 +129,18 @@ public:
     size_t println(const Printable&);
     size_t println(struct tm * timeinfo, const char * format = NULL);
     size_t println(void);
+
+    template<typename T, typename... Args>
+    size_t println(const char * format, const T &value, const Args &... args)
+    {
+        size_t n = print(format, value, args...);
+        return n + println();
+    }
+    template<typename T, typename... Args>
+    size_t println(const __FlashStringHelper *format, const T &value, const Args &... args)
+    {
+        return println(reinterpret_cast<const char *>(format), value, args...);
+    }
     
     virtual void flush() { /* Empty implementation for backward compatibility */ }
     
@@ -55,6 +55,20 @@ int Stream::timedPeek()
     return -1;     // -1 indicates timeout
 }
 
+// private method to wait for buffered data with timeout
+size_t Stream::timedPeekAvailable()
+{
+    size_t available;
+    _startMillis = millis();
+    do {
+        available = peekAvailable();
+        if(available) {
+            return available;
+        }
+    } while(millis() - _startMillis < _timeout);
+    return 0;     // 0 indicates timeout
+}
+
 // returns peek of the next digit in the stream or -1 if timeout
 // discards non-numeric characters
 int Stream::peekNextDigit()
@@ -127,60 +141,93 @@ int Stream::findMulti( struct Stream::MultiTarget *targets, int tCount) {
       return t - targets;
   }
 
+  if (hasPeekBufferAPI()) {
+    while (1) {
+      size_t available = timedPeekAvailable();
+      if (!available)
+        return -1;
+
+      const char *buffer = peekBuffer();
+      size_t i = 0;
+      while (i < available) {
+        // nothing partially matched, skip ahead to the next candidate
+        if (tCount == 1 && targets[0].index == 0) {
+          const char *next = (const char *) memchr(buffer + i, targets[0].str[0], available - i);
+          if (!next)
+            break;
+          i = next - buffer;
+        }
+        int found = findMultiStep(targets, tCount, (uint8_t) buffer[i++]);
+        if (found >= 0) {
+          peekConsume(i);
+          return found;
+        }
+      }
+      peekConsume(available);
+    }
+  }
+
   while (1) {
     int c = timedRead();
     if (c < 0)
       return -1;
 
-    for (struct MultiTarget *t = targets; t < targets+tCount; ++t) {
-      // the simple case is if we match, deal with that first.
-      if (c == t->str[t->index]) {
-        if (++t->index == t->len)
-          return t - targets;
-        else
-          continue;
-      }
+    int found = findMultiStep(targets, tCount, c);
+    if (found >= 0)
+      return found;
+  }
+  // unreachable
+  return -1;
+}
 
-      // if not we need to walk back and see if we could have matched further
-      // down the stream (ie '1112' doesn't match the first position in '11112'
-      // but it will match the second position so we can't just reset the current
-      // index to 0 when we find a mismatch.
-      if (t->index == 0)
+int Stream::findMultiStep(struct Stream::MultiTarget *targets, int tCount, int c) {
+  for (struct MultiTarget *t = targets; t < targets+tCount; ++t) {
+    // the simple case is if we match, deal with that first.
+    if (c == t->str[t->index]) {
+      if (++t->index == t->len)
+        return t - targets;
+      else
         continue;
+    }
 
-      int origIndex = t->index;
-      do {
-        --t->index;
-        // first check if current char works against the new current index
-        if (c != t->str[t->index])
-          continue;
+    // if not we need to walk back and see if we could have matched further
+    // down the stream (ie '1112' doesn't match the first position in '11112'
+    // but it will match the second position so we can't just reset the current
+    // index to 0 when we find a mismatch.
+    if (t->index == 0)
+      continue;
 
-        // if it's the only char then we're good, nothing more to check
-        if (t->index == 0) {
-          t->index++;
-          break;
-        }
+    int origIndex = t->index;
+    do {
+      --t->index;
+      // first check if current char works against the new current index
+      if (c != t->str[t->index])
+        continue;
 
-        // otherwise we need to check the rest of the found string
-        int diff = origIndex - t->index;
-        size_t i;
-        for (i = 0; i < t->index; ++i) {
-          if (t->str[i] != t->str[i + diff])
-            break;
-        }
+      // if it's the only char then we're good, nothing more to check
+      if (t->index == 0) {
+        t->index++;
+        break;
+      }
 
-        // if we successfully got through the previous loop then our current
-        // index is good.
-        if (i == t->index) {
-          t->index++;
+      // otherwise we need to check the rest of the found string
+      int diff = origIndex - t->index;
+      size_t i;
+      for (i = 0; i < t->index; ++i) {
+        if (t->str[i] != t->str[i + diff])
           break;
-        }
+      }
 
-        // otherwise we just try the next index
-      } while (t->index);
-    }
+      // if we successfully got through the previous loop then our current
+      // index is good.
+      if (i == t->index) {
+        t->index++;
+        break;
+      }
+
+      // otherwise we just try the next index
+    } while (t->index);
   }
-  // unreachable
   return -1;
 }
 
@@ -281,6 +328,21 @@ float Stream::parseFloat(char skipChar)
 size_t Stream::readBytes(char *buffer, size_t length)
 {
     size_t count = 0;
+    if(hasPeekBufferAPI()) {
+        while(count < length) {
+            size_t available = timedPeekAvailable();
+            if(!available) {
+                break;
+            }
+            if(available > length - count) {
+                available = length - count;
+            }
+            memcpy(buffer + count, peekBuffer(), available);
+            peekConsume(available);
+            count += available;
+        }
+        return count;
+    }
     while(count < length) {
         int c = timedRead();
         if(c < 0) {
@@ -302,6 +364,28 @@ size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length)
         return 0;
     }
     size_t index = 0;
+    if(hasPeekBufferAPI()) {
+        while(index < length) {
+            size_t available = timedPeekAvailable();
+            if(!available) {
+                break;
+            }
+            if(available > length - index) {
+                available = length - index;
+            }
+            const char *data = peekBuffer();
+            const char *end = (const char *) memchr(data, terminator, available);
+            size_t len = end ? end - data : available;
+            memcpy(buffer + index, data, len);
+            index += len;
+            // the terminator is consumed but not stored
+            peekConsume(end ? len + 1 : len);
+            if(end) {
+                break;
+            }
+        }
+        return index;
+    }
     while(index < length) {
         int c = timedRead();
         if(c < 0 || c == terminator) {
@@ -316,6 +400,14 @@ size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length)
 String Stream::readString()
 {
     String ret;
+    if(hasPeekBufferAPI()) {
+        size_t available;
+        while((available = timedPeekAvailable())) {
+            ret.concat(peekBuffer(), available);
+            peekConsume(available);
+        }
+        return ret;
+    }
     int c = timedRead();
     while(c >= 0) {
         ret += (char) c;
@@ -327,6 +419,20 @@ String Stream::readString()
 String Stream::readStringUntil(char terminator)
 {
     String ret;
+    if(hasPeekBufferAPI()) {
+        size_t available;
+        while((available = timedPeekAvailable())) {
+            const char *data = peekBuffer();
+            const char *end = (const char *) memchr(data, terminator, available);
+            size_t len = end ? end - data : available;
+            ret.concat(data, len);
+            peekConsume(end ? len + 1 : len);
+            if(end) {
+                break;
+            }
+        }
+        return ret;
+    }
     int c = timedRead();
     while(c >= 0 && c != terminator) {
         ret += (char) c;
@@ -42,6 +42,7 @@ protected:
     unsigned long _startMillis;  // used for timeout measurement
     int timedRead();    // private method to read stream with timeout
     int timedPeek();    // private method to peek stream with timeout
+    size_t timedPeekAvailable(); // private method to wait for peekAvailable() with timeout
     int peekNextDigit(); // returns the next numeric digit in the stream or -1 if timeout
 
 public:
@@ -55,6 +56,29 @@ public:
     }
     virtual ~Stream() {}
 
+// buffered source interface, lets the parsing methods scan and copy whole chunks
+// instead of reading byte by byte
+
+    virtual bool hasPeekBufferAPI() const
+    {
+        return false;
+    }
+    // number of bytes in peekBuffer(), may refill the buffer but never blocks
+    virtual size_t peekAvailable()
+    {
+        return 0;
+    }
+    // bytes at the read position, valid until the next read or peekConsume()
+    virtual const char* peekBuffer()
+    {
+        return nullptr;
+    }
+    // drops size bytes (at most peekAvailable()) from the front of peekBuffer()
+    virtual void peekConsume(size_t size)
+    {
+        (void) size;
+    }
+
 // parsing methods
 
     void setTimeout(unsigned long timeout);  // sets maximum milliseconds to wait for stream data, default is 1 second
@@ -133,6 +157,8 @@ protected:
   // This allows you to search for an arbitrary number of strings.
   // Returns index of the target that is found first or -1 if timeout occurs.
   int findMulti(struct MultiTarget *targets, int tCount);
+  // feeds one character to the search, returns the index of the completed target or -1
+  static int findMultiStep(struct MultiTarget *targets, int tCount, int c);
 
 };
 
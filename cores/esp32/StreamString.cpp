@@ -65,3 +65,19 @@ int StreamString::peek() {
 void StreamString::flush() {
 }
 
+bool StreamString::hasPeekBufferAPI() const {
+    return true;
+}
+
+size_t StreamString::peekAvailable() {
+    return length();
+}
+
+const char* StreamString::peekBuffer() {
+    return c_str();
+}
+
+void StreamString::peekConsume(size_t size) {
+    remove(0, size);
+}
+
@@ -33,6 +33,11 @@ public:
     int read() override;
     int peek() override;
     void flush() override;
+
+    bool hasPeekBufferAPI() const override;
+    size_t peekAvailable() override;
+    const char* peekBuffer() override;
+    void peekConsume(size_t size) override;
 };
 
 
@@ -194,3 +194,154 @@ size_t cbuf::remove(size_t size)
     _begin = wrap_if_bufend(_begin + size_to_remove);
     return available();
 }
+
+cbuf_spsc::cbuf_spsc(size_t size) :
+    _size(size + 1), _buf(new char[size + 1]), _head(0), _tail(0)
+{
+}
+
+cbuf_spsc::~cbuf_spsc()
+{
+    delete[] _buf;
+}
+
+size_t cbuf_spsc::available() const
+{
+    size_t head = _head.load(std::memory_order_acquire);
+    size_t tail = _tail.load(std::memory_order_acquire);
+    return (head >= tail) ? head - tail : _size - (tail - head);
+}
+
+size_t cbuf_spsc::room() const
+{
+    return _size - 1 - available();
+}
+
+int cbuf_spsc::peek()
+{
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if(tail == _head.load(std::memory_order_acquire)) {
+        return -1;
+    }
+    return static_cast<int>(_buf[tail]);
+}
+
+size_t cbuf_spsc::peek(char *dst, size_t size)
+{
+    cbuf_span span;
+    size_t size_read = readSpan(span, size);
+    memcpy(dst, span.data[0], span.len[0]);
+    if(span.len[1]) {
+        memcpy(dst + span.len[0], span.data[1], span.len[1]);
+    }
+    return size_read;
+}
+
+int cbuf_spsc::read()
+{
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if(tail == _head.load(std::memory_order_acquire)) {
+        return -1;
+    }
+    char result = _buf[tail];
+    _tail.store(wrap(tail + 1), std::memory_order_release);
+    return static_cast<int>(result);
+}
+
+size_t cbuf_spsc::read(char* dst, size_t size)
+{
+    size_t size_read = peek(dst, size);
+    return consume(size_read);
+}
+
+size_t cbuf_spsc::readSpan(cbuf_span &span, size_t size)
+{
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    size_t head = _head.load(std::memory_order_acquire);
+    size_t bytes_available = (head >= tail) ? head - tail : _size - (tail - head);
+    size_t size_to_read = (size < bytes_available) ? size : bytes_available;
+    size_t top_size = _size - tail;
+
+    span.data[0] = _buf + tail;
+    span.data[1] = _buf;
+    if(size_to_read > top_size) {
+        span.len[0] = top_size;
+        span.len[1] = size_to_read - top_size;
+    } else {
+        span.len[0] = size_to_read;
+        span.len[1] = 0;
+    }
+    return size_to_read;
+}
+
+size_t cbuf_spsc::consume(size_t size)
+{
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    size_t head = _head.load(std::memory_order_acquire);
+    size_t bytes_available = (head >= tail) ? head - tail : _size - (tail - head);
+    if(size > bytes_available) {
+        size = bytes_available;
+    }
+    _tail.store(wrap(tail + size), std::memory_order_release);
+    return size;
+}
+
+void cbuf_spsc::flush()
+{
+    _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+size_t cbuf_spsc::write(char c)
+{
+    size_t head = _head.load(std::memory_order_relaxed);
+    size_t next = wrap(head + 1);
+    if(next == _tail.load(std::memory_order_acquire)) {
+        return 0;
+    }
+    _buf[head] = c;
+    _head.store(next, std::memory_order_release);
+    return 1;
+}
+
+size_t cbuf_spsc::write(const char* src, size_t size)
+{
+    cbuf_span span;
+    size_t size_written = writeSpan(span, size);
+    memcpy(span.data[0], src, span.len[0]);
+    if(span.len[1]) {
+        memcpy(span.data[1], src + span.len[0], span.len[1]);
+    }
+    return commit(size_written);
+}
+
+size_t cbuf_spsc::writeSpan(cbuf_span &span, size_t size)
+{
+    size_t head = _head.load(std::memory_order_relaxed);
+    size_t tail = _tail.load(std::memory_order_acquire);
+    size_t bytes_free = (tail > head) ? tail - head - 1 : _size - (head - tail) - 1;
+    size_t size_to_write = (size < bytes_free) ? size : bytes_free;
+    size_t top_size = _size - head;
+
+    span.data[0] = _buf + head;
+    span.data[1] = _buf;
+    if(size_to_write > top_size) {
+        span.len[0] = top_size;
+        span.len[1] = size_to_write - top_size;
+    } else {
+        span.len[0] = size_to_write;
+        span.len[1] = 0;
+    }
+    return size_to_write;
+}
+
+size_t cbuf_spsc::commit(size_t size)
+{
+    size_t head = _head.load(std::memory_order_relaxed);
+    size_t tail = _tail.load(std::memory_order_acquire);
+    size_t bytes_free = (tail > head) ? tail - head - 1 : _size - (head - tail) - 1;
+    if(size > bytes_free) {
+        size = bytes_free;
+    }
+    _head.store(wrap(head + size), std::memory_order_release);
+    return size;
+}
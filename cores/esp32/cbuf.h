@@ -24,6 +24,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
+#include <atomic>
 
 class cbuf
 {
@@ -76,4 +77,79 @@ protected:
 
 };
 
+// Up to two contiguous regions of a ring buffer, in order
+struct cbuf_span
+{
+    char* data[2];
+    size_t len[2];
+
+    inline size_t size() const
+    {
+        return len[0] + len[1];
+    }
+};
+
+// Lock-free single-producer/single-consumer variant of cbuf
+//
+// One task or ISR may call the producer side (write, writeSpan, commit) while
+// another calls the consumer side (read, peek, readSpan, consume, flush)
+// without any additional locking. available() and room() may be called from
+// either side and are a snapshot.
+class cbuf_spsc
+{
+public:
+    cbuf_spsc(size_t size);
+    ~cbuf_spsc();
+
+    size_t available() const;
+    size_t room() const;
+
+    inline size_t size() const
+    {
+        return _size - 1;
+    }
+
+    inline bool empty() const
+    {
+        return available() == 0;
+    }
+
+    inline bool full() const
+    {
+        return room() == 0;
+    }
+
+    // consumer side
+    int peek();
+    size_t peek(char *dst, size_t size);
+
+    int read();
+    size_t read(char* dst, size_t size);
+
+    // returns the readable regions without copying, release them with consume()
+    size_t readSpan(cbuf_span &span, size_t size = SIZE_MAX);
+    size_t consume(size_t size);
+
+    void flush();
+
+    // producer side
+    size_t write(char c);
+    size_t write(const char* src, size_t size);
+
+    // returns the free regions without copying, publish them with commit()
+    size_t writeSpan(cbuf_span &span, size_t size = SIZE_MAX);
+    size_t commit(size_t size);
+
+protected:
+    inline size_t wrap(size_t index) const
+    {
+        return (index >= _size) ? index - _size : index;
+    }
+
+    size_t _size;
+    char* _buf;
+    std::atomic<size_t> _head; // next write position, owned by the producer
+    std::atomic<size_t> _tail; // next read position, owned by the consumer
+};
+
 #endif//__cbuf_h
@@ -1280,6 +1280,10 @@ uint32_t spiTransferLongNL(spi_t * spi, uint32_t data)
 }
 
 void spiWriteNL(spi_t * spi, const void * data_in, uint32_t len){
+    spiWriteNLCb(spi, data_in, len, NULL, NULL);
+}
+
+void spiWriteNLCb(spi_t * spi, const void * data_in, uint32_t len, spi_chunk_cb_t cb, void * arg){
     if(!spi) {
         return;
     }
@@ -1306,6 +1310,10 @@ void spiWriteNL(spi_t * spi, const void * data_in, uint32_t len){
         while (spi->dev->cmd.update);
 #endif
         spi->dev->cmd.usr = 1;
+        if(cb){
+            // the chunk is already in the FIFO
+            cb(arg, (const uint8_t *)data, c_len);
+        }
         while(spi->dev->cmd.usr);
 
         data += c_longs;
@@ -1315,9 +1323,15 @@ void spiWriteNL(spi_t * spi, const void * data_in, uint32_t len){
 }
 
 void spiTransferBytesNL(spi_t * spi, const void * data_in, uint8_t * data_out, uint32_t len){
+    spiTransferBytesNLCb(spi, data_in, data_out, len, NULL, NULL);
+}
+
+void spiTransferBytesNLCb(spi_t * spi, const void * data_in, uint8_t * data_out, uint32_t len, spi_chunk_cb_t cb, void * arg){
     if(!spi) {
         return;
     }
+    uint8_t * last_out = NULL;
+    size_t last_len = 0;
     size_t longs = len >> 2;
     if(len & 3){
         longs++;
@@ -1346,8 +1360,17 @@ void spiTransferBytesNL(spi_t * spi, const void * data_in, uint8_t * data_out, u
         while (spi->dev->cmd.update);
 #endif
         spi->dev->cmd.usr = 1;
+        if(last_len){
+            // the previous chunk while this one is on the wire
+            cb(arg, last_out, last_len);
+            last_len = 0;
+        }
         while(spi->dev->cmd.usr);
         if(result){
+            if(cb){
+                last_out = (uint8_t *)result;
+                last_len = c_len;
+            }
             if(c_len & 3){
                 for (size_t i=0; i<(c_longs-1); i++) {
                     result[i] = spi->dev->data_buf[i];
@@ -1373,6 +1396,9 @@ void spiTransferBytesNL(spi_t * spi, const void * data_in, uint8_t * data_out, u
         longs -= c_longs;
         len -= c_len;
     }
+    if(last_len){
+        cb(arg, last_out, last_len);
+    }
 }
 
 void spiTransferBitsNL(spi_t * spi, uint32_t data, uint32_t * out, uint8_t bits)
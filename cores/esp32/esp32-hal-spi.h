@@ -134,6 +134,15 @@ uint8_t spiTransferByteNL(spi_t * spi, uint8_t data);
 uint16_t spiTransferShortNL(spi_t * spi, uint16_t data);
 uint32_t spiTransferLongNL(spi_t * spi, uint32_t data);
 void spiTransferBytesNL(spi_t * spi, const void * data_in, uint8_t * data_out, uint32_t len);
+
+/*
+ * Same as spiWriteNL/spiTransferBytesNL, but cb gets each FIFO chunk (up to 64 bytes)
+ * while the bus is busy: written chunks while they are sent, received chunks (data_out only)
+ * while the next one is transferred, e.g. to checksum the data without another pass
+ * */
+typedef void (*spi_chunk_cb_t)(void * arg, const uint8_t * data, uint32_t len);
+void spiWriteNLCb(spi_t * spi, const void * data_in, uint32_t len, spi_chunk_cb_t cb, void * arg);
+void spiTransferBytesNLCb(spi_t * spi, const void * data_in, uint8_t * data_out, uint32_t len, spi_chunk_cb_t cb, void * arg);
 void spiTransferBitsNL(spi_t * spi, uint32_t data_in, uint32_t * data_out, uint8_t bits);
 
 /*
@@ -30,6 +30,12 @@
 
 static int s_uart_debug_nr = 0;
 
+// Size of the local RX staging buffer of each UART. read(), peek() and available() are served
+// from it and it is refilled in bulk from the IDF driver, instead of one driver call per byte
+#ifndef UART_RX_STAGE_SIZE
+#define UART_RX_STAGE_SIZE 64
+#endif
+
 struct uart_struct_t {
 
 #if !CONFIG_DISABLE_HAL_LOCKS
@@ -37,9 +43,10 @@ struct uart_struct_t {
 #endif
 
     uint8_t num;
-    bool has_peek;
-    uint8_t peek_byte;
+    uint16_t rx_stage_pos;
+    uint16_t rx_stage_len;
     QueueHandle_t uart_event_queue;   // export it by some uartGetEventQueue() function
+    uint8_t rx_stage[UART_RX_STAGE_SIZE];
 };
 
 #if CONFIG_DISABLE_HAL_LOCKS
@@ -48,12 +55,12 @@ struct uart_struct_t {
 #define UART_MUTEX_UNLOCK()
 
 static uart_t _uart_bus_array[] = {
-    {0, false, 0, NULL},
+    {0, 0, 0, NULL},
 #if SOC_UART_NUM > 1
-    {1, false, 0, NULL},
+    {1, 0, 0, NULL},
 #endif
 #if SOC_UART_NUM > 2
-    {2, false, 0, NULL},
+    {2, 0, 0, NULL},
 #endif
 };
 
@@ -63,17 +70,64 @@ static uart_t _uart_bus_array[] = {
 #define UART_MUTEX_UNLOCK()  xSemaphoreGive(uart->lock)
 
 static uart_t _uart_bus_array[] = {
-    {NULL, 0, false, 0, NULL},
+    {NULL, 0, 0, 0, NULL},
 #if SOC_UART_NUM > 1
-    {NULL, 1, false, 0, NULL},
+    {NULL, 1, 0, 0, NULL},
 #endif
 #if SOC_UART_NUM > 2
-    {NULL, 2, false, 0, NULL},
+    {NULL, 2, 0, 0, NULL},
 #endif
 };
 
 #endif
 
+// Helpers for the RX staging buffer - UART_MUTEX must be held by the caller
+static inline size_t _uartStagedLen(uart_t* uart)
+{
+    return uart->rx_stage_len - uart->rx_stage_pos;
+}
+
+static inline void _uartClearStage(uart_t* uart)
+{
+    uart->rx_stage_pos = 0;
+    uart->rx_stage_len = 0;
+}
+
+// moves whatever the IDF driver has already buffered into the staging buffer, never blocks
+static size_t _uartFillStage(uart_t* uart)
+{
+    size_t staged = _uartStagedLen(uart);
+    if (staged) {
+        return staged;
+    }
+    _uartClearStage(uart);
+    size_t buffered = 0;
+    if (uart_get_buffered_data_len(uart->num, &buffered) != ESP_OK || buffered == 0) {
+        return 0;
+    }
+    if (buffered > UART_RX_STAGE_SIZE) {
+        buffered = UART_RX_STAGE_SIZE;
+    }
+    int len = uart_read_bytes(uart->num, uart->rx_stage, buffered, 0);
+    if (len > 0) {
+        uart->rx_stage_len = len;
+    }
+    return _uartStagedLen(uart);
+}
+
+static size_t _uartReadStage(uart_t* uart, uint8_t *buffer, size_t size)
+{
+    size_t staged = _uartStagedLen(uart);
+    if (size > staged) {
+        size = staged;
+    }
+    if (size) {
+        memcpy(buffer, uart->rx_stage + uart->rx_stage_pos, size);
+        uart->rx_stage_pos += size;
+    }
+    return size;
+}
+
 // IDF UART has no detach function. As consequence, after ending a UART, the previous pins continue
 // to work as RX/TX. It can be verified by changing the UART pins and writing to the UART. Output can 
 // be seen in the previous pins and new pins as well. 
@@ -210,6 +264,7 @@ uart_t* uartBegin(uint8_t uart_nr, uint32_t baudrate, uint32_t config, int8_t rx
     uart_config.source_clk = UART_SCLK_APB;  // ESP32, ESP32S2
     uart_config.baud_rate = _get_effective_baudrate(baudrate);
 #endif
+    _uartClearStage(uart);
     ESP_ERROR_CHECK(uart_driver_install(uart_nr, rx_buffer_size, tx_buffer_size, 20, &(uart->uart_event_queue), 0));
     ESP_ERROR_CHECK(uart_param_config(uart_nr, &uart_config));
     ESP_ERROR_CHECK(uart_set_pin(uart_nr, txPin, rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
@@ -278,6 +333,7 @@ void uartEnd(uart_t* uart)
     }
    
     UART_MUTEX_LOCK();
+    _uartClearStage(uart);
     uart_driver_delete(uart->num);
     UART_MUTEX_UNLOCK();
 }
@@ -317,7 +373,7 @@ uint32_t uartAvailable(uart_t* uart)
     UART_MUTEX_LOCK();
     size_t available;
     uart_get_buffered_data_len(uart->num, &available);
-    if (uart->has_peek) available++;
+    available += _uartStagedLen(uart);
     UART_MUTEX_UNLOCK();
     return available;
 }
@@ -344,30 +400,32 @@ size_t uartReadBytes(uart_t* uart, uint8_t *buffer, size_t size, uint32_t timeou
         return 0;
     }
 
-    size_t bytes_read = 0;
-
     UART_MUTEX_LOCK();
 
-    if (uart->has_peek) {
-        uart->has_peek = false;
-        *buffer++ = uart->peek_byte;
-        size--;
-        bytes_read = 1;
-    }
+    size_t bytes_read = _uartReadStage(uart, buffer, size);
+    buffer += bytes_read;
+    size -= bytes_read;
 
     if (size > 0) {
-       int len = uart_read_bytes(uart->num, buffer, size, pdMS_TO_TICKS(timeout_ms));
-       if (len < 0) len = 0;  // error reading UART
-       bytes_read += len;
+        // staging buffer is empty at this point
+        if (size < UART_RX_STAGE_SIZE && timeout_ms == 0) {
+            // small non-blocking reads (i.e. read() of a single byte) are refilled in bulk
+            _uartFillStage(uart);
+            bytes_read += _uartReadStage(uart, buffer, size);
+        } else {
+            // large or blocking reads go straight to the driver without an extra copy
+            int len = uart_read_bytes(uart->num, buffer, size, pdMS_TO_TICKS(timeout_ms));
+            if (len < 0) len = 0;  // error reading UART
+            bytes_read += len;
+        }
     }
 
-        
     UART_MUTEX_UNLOCK();
     return bytes_read;
 }
 
-// DEPRICATED but the original code will be kepts here as future reference when a final solution
-// to the UART driver is defined in the use case of reading byte by byte from UART.
+// Serves the byte from the staging buffer and only waits up to 20ms for the driver when nothing
+// has been received yet
 uint8_t uartRead(uart_t* uart)
 {
     if(uart == NULL) {
@@ -377,11 +435,9 @@ uint8_t uartRead(uart_t* uart)
 
     UART_MUTEX_LOCK();
 
-    if (uart->has_peek) {
-      uart->has_peek = false;
-      c = uart->peek_byte;
+    if (_uartFillStage(uart)) {
+        c = uart->rx_stage[uart->rx_stage_pos++];
     } else {
-
         int len = uart_read_bytes(uart->num, &c, 1, 20 / portTICK_RATE_MS);
         if (len <= 0) { // includes negative return from IDF in case of error
             c  = 0;
@@ -401,21 +457,55 @@ uint8_t uartPeek(uart_t* uart)
 
     UART_MUTEX_LOCK();
 
-    if (uart->has_peek) {
-      c = uart->peek_byte;
+    if (_uartFillStage(uart)) {
+        c = uart->rx_stage[uart->rx_stage_pos];
     } else {
         int len = uart_read_bytes(uart->num, &c, 1, 20 / portTICK_RATE_MS);
         if (len <= 0) { // includes negative return from IDF in case of error
             c  = 0;
         } else {
-            uart->has_peek = true;
-            uart->peek_byte = c;
+            // staging buffer is empty, keep the byte as the first staged byte
+            uart->rx_stage[0] = c;
+            uart->rx_stage_pos = 0;
+            uart->rx_stage_len = 1;
         }
     }
     UART_MUTEX_UNLOCK();
     return c;
 }
 
+// Exposes the staging buffer to Stream's buffered parsing, refills it without blocking
+size_t uartPeekAvailable(uart_t* uart)
+{
+    if(uart == NULL) {
+        return 0;
+    }
+    UART_MUTEX_LOCK();
+    size_t available = _uartFillStage(uart);
+    UART_MUTEX_UNLOCK();
+    return available;
+}
+
+// valid until the next read from this UART
+const uint8_t * uartPeekBuffer(uart_t* uart)
+{
+    if(uart == NULL) {
+        return NULL;
+    }
+    return uart->rx_stage + uart->rx_stage_pos;
+}
+
+void uartPeekConsume(uart_t* uart, size_t size)
+{
+    if(uart == NULL) {
+        return;
+    }
+    UART_MUTEX_LOCK();
+    size_t staged = _uartStagedLen(uart);
+    uart->rx_stage_pos += (size > staged) ? staged : size;
+    UART_MUTEX_UNLOCK();
+}
+
 void uartWrite(uart_t* uart, uint8_t c)
 {
     if(uart == NULL) {
@@ -452,6 +542,7 @@ void uartFlushTxOnly(uart_t* uart, bool txOnly)
     while(!uart_ll_is_tx_idle(UART_LL_GET_HW(uart->num)));
 
     if ( !txOnly ) {
+        _uartClearStage(uart);
         ESP_ERROR_CHECK(uart_flush_input(uart->num));
     }
     UART_MUTEX_UNLOCK();
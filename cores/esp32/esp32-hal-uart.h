@@ -110,6 +110,9 @@ uint32_t uartAvailableForWrite(uart_t* uart);
 size_t uartReadBytes(uart_t* uart, uint8_t *buffer, size_t size, uint32_t timeout_ms);
 uint8_t uartRead(uart_t* uart);
 uint8_t uartPeek(uart_t* uart);
+size_t uartPeekAvailable(uart_t* uart);
+const uint8_t * uartPeekBuffer(uart_t* uart);
+void uartPeekConsume(uart_t* uart, size_t size);
 
 void uartWrite(uart_t* uart, uint8_t c);
 void uartWriteBuf(uart_t* uart, const uint8_t * data, size_t len);
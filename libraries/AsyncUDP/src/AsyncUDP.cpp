@@ -1,5 +1,7 @@
 #include "Arduino.h"
 #include "AsyncUDP.h"
+#include <atomic>
+#include <new>
 
 extern "C" {
 #include "lwip/opt.h"
@@ -118,24 +120,96 @@ typedef struct {
         void *arg;
         udp_pcb *pcb;
         pbuf *pb;
-        const ip_addr_t *addr;
+        ip_addr_t addr;
         uint16_t port;
         struct netif * netif;
 } lwip_event_packet_t;
 
-static xQueueHandle _udp_queue;
+/*
+ * Received packets are passed from the lwIP thread to the async_udp task
+ * through a preallocated ring of events (bounded MPMC queue with a sequence
+ * number per slot). Posting never blocks or allocates, when the ring is full
+ * the drop policy decides which packet is lost. The lwIP thread also pops
+ * when it drops the oldest packet, hence the sequence numbers instead of a
+ * plain SPSC ring.
+ */
+typedef struct {
+        std::atomic<uint32_t> seq;
+        lwip_event_packet_t e;
+} lwip_event_slot_t;
+
+static lwip_event_slot_t * _udp_slots = NULL;
+static uint32_t _udp_queue_len = ASYNC_UDP_QUEUE_LENGTH;
+static std::atomic<uint32_t> _udp_head(0);
+static std::atomic<uint32_t> _udp_tail(0);
+static AsyncUDPPacket * _udp_packets = NULL;   // storage for one batch, only used by the task
+static volatile async_udp_drop_policy_t _udp_drop_policy = ASYNC_UDP_DROP_NEWEST;
+static volatile uint32_t _udp_dropped = 0;
 static volatile TaskHandle_t _udp_task_handle = NULL;
 
+static bool _udp_queue_push(const lwip_event_packet_t *e){
+    uint32_t pos = _udp_tail.load(std::memory_order_relaxed);
+    for (;;) {
+        lwip_event_slot_t * slot = &_udp_slots[pos & (_udp_queue_len - 1)];
+        int32_t diff = (int32_t)(slot->seq.load(std::memory_order_acquire) - pos);
+        if(diff == 0){
+            if(_udp_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                slot->e = *e;
+                slot->seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if(diff < 0){
+            return false;
+        } else {
+            pos = _udp_tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+static bool _udp_queue_pop(lwip_event_packet_t *e){
+    uint32_t pos = _udp_head.load(std::memory_order_relaxed);
+    for (;;) {
+        lwip_event_slot_t * slot = &_udp_slots[pos & (_udp_queue_len - 1)];
+        int32_t diff = (int32_t)(slot->seq.load(std::memory_order_acquire) - (pos + 1));
+        if(diff == 0){
+            if(_udp_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                *e = slot->e;
+                slot->seq.store(pos + _udp_queue_len, std::memory_order_release);
+                return true;
+            }
+        } else if(diff < 0){
+            return false;
+        } else {
+            pos = _udp_head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+static void _udp_task_dispatch(void *arg, size_t count){
+    AsyncUDP::_s_recvBatch(arg, _udp_packets, count);
+    for(size_t i = 0; i < count; i++){
+        _udp_packets[i].~AsyncUDPPacket();
+    }
+}
+
 static void _udp_task(void *pvParameters){
-    lwip_event_packet_t * e = NULL;
+    lwip_event_packet_t e;
     for (;;) {
-        if(xQueueReceive(_udp_queue, &e, portMAX_DELAY) == pdTRUE){
-            if(!e->pb){
-                free((void*)(e));
-                continue;
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // collect runs of packets for the same instance and hand them over together
+        void * arg = NULL;
+        size_t count = 0;
+        while(_udp_queue_pop(&e)){
+            if(count && (e.arg != arg || count == _udp_queue_len)){
+                _udp_task_dispatch(arg, count);
+                count = 0;
             }
-            AsyncUDP::_s_recv(e->arg, e->pcb, e->pb, e->addr, e->port, e->netif);
-            free((void*)(e));
+            arg = e.arg;
+            new (&_udp_packets[count++]) AsyncUDPPacket((AsyncUDP *)e.arg, e.pb, &e.addr, e.port, e.netif);
+            pbuf_free(e.pb);
+        }
+        if(count){
+            _udp_task_dispatch(arg, count);
         }
     }
     _udp_task_handle = NULL;
@@ -143,11 +217,24 @@ static void _udp_task(void *pvParameters){
 }
 
 static bool _udp_task_start(){
-    if(!_udp_queue){
-        _udp_queue = xQueueCreate(32, sizeof(lwip_event_packet_t *));
-        if(!_udp_queue){
+    if(!_udp_slots){
+        uint32_t len = 1;
+        while(len < _udp_queue_len){
+            len <<= 1;
+        }
+        _udp_queue_len = len;
+        _udp_slots = new (std::nothrow) lwip_event_slot_t[_udp_queue_len];
+        _udp_packets = (AsyncUDPPacket *)malloc(_udp_queue_len * sizeof(AsyncUDPPacket));
+        if(!_udp_slots || !_udp_packets){
+            delete[] _udp_slots;
+            _udp_slots = NULL;
+            free(_udp_packets);
+            _udp_packets = NULL;
             return false;
         }
+        for(uint32_t i = 0; i < _udp_queue_len; i++){
+            _udp_slots[i].seq.store(i, std::memory_order_relaxed);
+        }
     }
     if(!_udp_task_handle){
         xTaskCreateUniversal(_udp_task, "async_udp", 4096, NULL, CONFIG_ARDUINO_UDP_TASK_PRIORITY, (TaskHandle_t*)&_udp_task_handle, CONFIG_ARDUINO_UDP_RUNNING_CORE);
@@ -160,23 +247,30 @@ static bool _udp_task_start(){
 
 static bool _udp_task_post(void *arg, udp_pcb *pcb, pbuf *pb, const ip_addr_t *addr, uint16_t port, struct netif *netif)
 {
-    if(!_udp_task_handle || !_udp_queue){
+    if(!_udp_task_handle || !_udp_slots){
         return false;
     }
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
-    if(!e){
-        return false;
+    lwip_event_packet_t e;
+    e.arg = arg;
+    e.pcb = pcb;
+    e.pb = pb;
+    ip_addr_copy(e.addr, *addr);
+    e.port = port;
+    e.netif = netif;
+    bool queued = _udp_queue_push(&e);
+    if(!queued && _udp_drop_policy == ASYNC_UDP_DROP_OLDEST){
+        lwip_event_packet_t old;
+        if(_udp_queue_pop(&old)){
+            pbuf_free(old.pb);
+            _udp_dropped++;
+            queued = _udp_queue_push(&e);
+        }
     }
-    e->arg = arg;
-    e->pcb = pcb;
-    e->pb = pb;
-    e->addr = addr;
-    e->port = port;
-    e->netif = netif;
-    if (xQueueSend(_udp_queue, &e, portMAX_DELAY) != pdPASS) {
-        free((void*)(e));
+    if(!queued){
+        _udp_dropped++;
         return false;
     }
+    xTaskNotifyGive(_udp_task_handle);
     return true;
 }
 
@@ -191,26 +285,6 @@ static void _udp_recv(void *arg, udp_pcb *pcb, pbuf *pb, const ip_addr_t *addr,
         }
     }
 }
-/*
-static bool _udp_task_stop(){
-    if(!_udp_task_post(NULL, NULL, NULL, NULL, 0, NULL)){
-        return false;
-    }
-    while(_udp_task_handle){
-        vTaskDelay(10);
-    }
-
-    lwip_event_packet_t * e;
-    while (xQueueReceive(_udp_queue, &e, 0) == pdTRUE) {
-        if(e->pb){
-            pbuf_free(e->pb);
-        }
-        free((void*)(e));
-    }
-    vQueueDelete(_udp_queue);
-    _udp_queue = NULL;
-}
-*/
 
 
 
@@ -497,6 +571,7 @@ AsyncUDP::AsyncUDP()
     _connected = false;
 	_lastErr = ERR_OK;
     _handler = NULL;
+    _batchHandler = NULL;
 }
 
 AsyncUDP::~AsyncUDP()
@@ -690,23 +765,20 @@ size_t AsyncUDP::writeTo(const uint8_t * data, size_t len, const ip_addr_t * add
     return 0;
 }
 
-void AsyncUDP::_recv(udp_pcb *upcb, pbuf *pb, const ip_addr_t *addr, uint16_t port, struct netif * netif)
+void AsyncUDP::_recvBatch(AsyncUDPPacket *packets, size_t count)
 {
-    while(pb != NULL) {
-        pbuf * this_pb = pb;
-        pb = pb->next;
-        this_pb->next = NULL;
-        if(_handler) {
-            AsyncUDPPacket packet(this, this_pb, addr, port, netif);
-            _handler(packet);
+    if(_batchHandler) {
+        _batchHandler(packets, count);
+    } else if(_handler) {
+        for(size_t i = 0; i < count; i++) {
+            _handler(packets[i]);
         }
-        pbuf_free(this_pb);
     }
 }
 
-void AsyncUDP::_s_recv(void *arg, udp_pcb *upcb, pbuf *p, const ip_addr_t *addr, uint16_t port, struct netif * netif)
+void AsyncUDP::_s_recvBatch(void *arg, AsyncUDPPacket *packets, size_t count)
 {
-    reinterpret_cast<AsyncUDP*>(arg)->_recv(upcb, p, addr, port, netif);
+    reinterpret_cast<AsyncUDP*>(arg)->_recvBatch(packets, count);
 }
 
 bool AsyncUDP::listen(uint16_t port)
@@ -899,3 +971,27 @@ void AsyncUDP::onPacket(AuPacketHandlerFunction cb)
 {
     _handler = cb;
 }
+
+void AsyncUDP::onPacketBatch(AuPacketBatchHandlerFunction cb)
+{
+    _batchHandler = cb;
+}
+
+bool AsyncUDP::setQueueLength(size_t length)
+{
+    if(_udp_slots || !length) {
+        return false;
+    }
+    _udp_queue_len = length;
+    return true;
+}
+
+void AsyncUDP::setDropPolicy(async_udp_drop_policy_t policy)
+{
+    _udp_drop_policy = policy;
+}
+
+uint32_t AsyncUDP::droppedPackets()
+{
+    return _udp_dropped;
+}
@@ -12,6 +12,10 @@ extern "C" {
 #include "freertos/semphr.h"
 }
 
+#ifndef ASYNC_UDP_QUEUE_LENGTH
+#define ASYNC_UDP_QUEUE_LENGTH 32   // received packets waiting for the async_udp task, rounded up to a power of two
+#endif
+
 class AsyncUDP;
 class AsyncUDPPacket;
 class AsyncUDPMessage;
@@ -21,6 +25,12 @@ struct netif;
 
 typedef std::function<void(AsyncUDPPacket& packet)> AuPacketHandlerFunction;
 typedef std::function<void(void * arg, AsyncUDPPacket& packet)> AuPacketHandlerFunctionWithArg;
+typedef std::function<void(AsyncUDPPacket * packets, size_t count)> AuPacketBatchHandlerFunction;
+
+typedef enum {
+    ASYNC_UDP_DROP_NEWEST,  // a packet arriving at a full queue is dropped
+    ASYNC_UDP_DROP_OLDEST   // the oldest queued packet is dropped to make room
+} async_udp_drop_policy_t;
 
 class AsyncUDPMessage : public Print
 {
@@ -98,9 +108,10 @@ protected:
     bool _connected;
 	esp_err_t _lastErr;
     AuPacketHandlerFunction _handler;
+    AuPacketBatchHandlerFunction _batchHandler;
 
     bool _init();
-    void _recv(udp_pcb *upcb, pbuf *pb, const ip_addr_t *addr, uint16_t port, struct netif * netif);
+    void _recvBatch(AsyncUDPPacket *packets, size_t count);
 
 public:
     AsyncUDP();
@@ -108,6 +119,13 @@ public:
 
     void onPacket(AuPacketHandlerFunctionWithArg cb, void * arg=NULL);
     void onPacket(AuPacketHandlerFunction cb);
+    // called once per wake-up with every packet queued for this instance, replaces onPacket()
+    void onPacketBatch(AuPacketBatchHandlerFunction cb);
+
+    // the queue is shared by all instances, its length can only be set before the first listen/connect
+    static bool setQueueLength(size_t length);
+    static void setDropPolicy(async_udp_drop_policy_t policy);
+    static uint32_t droppedPackets();   // packets dropped because the queue was full
 
     bool listen(const ip_addr_t *addr, uint16_t port);
     bool listen(const IPAddress addr, uint16_t port);
@@ -149,7 +167,7 @@ public:
 	esp_err_t lastErr();
     operator bool();
 
-    static void _s_recv(void *arg, udp_pcb *upcb, pbuf *p, const ip_addr_t *addr, uint16_t port, struct netif * netif);
+    static void _s_recvBatch(void *arg, AsyncUDPPacket *packets, size_t count);
 };
 
 #endif
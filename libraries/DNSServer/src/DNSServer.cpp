@@ -9,44 +9,64 @@
 #define DEBUG_OUTPUT Serial
 #endif
 
+#define DNS_MAX_ANSWERS 8         // questions answered per query, real clients send one
+#define DNS_MAX_REPLY_SIZE 512    // largest reply without EDNS
+#define DNS_ANSWER_SIZE 16        // compressed name, type, class, ttl, rdlength, IPv4
+#define DNS_MAX_POINTERS 8        // compression pointers followed per name
+
+static inline uint16_t readU16(const uint8_t *p)
+{
+  return ((uint16_t)p[0] << 8) | p[1];
+}
+
+static inline uint8_t lowerCase(uint8_t c)
+{
+  return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// Returns the offset just after the name at offset, 0 if it runs past the message
+static size_t skipName(const uint8_t *message, size_t length, size_t offset)
+{
+  while (offset < length)
+  {
+    uint8_t labelLength = message[offset];
+    if ((labelLength & 0xC0) == 0xC0)
+      return (offset + 2 <= length) ? offset + 2 : 0;
+    if (labelLength & 0xC0)
+      return 0;
+    offset += labelLength + 1;
+    if (labelLength == 0)
+      return offset;
+  }
+  return 0;
+}
+
 DNSServer::DNSServer()
 {
   _ttl = htonl(DNS_DEFAULT_TTL);
   _errorReplyCode = DNSReplyCode::NonExistentDomain;
-  _dnsHeader    = (DNSHeader*) malloc( sizeof(DNSHeader) ) ;
-  _dnsQuestion  = (DNSQuestion*) malloc( sizeof(DNSQuestion) ) ;     
-  _buffer     = NULL;
-  _currentPacketSize = 0;
+  _anyDomain = false;
+  _domainLabels[0] = 0;
   _port = 0;
 }
 
 DNSServer::~DNSServer()
 {
-  if (_dnsHeader) {
-    free(_dnsHeader);
-    _dnsHeader = NULL;
-  }
-  if (_dnsQuestion) {
-    free(_dnsQuestion);
-    _dnsQuestion = NULL;
-  }
-  if (_buffer) {
-    free(_buffer);
-    _buffer = NULL;
-  }
 }
 
 bool DNSServer::start(const uint16_t &port, const String &domainName,
                      const IPAddress &resolvedIP)
 {
   _port = port;
-  _buffer = NULL;
-  _domainName = domainName;
   _resolvedIP[0] = resolvedIP[0];
   _resolvedIP[1] = resolvedIP[1];
   _resolvedIP[2] = resolvedIP[2];
   _resolvedIP[3] = resolvedIP[3];
-  downcaseAndRemoveWwwPrefix(_domainName);
+  if (!compileDomainName(domainName))
+  {
+    log_e("invalid domain name: %s", domainName.c_str());
+    return false;
+  }
   return _udp.begin(_port) == 1;
 }
 
@@ -63,161 +83,186 @@ void DNSServer::setTTL(const uint32_t &ttl)
 void DNSServer::stop()
 {
   _udp.stop();
-  free(_buffer);
-  _buffer = NULL;
 }
 
-void DNSServer::downcaseAndRemoveWwwPrefix(String &domainName)
+// Converts the domain name to lowercase wire format labels once, so that queries
+// can be compared label by label without building strings. A leading "www" label
+// is dropped here and in the queries.
+bool DNSServer::compileDomainName(const String &domainName)
 {
-  domainName.toLowerCase();
-  domainName.replace("www.", "");
+  _anyDomain = (domainName == "*");
+  _domainLabels[0] = 0;
+  if (_anyDomain)
+    return true;
+
+  const char *name = domainName.c_str();
+  size_t length = 0;
+  bool first = true;
+  while (*name)
+  {
+    const char *dot = strchr(name, '.');
+    size_t labelLength = dot ? (size_t)(dot - name) : strlen(name);
+    if (labelLength > 63 || length + labelLength + 2 > sizeof(_domainLabels))
+      return false;
+    bool www = first && labelLength == 3 && strncasecmp(name, "www", 3) == 0;
+    if (labelLength && !www)
+    {
+      _domainLabels[length++] = labelLength;
+      for (size_t i = 0; i < labelLength; i++)
+        _domainLabels[length++] = lowerCase(name[i]);
+    }
+    first = false;
+    name += labelLength;
+    if (*name == '.')
+      name++;
+  }
+  _domainLabels[length] = 0;
+  return true;
 }
 
-void DNSServer::processNextRequest()
+// Compares the name at offset with the compiled domain, following compression pointers
+bool DNSServer::matchesDomainName(const uint8_t *message, size_t length, size_t offset)
 {
-  _currentPacketSize = _udp.parsePacket();
-  if (_currentPacketSize)
-  {
-    // Allocate buffer for the DNS query
-    if (_buffer != NULL) 
-      free(_buffer);
-    _buffer = (unsigned char*)malloc(_currentPacketSize * sizeof(char));
-    if (_buffer == NULL) 
-      return;
+  if (_anyDomain)
+    return true;
 
-    // Put the packet received in the buffer and get DNS header (beginning of message)
-    // and the question
-    _udp.read(_buffer, _currentPacketSize);
-    memcpy( _dnsHeader, _buffer, DNS_HEADER_SIZE ) ; 
-    if ( requestIncludesOnlyOneQuestion() )
+  size_t domainOffset = 0;
+  int pointers = 0;
+  bool first = true;
+  while (offset < length)
+  {
+    uint8_t labelLength = message[offset];
+    if ((labelLength & 0xC0) == 0xC0)
     {
-      // The QName has a variable length, maximum 255 bytes and is comprised of multiple labels.
-      // Each label contains a byte to describe its length and the label itself. The list of 
-      // labels terminates with a zero-valued byte. In "github.com", we have two labels "github" & "com"
-      // Iterate through the labels and copy them as they come into a single buffer (for simplicity's sake)
-      _dnsQuestion->QNameLength = 0 ;
-      while ( _buffer[ DNS_HEADER_SIZE + _dnsQuestion->QNameLength ] != 0 )
-      {
-        memcpy( (void*) &_dnsQuestion->QName[_dnsQuestion->QNameLength], (void*) &_buffer[DNS_HEADER_SIZE + _dnsQuestion->QNameLength], _buffer[DNS_HEADER_SIZE + _dnsQuestion->QNameLength] + 1 ) ;
-        _dnsQuestion->QNameLength += _buffer[DNS_HEADER_SIZE + _dnsQuestion->QNameLength] + 1 ; 
-      }
-      _dnsQuestion->QName[_dnsQuestion->QNameLength] = 0 ; 
-      _dnsQuestion->QNameLength++ ;   
-
-      // Copy the QType and QClass 
-      memcpy( &_dnsQuestion->QType, (void*) &_buffer[DNS_HEADER_SIZE + _dnsQuestion->QNameLength], sizeof(_dnsQuestion->QType) ) ;
-      memcpy( &_dnsQuestion->QClass, (void*) &_buffer[DNS_HEADER_SIZE + _dnsQuestion->QNameLength + sizeof(_dnsQuestion->QType)], sizeof(_dnsQuestion->QClass) ) ;
+      if (offset + 1 >= length || ++pointers > DNS_MAX_POINTERS)
+        return false;
+      offset = ((labelLength & 0x3F) << 8) | message[offset + 1];
+      continue;
     }
-    
+    if ((labelLength & 0xC0) || offset + 1 + labelLength > length)
+      return false;
+    const uint8_t *label = message + offset + 1;
+    offset += labelLength + 1;
 
-    if (_dnsHeader->QR == DNS_QR_QUERY &&
-        _dnsHeader->OPCode == DNS_OPCODE_QUERY &&
-        requestIncludesOnlyOneQuestion() &&
-        (_domainName == "*" || getDomainNameWithoutWwwPrefix() == _domainName)
-       )
+    if (first)
     {
-      replyWithIP();
+      first = false;
+      if (labelLength == 3 && lowerCase(label[0]) == 'w' && lowerCase(label[1]) == 'w' && lowerCase(label[2]) == 'w')
+        continue;
     }
-    else if (_dnsHeader->QR == DNS_QR_QUERY)
+    if (_domainLabels[domainOffset] != labelLength)
+      return false;
+    if (labelLength == 0)
+      return true;
+    const uint8_t *domainLabel = _domainLabels + domainOffset + 1;
+    for (uint8_t i = 0; i < labelLength; i++)
     {
-      replyWithCustomCode();
+      if (lowerCase(label[i]) != domainLabel[i])
+        return false;
     }
-
-    free(_buffer);
-    _buffer = NULL;
+    domainOffset += labelLength + 1;
   }
+  return false;
 }
 
-bool DNSServer::requestIncludesOnlyOneQuestion()
+void DNSServer::processNextRequest()
 {
-  return ntohs(_dnsHeader->QDCount) == 1 &&
-         _dnsHeader->ANCount == 0 &&
-         _dnsHeader->NSCount == 0 &&
-         _dnsHeader->ARCount == 0;
+  processRequests(1);
 }
 
+int DNSServer::processRequests(int max)
+{
+  // the query is parsed in place in the receive buffer of the socket
+  return _udp.recvBatch([this](const uint8_t *data, size_t len, IPAddress ip, uint16_t port) {
+    handleQuery(data, len, ip, port);
+  }, max);
+}
 
-String DNSServer::getDomainNameWithoutWwwPrefix()
+void DNSServer::handleQuery(const uint8_t *message, size_t length, const IPAddress &ip, uint16_t port)
 {
-  // Error checking : if the buffer containing the DNS request is a null pointer, return an empty domain
-  String parsedDomainName = "";
-  if (_buffer == NULL) 
-    return parsedDomainName;
-  
-  // Set the start of the domain just after the header (12 bytes). If equal to null character, return an empty domain
-  unsigned char *start = _buffer + DNS_OFFSET_DOMAIN_NAME;
-  if (*start == 0)
+  if (length < DNS_HEADER_SIZE)
+    return;
+  uint8_t flags = message[2];
+  if (flags & 0x80)                      // QR set, not a query
+    return;
+  if (((flags >> 3) & 0x0F) != DNS_OPCODE_QUERY)
   {
-    return parsedDomainName;
+    replyWithCustomCode(message, ip, port);
+    return;
   }
 
-  int pos = 0;
-  while(true)
+  // Walk all questions, answer sections of the query (e.g. EDNS) are ignored
+  uint16_t questionCount = readU16(message + 4);
+  uint16_t answers[DNS_MAX_ANSWERS];
+  uint16_t answerCount = 0;
+  size_t offset = DNS_HEADER_SIZE;
+  for (uint16_t i = 0; i < questionCount; i++)
   {
-    unsigned char labelLength = *(start + pos);
-    for(int i = 0; i < labelLength; i++)
-    {
-      pos++;
-      parsedDomainName += (char)*(start + pos);
-    }
-    pos++;
-    if (*(start + pos) == 0)
-    {
-      downcaseAndRemoveWwwPrefix(parsedDomainName);
-      return parsedDomainName;
-    }
-    else
+    size_t nameEnd = skipName(message, length, offset);
+    if (!nameEnd || nameEnd + 4 > length)
     {
-      parsedDomainName += ".";
+      replyWithCustomCode(message, ip, port);
+      return;
     }
+    if (answerCount < DNS_MAX_ANSWERS && matchesDomainName(message, length, offset))
+      answers[answerCount++] = offset;
+    offset = nameEnd + 4;                // QType and QClass
   }
+
+  if (answerCount && offset + answerCount * DNS_ANSWER_SIZE <= DNS_MAX_REPLY_SIZE)
+    replyWithIP(message, offset, answers, answerCount, ip, port);
+  else
+    replyWithCustomCode(message, ip, port);
 }
 
-void DNSServer::replyWithIP()
-{
-  _udp.beginPacket(_udp.remoteIP(), _udp.remotePort());
-  
-  // Change the type of message to a response and set the number of answers equal to 
-  // the number of questions in the header
-  _dnsHeader->QR      = DNS_QR_RESPONSE;
-  _dnsHeader->ANCount = _dnsHeader->QDCount;
-  _udp.write( (unsigned char*) _dnsHeader, DNS_HEADER_SIZE ) ;
-
-  // Write the question
-  _udp.write(_dnsQuestion->QName, _dnsQuestion->QNameLength) ;
-  _udp.write( (unsigned char*) &_dnsQuestion->QType, 2 ) ;
-  _udp.write( (unsigned char*) &_dnsQuestion->QClass, 2 ) ;
-
-  // Write the answer 
-  // Use DNS name compression : instead of repeating the name in this RNAME occurence,
-  // set the two MSB of the byte corresponding normally to the length to 1. The following
-  // 14 bits must be used to specify the offset of the domain name in the message 
-  // (<255 here so the first byte has the 6 LSB at 0) 
-  _udp.write((uint8_t) 0xC0); 
-  _udp.write((uint8_t) DNS_OFFSET_DOMAIN_NAME);  
-
-  // DNS type A : host address, DNS class IN for INternet, returning an IPv4 address 
-  uint16_t answerType = htons(DNS_TYPE_A), answerClass = htons(DNS_CLASS_IN), answerIPv4 = htons(DNS_RDLENGTH_IPV4)  ; 
-  _udp.write((unsigned char*) &answerType, 2 );
-  _udp.write((unsigned char*) &answerClass, 2 );
-  _udp.write((unsigned char*) &_ttl, 4);        // DNS Time To Live
-  _udp.write((unsigned char*) &answerIPv4, 2 );
-  _udp.write(_resolvedIP, sizeof(_resolvedIP)); // The IP address to return
+void DNSServer::replyWithIP(const uint8_t *message, size_t questionsEnd, const uint16_t *answers, uint16_t answerCount, const IPAddress &ip, uint16_t port)
+{
+  _udp.beginPacket(ip, port);
+
+  // Same ID, flags and questions, marked as a response with one answer per matching question
+  uint8_t header[DNS_HEADER_SIZE];
+  memcpy(header, message, 6);
+  header[2] |= 0x80;
+  header[6] = answerCount >> 8;
+  header[7] = answerCount;
+  memset(header + 8, 0, 4);
+  _udp.write(header, DNS_HEADER_SIZE);
+  _udp.write(message + DNS_HEADER_SIZE, questionsEnd - DNS_HEADER_SIZE);
+
+  // Each answer points at the name of its question (DNS name compression), followed by
+  // type A, class IN, the TTL and the IPv4 address
+  uint8_t answer[DNS_ANSWER_SIZE];
+  answer[2] = 0;
+  answer[3] = DNS_TYPE_A;
+  answer[4] = 0;
+  answer[5] = DNS_CLASS_IN;
+  memcpy(answer + 6, &_ttl, 4);
+  answer[10] = 0;
+  answer[11] = DNS_RDLENGTH_IPV4;
+  memcpy(answer + 12, _resolvedIP, sizeof(_resolvedIP));
+  for (uint16_t i = 0; i < answerCount; i++)
+  {
+    answer[0] = 0xC0 | (answers[i] >> 8);
+    answer[1] = answers[i];
+    _udp.write(answer, DNS_ANSWER_SIZE);
+  }
   _udp.endPacket();
 
   #ifdef DEBUG_ESP_DNS
-    DEBUG_OUTPUT.printf("DNS responds: %s for %s\n",
-            IPAddress(_resolvedIP).toString().c_str(), getDomainNameWithoutWwwPrefix().c_str() );
-  #endif  
+    DEBUG_OUTPUT.printf("DNS responds: %s to %s\n",
+            IPAddress(_resolvedIP).toString().c_str(), ip.toString().c_str());
+  #endif
 }
 
-void DNSServer::replyWithCustomCode()
+void DNSServer::replyWithCustomCode(const uint8_t *message, const IPAddress &ip, uint16_t port)
 {
-  _dnsHeader->QR = DNS_QR_RESPONSE;
-  _dnsHeader->RCode = (unsigned char)_errorReplyCode;
-  _dnsHeader->QDCount = 0;
+  uint8_t header[DNS_HEADER_SIZE];
+  memcpy(header, message, 4);
+  header[2] |= 0x80;
+  header[3] = (header[3] & 0xF0) | ((uint8_t)_errorReplyCode & 0x0F);
+  memset(header + 4, 0, 8);
 
-  _udp.beginPacket(_udp.remoteIP(), _udp.remotePort());
-  _udp.write((unsigned char*)_dnsHeader, sizeof(DNSHeader));
+  _udp.beginPacket(ip, port);
+  _udp.write(header, DNS_HEADER_SIZE);
   _udp.endPacket();
 }
@@ -8,6 +8,7 @@
 #define DNS_DEFAULT_TTL 60        // Default Time To Live : time interval in seconds that the resource record should be cached before being discarded
 #define DNS_OFFSET_DOMAIN_NAME 12 // Offset in bytes to reach the domain name in the DNS message 
 #define DNS_HEADER_SIZE 12 
+#define DNS_MAX_NAME_LENGTH 255   // wire format, length bytes and terminating zero included
 
 enum class DNSReplyCode
 {
@@ -78,6 +79,8 @@ class DNSServer
     DNSServer();
     ~DNSServer();
     void processNextRequest();
+    // answers every pending query (up to max) in one call, returns the number of packets handled
+    int processRequests(int max = 32);
     void setErrorReplyCode(const DNSReplyCode &replyCode);
     void setTTL(const uint32_t &ttl);
 
@@ -91,20 +94,16 @@ class DNSServer
   private:
     WiFiUDP _udp;
     uint16_t _port;
-    String _domainName;
+    bool _anyDomain;
+    uint8_t _domainLabels[DNS_MAX_NAME_LENGTH]; // lowercase wire format labels, leading "www" removed
     unsigned char _resolvedIP[4];
-    int _currentPacketSize;
-    unsigned char* _buffer;
-    DNSHeader* _dnsHeader;
     uint32_t _ttl;
     DNSReplyCode _errorReplyCode;
-    DNSQuestion*    _dnsQuestion ; 
 
-
-    void downcaseAndRemoveWwwPrefix(String &domainName);
-    String getDomainNameWithoutWwwPrefix();
-    bool requestIncludesOnlyOneQuestion();
-    void replyWithIP();
-    void replyWithCustomCode();
+    bool compileDomainName(const String &domainName);
+    bool matchesDomainName(const uint8_t *message, size_t length, size_t offset);
+    void handleQuery(const uint8_t *message, size_t length, const IPAddress &ip, uint16_t port);
+    void replyWithIP(const uint8_t *message, size_t questionsEnd, const uint16_t *answers, uint16_t answerCount, const IPAddress &ip, uint16_t port);
+    void replyWithCustomCode(const uint8_t *message, const IPAddress &ip, uint16_t port);
 };
 #endif
@@ -34,6 +34,11 @@ EEPROMClass::EEPROMClass(void)
   , _size(0)
   , _dirty(false)
   , _name("eeprom")
+  , _dirtyPages(0)
+  , _storedPages(0)
+  , _checkPages(false)
+  , _commitInterval(0)
+  , _lastCommit(0)
 {
 }
 
@@ -44,6 +49,11 @@ EEPROMClass::EEPROMClass(uint32_t sector)
   , _size(0)
   , _dirty(false)
   , _name("eeprom")
+  , _dirtyPages(0)
+  , _storedPages(0)
+  , _checkPages(false)
+  , _commitInterval(0)
+  , _lastCommit(0)
 {
 }
 
@@ -53,6 +63,11 @@ EEPROMClass::EEPROMClass(const char* name)
   , _size(0)
   , _dirty(false)
   , _name(name)
+  , _dirtyPages(0)
+  , _storedPages(0)
+  , _checkPages(false)
+  , _commitInterval(0)
+  , _lastCommit(0)
 {
 }
 
@@ -64,6 +79,9 @@ bool EEPROMClass::begin(size_t size) {
   if (!size) {
       return false;
   }
+  if (_size) {
+      end();
+  }
 
   esp_err_t res = nvs_open(_name, NVS_READWRITE, &_handle);
   if (res != ESP_OK) {
@@ -71,70 +89,113 @@ bool EEPROMClass::begin(size_t size) {
       return false;
   }
 
-  size_t key_size = 0;
-  res = nvs_get_blob(_handle, _name, NULL, &key_size);
-  if(res != ESP_OK && res != ESP_ERR_NVS_NOT_FOUND) {
+  _data = (uint8_t*) malloc(size);
+  _dirtyPages = (uint32_t*) calloc(((size + EEPROM_PAGE_SIZE - 1) / EEPROM_PAGE_SIZE + 31) / 32, sizeof(uint32_t));
+  if(!_data || !_dirtyPages) {
+    log_e("Not enough memory for %d bytes in EEPROM", size);
+    free(_data);
+    free(_dirtyPages);
+    _data = 0;
+    _dirtyPages = 0;
+    nvs_close(_handle);
+    return false;
+  }
+  memset(_data, 0xFF, size);
+  _size = size;
+  _dirty = false;
+  _checkPages = false;
+  _lastCommit = 0;
+
+  if (!_load()) {
+    free(_data);
+    free(_dirtyPages);
+    _data = 0;
+    _dirtyPages = 0;
+    _size = 0;
+    nvs_close(_handle);
+    return false;
+  }
+  return true;
+}
+
+// reads the stored pages into _data, a single blob written by older versions or
+// by convert() takes precedence and is converted to pages
+bool EEPROMClass::_load() {
+  char key[16];
+  uint8_t page[EEPROM_PAGE_SIZE];
+  size_t pages = _pageCount();
+  bool truncated = false;
+  size_t n;
+  for (n = 0; ; n++) {
+    size_t len = sizeof(page);
+    snprintf(key, sizeof(key), "#%u", n);
+    esp_err_t res = nvs_get_blob(_handle, key, page, &len);
+    if (res == ESP_ERR_NVS_NOT_FOUND) {
+      break;
+    }
+    if (res != ESP_OK) {
       log_e("Unable to read NVS key: %d", res);
       return false;
+    }
+    if (n >= pages) {
+      nvs_erase_key(_handle, key);
+      truncated = true;
+      continue;
+    }
+    size_t offset = n * EEPROM_PAGE_SIZE;
+    size_t pageLen = min((size_t)EEPROM_PAGE_SIZE, _size - offset);
+    memcpy(_data + offset, page, min(len, pageLen));
+    if (len != pageLen) {
+      // last page of a different size, or a page before a larger last one
+      _markDirty(offset, pageLen);
+    }
   }
-  if (size < key_size) { // truncate
-      log_w("truncating EEPROM from %d to %d", key_size, size);
-      uint8_t* key_data = (uint8_t*) malloc(key_size);
-      if(!key_data) {
-         log_e("Not enough memory to truncate EEPROM!");
-         return false;
-      }
-      nvs_get_blob(_handle, _name, key_data, &key_size);
-      nvs_set_blob(_handle, _name, key_data, size);
-      nvs_commit(_handle);
-      free(key_data);
+  _storedPages = min(n, pages);
+
+  size_t key_size = 0;
+  esp_err_t res = nvs_get_blob(_handle, _name, NULL, &key_size);
+  if (res != ESP_OK && res != ESP_ERR_NVS_NOT_FOUND) {
+    log_e("Unable to read NVS key: %d", res);
+    return false;
   }
-  else if (size > key_size) { // expand or new
-      size_t expand_size = size - key_size;
-      uint8_t* expand_key = (uint8_t*) malloc(expand_size);
-      if(!expand_key) {
-         log_e("Not enough memory to expand EEPROM!");
-         return false;
-      }
-      // check for adequate free space
-      if(nvs_set_blob(_handle, "expand", expand_key, expand_size)) {
-        log_e("Not enough space to expand EEPROM from %d to %d", key_size, size);
-        free(expand_key);
-        return false;
-      }
-      free(expand_key);
-      nvs_erase_key(_handle, "expand");
-      uint8_t* key_data = (uint8_t*) malloc(size);
-      if(!key_data) {
-         log_e("Not enough memory to expand EEPROM!");
-         return false;
-      }
-      memset(key_data, 0xFF, size);
-      if(key_size) {
-        log_i("Expanding EEPROM from %d to %d", key_size, size);
-	// hold data while key is deleted
-        nvs_get_blob(_handle, _name, key_data, &key_size);
-        nvs_erase_key(_handle, _name);
-      } else {
-        log_i("New EEPROM of %d bytes", size);
-      }
-      nvs_commit(_handle);
-      nvs_set_blob(_handle, _name, key_data, size);
+  if (res == ESP_OK && key_size) {
+    uint8_t* key_data = (uint8_t*) malloc(key_size);
+    if (!key_data) {
+      log_e("Not enough memory to convert EEPROM!");
+      return false;
+    }
+    res = nvs_get_blob(_handle, _name, key_data, &key_size);
+    if (res != ESP_OK) {
       free(key_data);
-      nvs_commit(_handle);
+      log_e("Unable to read NVS key: %d", res);
+      return false;
+    }
+    memset(_data, 0xFF, _size);
+    memcpy(_data, key_data, min(key_size, _size));
+    free(key_data);
+    log_i("Converting EEPROM of %d bytes to %d byte pages", key_size, EEPROM_PAGE_SIZE);
+    _markDirty(0, _size);
+    // the blob is only erased once its pages are stored, an interrupted conversion is repeated
+    if (!_writePages()) {
+      return false;
+    }
+    nvs_erase_key(_handle, _name);
+    nvs_commit(_handle);
+    return true;
   }
 
-  if (_data) {
-    delete[] _data;
+  if (truncated) {
+    log_w("truncated EEPROM to %d bytes", _size);
+    return _writePages();
+  }
+  if (!n) {
+    log_i("New EEPROM of %d bytes", _size);
   }
 
-  _data = (uint8_t*) malloc(size);
-  if(!_data) {
-    log_e("Not enough memory for %d bytes in EEPROM", size);
-    return false;
+  // new pages are written with the first commit, the stored ones stay contiguous
+  if (_storedPages < pages) {
+    _markDirty(_storedPages * EEPROM_PAGE_SIZE, _size - _storedPages * EEPROM_PAGE_SIZE);
   }
-  _size = size;
-  nvs_get_blob(_handle, _name, _data, &_size);
   return true;
 }
 
@@ -143,12 +204,15 @@ void EEPROMClass::end() {
     return;
   }
 
-  commit();
-  if (_data) {
-    delete[] _data;
+  if (_dirty) {
+    _writePages();
   }
+  free(_data);
+  free(_dirtyPages);
   _data = 0;
+  _dirtyPages = 0;
   _size = 0;
+  _dirty = false;
 
   nvs_close(_handle);
   _handle = 0;
@@ -176,12 +240,11 @@ void EEPROMClass::write(int address, uint8_t value) {
   if (*pData != value)
   {
     *pData = value;
-    _dirty = true;
+    _markDirty(address, 1);
   }
 }
 
 bool EEPROMClass::commit() {
-  bool ret = false;
   if (!_size) {
     return false;
   }
@@ -191,23 +254,94 @@ bool EEPROMClass::commit() {
   if (!_dirty) {
     return true;
   }
+  if (_commitInterval && _lastCommit && (millis() - _lastCommit) < _commitInterval) {
+    // not written yet, coalesced with a later commit()
+    return false;
+  }
+  return _writePages();
+}
 
-  esp_err_t err = nvs_set_blob(_handle, _name, _data, _size);
-  if (err != ESP_OK) {
-    log_e("error in write: %s", esp_err_to_name(err));
-  } else {
-    _dirty = false;
-    ret = true;
+bool EEPROMClass::flush() {
+  if (!_size || !_data) {
+    return false;
+  }
+  if (!_dirty) {
+    return true;
   }
+  return _writePages();
+}
 
-  return ret;
+void EEPROMClass::setCommitInterval(uint32_t interval) {
+  _commitInterval = interval;
 }
 
 uint8_t * EEPROMClass::getDataPtr() {
-  _dirty = true;
+  // any byte may change, pages are compared with nvs on commit
+  _checkPages = true;
+  _markDirty(0, _size);
   return &_data[0];
 }
 
+void EEPROMClass::_markDirty(size_t address, size_t len) {
+  if (!len || !_dirtyPages) {
+    return;
+  }
+  for (size_t n = address / EEPROM_PAGE_SIZE; n <= (address + len - 1) / EEPROM_PAGE_SIZE; n++) {
+    _dirtyPages[n / 32] |= 1UL << (n % 32);
+  }
+  _dirty = true;
+}
+
+void EEPROMClass::_store(size_t address, const void* value, size_t len) {
+  if (memcmp(_data + address, value, len)) {
+    memcpy(_data + address, value, len);
+    _markDirty(address, len);
+  }
+}
+
+bool EEPROMClass::_writePages() {
+  char key[16];
+  uint8_t stored[EEPROM_PAGE_SIZE];
+  size_t pages = _pageCount();
+  bool ok = true;
+  for (size_t n = 0; n < pages; n++) {
+    uint32_t bit = 1UL << (n % 32);
+    if (!(_dirtyPages[n / 32] & bit)) {
+      continue;
+    }
+    size_t offset = n * EEPROM_PAGE_SIZE;
+    size_t len = min((size_t)EEPROM_PAGE_SIZE, _size - offset);
+    snprintf(key, sizeof(key), "#%u", n);
+    if (_checkPages && n < _storedPages) {
+      size_t stored_len = sizeof(stored);
+      if (nvs_get_blob(_handle, key, stored, &stored_len) == ESP_OK && stored_len == len && !memcmp(stored, _data + offset, len)) {
+        _dirtyPages[n / 32] &= ~bit;
+        continue;
+      }
+    }
+    esp_err_t err = nvs_set_blob(_handle, key, _data + offset, len);
+    if (err != ESP_OK) {
+      log_e("error in write: %s", esp_err_to_name(err));
+      ok = false;
+      if (n >= _storedPages) {
+        break;
+      }
+      continue;
+    }
+    _dirtyPages[n / 32] &= ~bit;
+    if (n == _storedPages) {
+      _storedPages++;
+    }
+  }
+  nvs_commit(_handle);
+  _dirty = !ok;
+  if (ok) {
+    _checkPages = false;
+  }
+  _lastCommit = millis();
+  return ok;
+}
+
 /*
    Get EEPROM total size in byte defined by the user
 */
@@ -516,11 +650,10 @@ size_t EEPROMClass::writeString (int address, const char* value)
     if (value[len] == 0)
       break;
 
-  if (address + len > _size)
+  if (address + len >= _size)
     return 0;
 
-  memcpy(_data + address, (const uint8_t*) value, len + 1);
-  _dirty = true;
+  _store(address, value, len + 1);
   return strlen(value);
 }
 
@@ -537,8 +670,7 @@ size_t EEPROMClass::writeBytes (int address, const void* value, size_t len)
   if (address < 0 || address + len > _size)
     return 0;
 
-  memcpy(_data + address, (const void*) value, len);
-  _dirty = true;
+  _store(address, value, len);
   return len;
 }
 
@@ -547,8 +679,7 @@ template <class T> T EEPROMClass::writeAll (int address, const T &value)
   if (address < 0 || address + sizeof(T) > _size)
     return value;
 
-  memcpy(_data + address, (const uint8_t*) &value, sizeof(T));
-  _dirty = true;
+  _store(address, &value, sizeof(T));
 
   return sizeof (value);
 }
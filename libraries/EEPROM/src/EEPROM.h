@@ -30,6 +30,11 @@
 #endif
 #include <Arduino.h>
 
+// the data is stored as one nvs blob per page, commit() rewrites the changed pages only
+#ifndef EEPROM_PAGE_SIZE
+#define EEPROM_PAGE_SIZE 256
+#endif
+
 typedef uint32_t nvs_handle;
 
 class EEPROMClass {
@@ -44,8 +49,13 @@ class EEPROMClass {
     void write(int address, uint8_t val);
     uint16_t length();
     bool commit();
+    bool flush();
     void end();
 
+    // commit() writes at most once per interval (ms) and returns false while the
+    // changes wait for a later commit(), flush() or end()
+    void setCommitInterval(uint32_t interval);
+
     uint8_t * getDataPtr();
     uint16_t convert(bool clear, const char* EEPROMname = "eeprom", const char* nvsname = "eeprom");
 
@@ -63,8 +73,7 @@ class EEPROMClass {
       if (address < 0 || address + sizeof(T) > _size)
         return t;
 
-      memcpy(_data + address, (const uint8_t*) &t, sizeof(T));
-      _dirty = true;
+      _store(address, (const uint8_t*) &t, sizeof(T));
       return t;
     }
 
@@ -112,6 +121,17 @@ class EEPROMClass {
     size_t _size;
     bool _dirty;
     const char* _name;
+    uint32_t* _dirtyPages;      // bitmap
+    size_t _storedPages;        // pages 0.._storedPages-1 exist in nvs
+    bool _checkPages;           // getDataPtr() was used, compare before writing
+    uint32_t _commitInterval;
+    uint32_t _lastCommit;
+
+    size_t _pageCount() const { return (_size + EEPROM_PAGE_SIZE - 1) / EEPROM_PAGE_SIZE; }
+    void _markDirty(size_t address, size_t len);
+    void _store(size_t address, const void* value, size_t len);
+    bool _load();
+    bool _writePages();
 };
 
 #if !defined(NO_GLOBAL_INSTANCES) && !defined(NO_GLOBAL_EEPROM)
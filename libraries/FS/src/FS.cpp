@@ -220,6 +220,83 @@ void File::rewindDirectory(void)
     _p->rewindDirectory();
 }
 
+bool Dir::next()
+{
+    if (!_impl) {
+        return false;
+    }
+    return _impl->next();
+}
+
+const char* Dir::fileName() const
+{
+    if (!_impl) {
+        return nullptr;
+    }
+    return _impl->fileName();
+}
+
+String Dir::filePath() const
+{
+    if (!_impl) {
+        return String();
+    }
+    return _impl->filePath();
+}
+
+size_t Dir::fileSize()
+{
+    if (!_impl) {
+        return 0;
+    }
+    return _impl->fileSize();
+}
+
+time_t Dir::fileTime()
+{
+    if (!_impl) {
+        return 0;
+    }
+    return _impl->fileTime();
+}
+
+bool Dir::isFile() const
+{
+    if (!_impl) {
+        return false;
+    }
+    return _impl->isFile();
+}
+
+bool Dir::isDirectory() const
+{
+    if (!_impl) {
+        return false;
+    }
+    return _impl->isDirectory();
+}
+
+File Dir::openFile(const char* mode)
+{
+    if (!_impl) {
+        return File();
+    }
+    return File(_impl->openFile(mode));
+}
+
+bool Dir::rewind()
+{
+    if (!_impl) {
+        return false;
+    }
+    return _impl->rewind();
+}
+
+Dir::operator bool() const
+{
+    return _impl != nullptr && *_impl != false;
+}
+
 File FS::open(const String& path, const char* mode, const bool create)
 {
     return open(path.c_str(), mode, create);
@@ -300,6 +377,67 @@ bool FS::rmdir(const String &path)
     return rmdir(path.c_str());
 }
 
+Dir FS::openDir(const char* path)
+{
+    if (!_impl) {
+        return Dir();
+    }
+    return Dir(_impl->openDir(path));
+}
+
+Dir FS::openDir(const String& path)
+{
+    return openDir(path.c_str());
+}
+
+size_t FS::list(const char* path, std::function<bool(Dir &entry)> callback)
+{
+    Dir dir = openDir(path);
+    size_t count = 0;
+    while (dir.next()) {
+        count++;
+        if (!callback(dir)) {
+            break;
+        }
+    }
+    return count;
+}
+
+size_t FS::list(const String& path, std::function<bool(Dir &entry)> callback)
+{
+    return list(path.c_str(), callback);
+}
+
+void FS::clearStatCache()
+{
+    if (_impl) {
+        _impl->clearStatCache();
+    }
+}
+
+uint32_t FS::statCacheHits()
+{
+    if (!_impl) {
+        return 0;
+    }
+    return _impl->statCacheHits();
+}
+
+uint32_t FS::statCacheMisses()
+{
+    if (!_impl) {
+        return 0;
+    }
+    return _impl->statCacheMisses();
+}
+
+void FS::resetStatCacheCounters()
+{
+    if (_impl) {
+        _impl->resetStatCacheCounters();
+    }
+}
+
 
 void FSImpl::mountpoint(const char * mp)
 {
@@ -22,6 +22,7 @@
 #define FS_H
 
 #include <memory>
+#include <functional>
 #include <Arduino.h>
 
 namespace fs
@@ -35,6 +36,8 @@ class File;
 
 class FileImpl;
 typedef std::shared_ptr<FileImpl> FileImplPtr;
+class DirImpl;
+typedef std::shared_ptr<DirImpl> DirImplPtr;
 class FSImpl;
 typedef std::shared_ptr<FSImpl> FSImplPtr;
 
@@ -93,6 +96,38 @@ inline const char *File::fullName() const
 {
     return path();
 }
+
+/*
+ * Lightweight directory listing. Entries come straight from readdir(), no file
+ * is opened; size and time cost a single stat() and only when asked for.
+ *
+ *   Dir dir = LittleFS.openDir("/logs");
+ *   while (dir.next()) {
+ *       Serial.printf("%s %u\n", dir.fileName(), dir.fileSize());
+ *   }
+ */
+class Dir
+{
+public:
+    Dir(DirImplPtr impl = DirImplPtr()) : _impl(impl) { }
+
+    // advances to the next entry, false at the end of the directory
+    bool next();
+    // valid until the following next()
+    const char* fileName() const;
+    String filePath() const;
+    size_t fileSize();
+    time_t fileTime();
+    bool isFile() const;
+    bool isDirectory() const;
+    File openFile(const char* mode = FILE_READ);
+    bool rewind();
+    operator bool() const;
+
+protected:
+    DirImplPtr _impl;
+};
+
 class FS
 {
 public:
@@ -116,6 +151,21 @@ public:
     bool rmdir(const char *path);
     bool rmdir(const String &path);
 
+    Dir openDir(const char* path);
+    Dir openDir(const String& path);
+
+    // calls callback for every entry of path until it returns false,
+    // returns the number of entries visited
+    size_t list(const char* path, std::function<bool(Dir &entry)> callback);
+    size_t list(const String& path, std::function<bool(Dir &entry)> callback);
+
+    // exists(), open() and size() answer from a cache of file metadata which is
+    // kept up to date by this API; call clearStatCache() after changing files
+    // through other means (stdio, ESP-IDF calls)
+    void clearStatCache();
+    uint32_t statCacheHits();
+    uint32_t statCacheMisses();
+    void resetStatCacheCounters();
 
 protected:
     FSImplPtr _impl;
@@ -126,6 +176,7 @@ protected:
 #ifndef FS_NO_GLOBALS
 using fs::FS;
 using fs::File;
+using fs::Dir;
 using fs::SeekMode;
 using fs::SeekSet;
 using fs::SeekCur;
@@ -50,6 +50,22 @@ public:
     virtual operator bool() = 0;
 };
 
+class DirImpl
+{
+public:
+    virtual ~DirImpl() { }
+    virtual bool next() = 0;
+    virtual const char* fileName() const = 0;
+    virtual String filePath() const = 0;
+    virtual size_t fileSize() = 0;
+    virtual time_t fileTime() = 0;
+    virtual bool isFile() const = 0;
+    virtual bool isDirectory() const = 0;
+    virtual FileImplPtr openFile(const char* mode) = 0;
+    virtual bool rewind() = 0;
+    virtual operator bool() const = 0;
+};
+
 class FSImpl
 {
 protected:
@@ -63,8 +79,14 @@ public:
     virtual bool remove(const char* path) = 0;
     virtual bool mkdir(const char *path) = 0;
     virtual bool rmdir(const char *path) = 0;
-    void mountpoint(const char *);
+    virtual DirImplPtr openDir(const char *path) { return DirImplPtr(); }
+    virtual void mountpoint(const char *);
     const char * mountpoint();
+    // metadata cache, implementations without one report no hits and misses
+    virtual void clearStatCache() { }
+    virtual uint32_t statCacheHits() const { return 0; }
+    virtual uint32_t statCacheMisses() const { return 0; }
+    virtual void resetStatCacheCounters() { }
 };
 
 } // namespace fs
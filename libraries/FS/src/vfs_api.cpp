@@ -18,6 +18,186 @@ using namespace fs;
 
 #define DEFAULT_FILE_BUFFER_SIZE 4096
 
+#define STAT_CACHE_LOCK()    do {} while (xSemaphoreTake(_statLock, portMAX_DELAY) != pdPASS)
+#define STAT_CACHE_UNLOCK()  xSemaphoreGive(_statLock)
+
+// mountpoint and path joined on the stack, unless the path is unusually long
+class VFSFullPath
+{
+public:
+    VFSFullPath(const char *mountpoint, const char *path)
+    {
+        size_t mountpointLen = strlen(mountpoint);
+        size_t pathLen = strlen(path);
+        if(mountpointLen + pathLen < sizeof(_buf)) {
+            _path = _buf;
+        } else {
+            _path = (char *)malloc(mountpointLen + pathLen + 1);
+            if(!_path) {
+                log_e("malloc failed");
+                return;
+            }
+        }
+        memcpy(_path, mountpoint, mountpointLen);
+        memcpy(_path + mountpointLen, path, pathLen + 1);
+    }
+
+    ~VFSFullPath()
+    {
+        if(_path != _buf) {
+            free(_path);
+        }
+    }
+
+    operator const char*() const
+    {
+        return _path;
+    }
+
+    VFSFullPath(const VFSFullPath &) = delete;
+    VFSFullPath & operator=(const VFSFullPath &) = delete;
+
+private:
+    char _buf[64];
+    char *_path;
+};
+
+VFSImpl::VFSImpl()
+    : _statTick(0)
+    , _statHits(0)
+    , _statMisses(0)
+    , _statLock(xSemaphoreCreateMutex())
+{
+    if(!_statLock) {
+        log_e("xSemaphoreCreateMutex failed, stat cache disabled");
+    }
+}
+
+VFSImpl::~VFSImpl()
+{
+    if(_statLock) {
+        vSemaphoreDelete(_statLock);
+    }
+}
+
+/*
+ * stat() through the cache. Failed lookups are remembered as well, and paths
+ * only opendir() can resolve (mount points) are reported as empty directories.
+ * refresh skips the cached result and stores the new one.
+ */
+bool VFSImpl::_stat(const char *fpath, struct stat *st, bool refresh)
+{
+    if(!_statLock) {
+        VFSFullPath temp(_mountpoint, fpath);
+        return temp && !::stat(temp, st);
+    }
+
+    STAT_CACHE_LOCK();
+    StatEntry *entry = NULL;
+    StatEntry *victim = &_statCache[0];
+    for(size_t i = 0; i < VFS_STAT_CACHE_SIZE; i++) {
+        StatEntry &e = _statCache[i];
+        if(e.path.length() && e.path == fpath) {
+            entry = &e;
+            break;
+        }
+        if(victim->path.length() && (!e.path.length() || e.used < victim->used)) {
+            victim = &e;
+        }
+    }
+
+    if(entry && !refresh) {
+        _statHits++;
+        entry->used = ++_statTick;
+        bool found = entry->found;
+        if(found) {
+            *st = entry->st;
+        }
+        STAT_CACHE_UNLOCK();
+        return found;
+    }
+
+    _statMisses++;
+    VFSFullPath temp(_mountpoint, fpath);
+    if(!temp) {
+        STAT_CACHE_UNLOCK();
+        return false;
+    }
+    bool found = !::stat(temp, st);
+    if(!found) {
+        DIR * d = opendir(temp);
+        if(d) {
+            closedir(d);
+            memset(st, 0, sizeof(*st));
+            st->st_mode = S_IFDIR;
+            found = true;
+        }
+    }
+
+    if(!entry) {
+        entry = victim;
+        entry->path = fpath;
+    }
+    entry->found = found;
+    if(found) {
+        entry->st = *st;
+    }
+    entry->used = ++_statTick;
+    STAT_CACHE_UNLOCK();
+    return found;
+}
+
+void VFSImpl::_statInvalidate(const char *fpath, bool children)
+{
+    if(!_statLock) {
+        return;
+    }
+    size_t len = strlen(fpath);
+    STAT_CACHE_LOCK();
+    for(size_t i = 0; i < VFS_STAT_CACHE_SIZE; i++) {
+        String &path = _statCache[i].path;
+        if(path == fpath || (children && path.length() > len && path[len] == '/' && !strncmp(path.c_str(), fpath, len))) {
+            path.clear();
+        }
+    }
+    STAT_CACHE_UNLOCK();
+}
+
+void VFSImpl::clearStatCache()
+{
+    if(!_statLock) {
+        return;
+    }
+    STAT_CACHE_LOCK();
+    for(size_t i = 0; i < VFS_STAT_CACHE_SIZE; i++) {
+        _statCache[i].path.clear();
+    }
+    STAT_CACHE_UNLOCK();
+}
+
+void VFSImpl::mountpoint(const char * mp)
+{
+    // nothing cached survives a mount change (card swapped, partition formatted)
+    clearStatCache();
+    FSImpl::mountpoint(mp);
+}
+
+uint32_t VFSImpl::statCacheHits() const
+{
+    return _statHits;
+}
+
+uint32_t VFSImpl::statCacheMisses() const
+{
+    return _statMisses;
+}
+
+void VFSImpl::resetStatCacheCounters()
+{
+    _statHits = 0;
+    _statMisses = 0;
+}
+
 FileImplPtr VFSImpl::open(const char* fpath, const char* mode, const bool create)
 {
     if(!_mountpoint) {
@@ -30,19 +210,9 @@ FileImplPtr VFSImpl::open(const char* fpath, const char* mode, const bool create
         return FileImplPtr();
     }
 
-    char * temp = (char *)malloc(strlen(fpath)+strlen(_mountpoint)+2);
-    if(!temp) {
-        log_e("malloc failed");
-        return FileImplPtr();
-    }
-
-    strcpy(temp, _mountpoint);
-    strcat(temp, fpath);
-
     struct stat st;
-    //file found
-    if(!stat(temp, &st)) {
-        free(temp);
+    //file found (or directory, might be mount point)
+    if(_stat(fpath, &st)) {
         if (S_ISREG(st.st_mode) || S_ISDIR(st.st_mode)) {
             return std::make_shared<VFSFileImpl>(this, fpath, mode);
         }
@@ -50,17 +220,8 @@ FileImplPtr VFSImpl::open(const char* fpath, const char* mode, const bool create
         return FileImplPtr();
     }
 
-    //try to open this as directory (might be mount point)
-    DIR * d = opendir(temp);
-    if(d) {
-        closedir(d);
-        free(temp);
-        return std::make_shared<VFSFileImpl>(this, fpath, mode);
-    }
-
     //file not found but mode permits file creation without folder creation
     if((mode && mode[0] != 'r') && (!create)){
-        free(temp);
         return std::make_shared<VFSFileImpl>(this, fpath, mode);
     }
 
@@ -97,13 +258,11 @@ FileImplPtr VFSImpl::open(const char* fpath, const char* mode, const bool create
         }
 
         free(folder);
-        free(temp);
         return std::make_shared<VFSFileImpl>(this, fpath, mode);
 
     }
 
-    log_e("%s does not exist, no permits for creation", temp);
-    free(temp);
+    log_e("%s%s does not exist, no permits for creation", _mountpoint, fpath);
     return FileImplPtr();
 }
 
@@ -114,12 +273,8 @@ bool VFSImpl::exists(const char* fpath)
         return false;
     }
 
-    VFSFileImpl f(this, fpath, "r");
-    if(f) {
-        f.close();
-        return true;
-    }
-    return false;
+    struct stat st;
+    return _stat(fpath, &st) && (S_ISREG(st.st_mode) || S_ISDIR(st.st_mode));
 }
 
 bool VFSImpl::rename(const char* pathFrom, const char* pathTo)
@@ -137,28 +292,15 @@ bool VFSImpl::rename(const char* pathFrom, const char* pathTo)
         log_e("%s does not exists", pathFrom);
         return false;
     }
-    size_t mountpointLen = strlen(_mountpoint);
-    char * temp1 = (char *)malloc(strlen(pathFrom)+mountpointLen+1);
-    if(!temp1) {
-        log_e("malloc failed");
+    VFSFullPath temp1(_mountpoint, pathFrom);
+    VFSFullPath temp2(_mountpoint, pathTo);
+    if(!temp1 || !temp2) {
         return false;
     }
-    char * temp2 = (char *)malloc(strlen(pathTo)+mountpointLen+1);
-    if(!temp2) {
-        free(temp1);
-        log_e("malloc failed");
-        return false;
-    }
-
-    strcpy(temp1, _mountpoint);
-    strcat(temp1, pathFrom);
-
-    strcpy(temp2, _mountpoint);
-    strcat(temp2, pathTo);
 
     auto rc = ::rename(temp1, temp2);
-    free(temp1);
-    free(temp2);
+    _statInvalidate(pathFrom, true);
+    _statInvalidate(pathTo, true);
     return rc == 0;
 }
 
@@ -174,27 +316,19 @@ bool VFSImpl::remove(const char* fpath)
         return false;
     }
 
-    VFSFileImpl f(this, fpath, "r");
-    if(!f || f.isDirectory()) {
-        if(f) {
-            f.close();
-        }
+    struct stat st;
+    if(!_stat(fpath, &st) || !S_ISREG(st.st_mode)) {
         log_e("%s does not exists or is directory", fpath);
         return false;
     }
-    f.close();
 
-    char * temp = (char *)malloc(strlen(fpath)+strlen(_mountpoint)+1);
+    VFSFullPath temp(_mountpoint, fpath);
     if(!temp) {
-        log_e("malloc failed");
         return false;
     }
 
-    strcpy(temp, _mountpoint);
-    strcat(temp, fpath);
-
     auto rc = unlink(temp);
-    free(temp);
+    _statInvalidate(fpath);
     return rc == 0;
 }
 
@@ -205,28 +339,23 @@ bool VFSImpl::mkdir(const char *fpath)
         return false;
     }
 
-    VFSFileImpl f(this, fpath, "r");
-    if(f && f.isDirectory()) {
-        f.close();
+    struct stat st;
+    bool found = _stat(fpath, &st);
+    if(found && S_ISDIR(st.st_mode)) {
         //log_w("%s already exists", fpath);
         return true;
-    } else if(f) {
-        f.close();
+    } else if(found && S_ISREG(st.st_mode)) {
         log_e("%s is a file", fpath);
         return false;
     }
 
-    char * temp = (char *)malloc(strlen(fpath)+strlen(_mountpoint)+1);
+    VFSFullPath temp(_mountpoint, fpath);
     if(!temp) {
-        log_e("malloc failed");
         return false;
     }
 
-    strcpy(temp, _mountpoint);
-    strcat(temp, fpath);
-
     auto rc = ::mkdir(temp, ACCESSPERMS);
-    free(temp);
+    _statInvalidate(fpath);
     return rc == 0;
 }
 
@@ -242,27 +371,19 @@ bool VFSImpl::rmdir(const char *fpath)
         return false;
     }
 
-    VFSFileImpl f(this, fpath, "r");
-    if(!f || !f.isDirectory()) {
-        if(f) {
-            f.close();
-        }
+    struct stat st;
+    if(!_stat(fpath, &st) || !S_ISDIR(st.st_mode)) {
         log_e("%s does not exists or is a file", fpath);
         return false;
     }
-    f.close();
 
-    char * temp = (char *)malloc(strlen(fpath)+strlen(_mountpoint)+1);
+    VFSFullPath temp(_mountpoint, fpath);
     if(!temp) {
-        log_e("malloc failed");
         return false;
     }
 
-    strcpy(temp, _mountpoint);
-    strcat(temp, fpath);
-
     auto rc = ::rmdir(temp);
-    free(temp);
+    _statInvalidate(fpath, true);
     return rc == 0;
 }
 
@@ -275,30 +396,27 @@ VFSFileImpl::VFSFileImpl(VFSImpl* fs, const char* fpath, const char* mode)
     , _d(NULL)
     , _path(NULL)
     , _isDirectory(false)
+    , _writable(mode && (mode[0] != 'r' || strchr(mode, '+')))
     , _written(false)
 {
-    char * temp = (char *)malloc(strlen(fpath)+strlen(_fs->_mountpoint)+1);
+    VFSFullPath temp(_fs->_mountpoint, fpath);
     if(!temp) {
         return;
     }
 
-    strcpy(temp, _fs->_mountpoint);
-    strcat(temp, fpath);
-
     _path = strdup(fpath);
     if(!_path) {
         log_e("strdup(%s) failed", fpath);
-        free(temp);
         return;
     }
 
-    if(!stat(temp, &_stat)) {
+    if(_fs->_stat(fpath, &_stat)) {
         //file found
         if (S_ISREG(_stat.st_mode)) {
             _isDirectory = false;
             _f = fopen(temp, mode);
             if(!_f) {
-                log_e("fopen(%s) failed", temp);
+                log_e("fopen(%s) failed", (const char *)temp);
             }
             if(_f && (_stat.st_blksize == 0))
             {
@@ -308,28 +426,22 @@ VFSFileImpl::VFSFileImpl(VFSImpl* fs, const char* fpath, const char* mode)
             _isDirectory = true;
             _d = opendir(temp);
             if(!_d) {
-                log_e("opendir(%s) failed", temp);
+                log_e("opendir(%s) failed", (const char *)temp);
             }
         } else {
-            log_e("Unknown type 0x%08X for file %s", ((_stat.st_mode)&_IFMT), temp);
+            log_e("Unknown type 0x%08X for file %s", ((_stat.st_mode)&_IFMT), (const char *)temp);
         }
     } else {
         //file not found
         if(!mode || mode[0] == 'r') {
-            //try to open as directory
-            _d = opendir(temp);
-            if(_d) {
-                _isDirectory = true;
-            } else {
-                _isDirectory = false;
-                //log_w("stat(%s) failed", temp);
-            }
+            _isDirectory = false;
+            //log_w("stat(%s) failed", temp);
         } else {
             //lets create this new file
             _isDirectory = false;
             _f = fopen(temp, mode);
             if(!_f) {
-                log_e("fopen(%s) failed", temp);
+                log_e("fopen(%s) failed", (const char *)temp);
             }
             if(_f && (_stat.st_blksize == 0))
             {
@@ -337,7 +449,10 @@ VFSFileImpl::VFSFileImpl(VFSImpl* fs, const char* fpath, const char* mode)
             } 
         }
     }
-    free(temp);
+    if(_f && _writable) {
+        // created or truncated
+        _fs->_statInvalidate(fpath);
+    }
 }
 
 VFSFileImpl::~VFSFileImpl()
@@ -348,6 +463,9 @@ VFSFileImpl::~VFSFileImpl()
 void VFSFileImpl::close()
 {
     if(_path) {
+        if(_f && _writable) {
+            _fs->_statInvalidate(_path);
+        }
         free(_path);
         _path = NULL;
     }
@@ -367,7 +485,11 @@ VFSFileImpl::operator bool()
 }
 
 time_t VFSFileImpl::getLastWrite() {
-    _getStat() ;
+    if(_written) {
+        _getStat();
+    } else if(_path) {
+        _fs->_stat(_path, &_stat);
+    }
     return _stat.st_mtime;
 }
 
@@ -376,18 +498,9 @@ void VFSFileImpl::_getStat() const
     if(!_path) {
         return;
     }
-    char * temp = (char *)malloc(strlen(_path)+strlen(_fs->_mountpoint)+1);
-    if(!temp) {
-        return;
-    }
-
-    strcpy(temp, _fs->_mountpoint);
-    strcat(temp, _path);
-
-    if(!stat(temp, &_stat)) {
+    if(_fs->_stat(_path, &_stat, true)) {
         _written = false;
     }
-    free(temp);
 }
 
 size_t VFSFileImpl::write(const uint8_t *buf, size_t size)
@@ -416,6 +529,9 @@ void VFSFileImpl::flush()
     fflush(_f);
     // workaround for https://github.com/espressif/arduino-esp32/issues/1293
     fsync(fileno(_f));
+    if(_writable) {
+        _fs->_statInvalidate(_path);
+    }
 }
 
 bool VFSFileImpl::seek(uint32_t pos, SeekMode mode)
@@ -573,3 +689,179 @@ void VFSFileImpl::rewindDirectory(void)
     }
     rewinddir(_d);
 }
+
+DirImplPtr VFSImpl::openDir(const char *fpath)
+{
+    if(!_mountpoint) {
+        log_e("File system is not mounted");
+        return DirImplPtr();
+    }
+
+    if(!fpath || fpath[0] != '/') {
+        log_e("%s does not start with /", fpath);
+        return DirImplPtr();
+    }
+
+    auto dir = std::make_shared<VFSDirImpl>(this, fpath);
+    if(!*dir) {
+        return DirImplPtr();
+    }
+    return dir;
+}
+
+VFSDirImpl::VFSDirImpl(VFSImpl* fs, const char* fpath)
+    : _fs(fs)
+    , _d(NULL)
+    , _path(NULL)
+    , _pathSize(0)
+    , _dirLen(0)
+    , _entry(NULL)
+    , _statDone(false)
+{
+    size_t mountpointLen = strlen(_fs->_mountpoint);
+    size_t pathLen = strlen(fpath);
+
+    // one buffer holds the directory and the current entry name, it only grows for long names
+    _pathSize = mountpointLen + pathLen + 2 + 32;
+    _path = (char *)malloc(_pathSize);
+    if(!_path) {
+        log_e("malloc failed");
+        return;
+    }
+    memcpy(_path, _fs->_mountpoint, mountpointLen);
+    memcpy(_path + mountpointLen, fpath, pathLen + 1);
+    _dirLen = mountpointLen + pathLen;
+
+    _d = opendir(_path);
+    if(!_d) {
+        return;
+    }
+    if(_path[_dirLen - 1] != '/') {
+        _path[_dirLen++] = '/';
+        _path[_dirLen] = '\0';
+    }
+}
+
+VFSDirImpl::~VFSDirImpl()
+{
+    if(_d) {
+        closedir(_d);
+    }
+    free(_path);
+}
+
+bool VFSDirImpl::next()
+{
+    if(!_d) {
+        return false;
+    }
+    do {
+        _entry = readdir(_d);
+    } while(_entry && ((_entry->d_type != DT_REG && _entry->d_type != DT_DIR)
+                       || !strcmp(_entry->d_name, ".") || !strcmp(_entry->d_name, "..")));
+    _statDone = false;
+    if(!_entry) {
+        _path[_dirLen] = '\0';
+        return false;
+    }
+
+    const char *name = _entry->d_name;
+    if(name[0] == '/') {
+        name++;
+    }
+    size_t nameLen = strlen(name);
+    if(_dirLen + nameLen + 1 > _pathSize) {
+        char *path = (char *)realloc(_path, _dirLen + nameLen + 1);
+        if(!path) {
+            log_e("realloc failed");
+            _entry = NULL;
+            _path[_dirLen] = '\0';
+            return false;
+        }
+        _path = path;
+        _pathSize = _dirLen + nameLen + 1;
+    }
+    memcpy(_path + _dirLen, name, nameLen + 1);
+    return true;
+}
+
+const char* VFSDirImpl::fileName() const
+{
+    if(!_entry) {
+        return NULL;
+    }
+    return _path + _dirLen;
+}
+
+String VFSDirImpl::filePath() const
+{
+    if(!_entry) {
+        return String();
+    }
+    return String(_path + strlen(_fs->_mountpoint));
+}
+
+void VFSDirImpl::_getStat()
+{
+    if(_statDone) {
+        return;
+    }
+    _statDone = true;
+    // listings would only churn the stat cache, so go to the file system directly
+    if(stat(_path, &_stat)) {
+        memset(&_stat, 0, sizeof(_stat));
+    }
+}
+
+size_t VFSDirImpl::fileSize()
+{
+    if(!_entry || _entry->d_type != DT_REG) {
+        return 0;
+    }
+    _getStat();
+    return _stat.st_size;
+}
+
+time_t VFSDirImpl::fileTime()
+{
+    if(!_entry) {
+        return 0;
+    }
+    _getStat();
+    return _stat.st_mtime;
+}
+
+bool VFSDirImpl::isFile() const
+{
+    return _entry && _entry->d_type == DT_REG;
+}
+
+bool VFSDirImpl::isDirectory() const
+{
+    return _entry && _entry->d_type == DT_DIR;
+}
+
+FileImplPtr VFSDirImpl::openFile(const char* mode)
+{
+    if(!_entry) {
+        return FileImplPtr();
+    }
+    return _fs->open(_path + strlen(_fs->_mountpoint), mode, false);
+}
+
+bool VFSDirImpl::rewind()
+{
+    if(!_d) {
+        return false;
+    }
+    rewinddir(_d);
+    _entry = NULL;
+    _statDone = false;
+    _path[_dirLen] = '\0';
+    return true;
+}
+
+VFSDirImpl::operator bool() const
+{
+    return _d != NULL;
+}
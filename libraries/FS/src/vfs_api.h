@@ -26,6 +26,14 @@ extern "C" {
 
 using namespace fs;
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// number of paths whose stat() result is remembered per file system
+#ifndef VFS_STAT_CACHE_SIZE
+#define VFS_STAT_CACHE_SIZE 8
+#endif
+
 class VFSFileImpl;
 
 class VFSImpl : public FSImpl
@@ -33,14 +41,40 @@ class VFSImpl : public FSImpl
 
 protected:
     friend class VFSFileImpl;
+    friend class VFSDirImpl;
+
+    struct StatEntry {
+        String      path;   // empty when unused
+        bool        found;
+        struct stat st;
+        uint32_t    used;
+    };
+
+    StatEntry         _statCache[VFS_STAT_CACHE_SIZE];
+    uint32_t          _statTick;
+    uint32_t          _statHits;
+    uint32_t          _statMisses;
+    SemaphoreHandle_t _statLock;
+
+    bool _stat(const char *fpath, struct stat *st, bool refresh = false);
+    void _statInvalidate(const char *fpath, bool children = false);
 
 public:
+    VFSImpl();
+    ~VFSImpl() override;
     FileImplPtr open(const char* path, const char* mode, const bool create) override;
     bool        exists(const char* path) override;
     bool        rename(const char* pathFrom, const char* pathTo) override;
     bool        remove(const char* path) override;
     bool        mkdir(const char *path) override;
     bool        rmdir(const char *path) override;
+    DirImplPtr  openDir(const char *path) override;
+    using       FSImpl::mountpoint;
+    void        mountpoint(const char *) override;
+    void        clearStatCache() override;
+    uint32_t    statCacheHits() const override;
+    uint32_t    statCacheMisses() const override;
+    void        resetStatCacheCounters() override;
 };
 
 class VFSFileImpl : public FileImpl
@@ -51,6 +85,7 @@ protected:
     DIR *               _d;
     char *              _path;
     bool                _isDirectory;
+    bool                _writable;
     mutable struct stat _stat;
     mutable bool        _written;
 
@@ -79,4 +114,33 @@ public:
     operator    bool();
 };
 
+class VFSDirImpl : public DirImpl
+{
+protected:
+    VFSImpl*        _fs;
+    DIR *           _d;
+    char *          _path;      // full path of the current entry
+    size_t          _pathSize;
+    size_t          _dirLen;    // length of the directory part, including '/'
+    struct dirent * _entry;
+    struct stat     _stat;
+    bool            _statDone;
+
+    void _getStat();
+
+public:
+    VFSDirImpl(VFSImpl* fs, const char* path);
+    ~VFSDirImpl() override;
+    bool        next() override;
+    const char* fileName() const override;
+    String      filePath() const override;
+    size_t      fileSize() override;
+    time_t      fileTime() override;
+    bool        isFile() const override;
+    bool        isDirectory() const override;
+    FileImplPtr openFile(const char* mode) override;
+    bool        rewind() override;
+    operator    bool() const override;
+};
+
 #endif
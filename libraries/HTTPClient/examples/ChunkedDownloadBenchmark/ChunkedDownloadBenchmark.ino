@@ -0,0 +1,80 @@
+/**
+ * ChunkedDownloadBenchmark.ino
+ *
+ * Downloads a 1 MB chunked body from a local test server and prints the throughput.
+ * Start chunked_server.py on a PC in the same network and set SERVER_URL to its address.
+ *
+ */
+
+#include <Arduino.h>
+
+#include <WiFi.h>
+#include <WiFiMulti.h>
+
+#include <HTTPClient.h>
+
+#define USE_SERIAL Serial
+
+#define SERVER_URL "http://192.168.1.12:8080/chunked"
+
+WiFiMulti wifiMulti;
+
+// discards the payload, only counts it
+class NullStream : public Stream {
+public:
+    size_t count = 0;
+    size_t write(uint8_t) override { count++; return 1; }
+    size_t write(const uint8_t *buffer, size_t size) override { count += size; return size; }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override {}
+};
+
+void setup() {
+
+    USE_SERIAL.begin(115200);
+
+    USE_SERIAL.println();
+    USE_SERIAL.println();
+    USE_SERIAL.println();
+
+    for(uint8_t t = 4; t > 0; t--) {
+        USE_SERIAL.printf("[SETUP] WAIT %d...\n", t);
+        USE_SERIAL.flush();
+        delay(1000);
+    }
+
+    wifiMulti.addAP("SSID", "PASSWORD");
+
+}
+
+void loop() {
+    // wait for WiFi connection
+    if((wifiMulti.run() == WL_CONNECTED)) {
+
+        HTTPClient http;
+        NullStream sink;
+
+        http.begin(SERVER_URL);
+
+        uint32_t start = millis();
+        int httpCode = http.GET();
+        if(httpCode == HTTP_CODE_OK) {
+            int written = http.writeToStream(&sink);
+            uint32_t elapsed = millis() - start;
+            if(written < 0) {
+                USE_SERIAL.printf("[HTTP] download failed, error: %s\n", http.errorToString(written).c_str());
+            } else {
+                USE_SERIAL.printf("[HTTP] %u bytes in %u ms, %.1f KB/s, free heap %u\n",
+                                  (unsigned) sink.count, (unsigned) elapsed, elapsed ? sink.count / 1.024 / elapsed : 0.0, (unsigned) ESP.getFreeHeap());
+            }
+        } else {
+            USE_SERIAL.printf("[HTTP] GET... failed, error: %s\n", http.errorToString(httpCode).c_str());
+        }
+
+        http.end();
+    }
+
+    delay(5000);
+}
@@ -0,0 +1,27 @@
+# This python script serves a 1 MB body with chunked transfer encoding
+# on port 8080 for the ChunkedDownloadBenchmark example
+import sys
+from http.server import BaseHTTPRequestHandler, HTTPServer
+
+BODY_SIZE = 1024 * 1024
+CHUNK_SIZE = 1460
+
+class ChunkedHandler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def do_GET(self):
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/octet-stream')
+        self.send_header('Transfer-Encoding', 'chunked')
+        self.end_headers()
+        chunk = bytes(i % 256 for i in range(CHUNK_SIZE))
+        left = BODY_SIZE
+        while left > 0:
+            n = min(left, CHUNK_SIZE)
+            self.wfile.write(b'%x\r\n' % n + chunk[:n] + b'\r\n')
+            left -= n
+        self.wfile.write(b'0\r\n\r\n')
+
+port = int(sys.argv[1]) if len(sys.argv) > 1 else 8080
+print('Server listening on port %d' % port)
+HTTPServer(('', port), ChunkedHandler).serve_forever()
@@ -39,6 +39,11 @@
 
 #include "HTTPClient.h"
 
+#include <new>
+#ifdef HTTPCLIENT_1_1_COMPATIBLE
+#include <mbedtls/sha256.h>
+#endif
+
 /// Cookie jar support
 #include <time.h>
 
@@ -59,6 +64,12 @@ public:
     {
         return true;
     }
+
+    // identifies the credentials a pooled connection was verified with
+    virtual String poolTag()
+    {
+        return String();
+    }
 };
 
 class TLSTraits : public TransportTraits
@@ -87,13 +98,241 @@ public:
         return true;
     }
 
+    // SHA-256 of the PEM contents, the same credentials can live at different addresses
+    String poolTag() override
+    {
+        uint8_t hash[32];
+        mbedtls_sha256_context ctx;
+        mbedtls_sha256_init(&ctx);
+        mbedtls_sha256_starts(&ctx, false);
+        _hashPEM(&ctx, _cacert);
+        _hashPEM(&ctx, _clicert);
+        _hashPEM(&ctx, _clikey);
+        mbedtls_sha256_finish(&ctx, hash);
+        mbedtls_sha256_free(&ctx);
+
+        char tag[2 * sizeof(hash) + 2];
+        tag[0] = '#';
+        for(size_t i = 0; i < sizeof(hash); i++) {
+            snprintf(tag + 1 + 2 * i, 3, "%02x", hash[i]);
+        }
+        return String(tag);
+    }
+
 protected:
+    static void _hashPEM(mbedtls_sha256_context* ctx, const char* pem)
+    {
+        // a missing credential must not hash like an empty one
+        const unsigned char present = pem != nullptr;
+        mbedtls_sha256_update(ctx, &present, 1);
+        if(pem) {
+            mbedtls_sha256_update(ctx, (const unsigned char*)pem, strlen(pem) + 1);
+        }
+    }
+
+
     const char* _cacert;
     const char* _clicert;
     const char* _clikey;
 };
+
+#define POOL_MUTEX_LOCK()    do {} while (xSemaphoreTake(_lock, portMAX_DELAY) != pdPASS)
+#define POOL_MUTEX_UNLOCK()  xSemaphoreGive(_lock)
+
+HTTPConnectionPool::HTTPConnectionPool(uint8_t maxSockets, unsigned long idleTimeout) :
+    _maxSockets(maxSockets), _idleTimeout(idleTimeout)
+{
+    _lock = xSemaphoreCreateMutex();
+    if(_lock == NULL) {
+        log_e("xSemaphoreCreateMutex failed");
+        abort();
+    }
+    _idle.reserve(maxSockets);
+}
+
+HTTPConnectionPool::~HTTPConnectionPool()
+{
+    clear();
+    vSemaphoreDelete(_lock);
+}
+
+void HTTPConnectionPool::setMaxSockets(uint8_t maxSockets)
+{
+    POOL_MUTEX_LOCK();
+    _maxSockets = maxSockets;
+    while(_idle.size() > _maxSockets) {
+        _idle.front().client->stop();
+        _idle.erase(_idle.begin());
+    }
+    POOL_MUTEX_UNLOCK();
+}
+
+void HTTPConnectionPool::setIdleTimeout(unsigned long idleTimeout_ms)
+{
+    _idleTimeout = idleTimeout_ms;
+}
+
+void HTTPConnectionPool::_evictIdle(unsigned long now)
+{
+    for(size_t i = 0; i < _idle.size();) {
+        if(now - _idle[i].released >= _idleTimeout) {
+            log_d("closing idle connection to %s", _idle[i].key.c_str());
+            _idle[i].client->stop();
+            _idle.erase(_idle.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+std::unique_ptr<WiFiClient> HTTPConnectionPool::acquire(const String& key)
+{
+    std::unique_ptr<WiFiClient> client;
+    POOL_MUTEX_LOCK();
+    _evictIdle(millis());
+    // most recently released first, it is the most likely to be still open
+    for(size_t i = _idle.size(); i-- > 0;) {
+        if(_idle[i].key != key) {
+            continue;
+        }
+        std::unique_ptr<WiFiClient> candidate = std::move(_idle[i].client);
+        _idle.erase(_idle.begin() + i);
+        // leftover data means the previous response was not consumed or the server closed
+        if(candidate->connected() && candidate->available() == 0) {
+            client = std::move(candidate);
+            break;
+        }
+        log_d("dropping stale connection to %s", key.c_str());
+        candidate->stop();
+    }
+    if(client) {
+        _hits++;
+    } else {
+        _misses++;
+    }
+    POOL_MUTEX_UNLOCK();
+    return client;
+}
+
+void HTTPConnectionPool::release(const String& key, std::unique_ptr<WiFiClient> client)
+{
+    if(!client) {
+        return;
+    }
+    if(!_maxSockets || !client->connected()) {
+        client->stop();
+        return;
+    }
+    unsigned long now = millis();
+    POOL_MUTEX_LOCK();
+    _evictIdle(now);
+    if(_idle.size() >= _maxSockets) {
+        log_d("pool full, closing connection to %s", _idle.front().key.c_str());
+        _idle.front().client->stop();
+        _idle.erase(_idle.begin());
+    }
+    _idle.push_back({key, std::move(client), now});
+    POOL_MUTEX_UNLOCK();
+}
+
+void HTTPConnectionPool::evictIdle()
+{
+    POOL_MUTEX_LOCK();
+    _evictIdle(millis());
+    POOL_MUTEX_UNLOCK();
+}
+
+void HTTPConnectionPool::clear()
+{
+    POOL_MUTEX_LOCK();
+    for(Entry& entry : _idle) {
+        entry.client->stop();
+    }
+    _idle.clear();
+    POOL_MUTEX_UNLOCK();
+}
+
+size_t HTTPConnectionPool::idle()
+{
+    POOL_MUTEX_LOCK();
+    size_t count = _idle.size();
+    POOL_MUTEX_UNLOCK();
+    return count;
+}
 #endif // HTTPCLIENT_1_1_COMPATIBLE
 
+bool HTTPHeaderList::add(const char* name, size_t nameLen, const char* value, size_t valueLen, bool first, bool replace)
+{
+    if(replace) {
+        int i = indexOf(name, nameLen);
+        if(i >= 0) {
+            remove(i);
+        }
+    }
+    size_t offset = _arena.size();
+    if(offset + nameLen + valueLen > UINT16_MAX || nameLen > UINT16_MAX || valueLen > UINT16_MAX) {
+        log_e("request headers too large");
+        return false;
+    }
+    _arena.insert(_arena.end(), name, name + nameLen);
+    _arena.insert(_arena.end(), value, value + valueLen);
+    Slice slice = { (uint16_t)offset, (uint16_t)nameLen, (uint16_t)valueLen };
+    if(first) {
+        _slices.insert(_slices.begin(), slice);
+    } else {
+        _slices.push_back(slice);
+    }
+    return true;
+}
+
+int HTTPHeaderList::indexOf(const char* name, size_t nameLen) const
+{
+    for(size_t i = 0; i < _slices.size(); i++) {
+        if(_slices[i].nameLen == nameLen && strncasecmp(&_arena[_slices[i].name], name, nameLen) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void HTTPHeaderList::remove(size_t i)
+{
+    if(i >= _slices.size()) {
+        return;
+    }
+    Slice removed = _slices[i];
+    size_t len = removed.nameLen + removed.valueLen;
+    _arena.erase(_arena.begin() + removed.name, _arena.begin() + removed.name + len);
+    _slices.erase(_slices.begin() + i);
+    for(Slice& slice : _slices) {
+        if(slice.name > removed.name) {
+            slice.name -= len;
+        }
+    }
+}
+
+void HTTPHeaderList::clear()
+{
+    _slices.clear();
+    _arena.clear();
+}
+
+size_t HTTPHeaderList::length() const
+{
+    return _arena.size() + _slices.size() * 4;
+}
+
+void HTTPHeaderList::appendTo(String& out) const
+{
+    for(const Slice& slice : _slices) {
+        const char* name = &_arena[slice.name];
+        out.concat(name, slice.nameLen);
+        out.concat(": ", 2);
+        out.concat(name + slice.nameLen, slice.valueLen);
+        out.concat("\r\n", 2);
+    }
+}
+
 /**
  * constructor
  */
@@ -124,7 +363,7 @@ void HTTPClient::clear()
 {
     _returnCode = 0;
     _size = -1;
-    _headers = "";
+    _headers.clear();
 }
 
 
@@ -295,7 +534,14 @@ bool HTTPClient::beginInternal(String url, const char* expectedProtocol)
     }
     if(_host != the_host && connected()){
         log_d("switching host from '%s' to '%s'. disconnecting first", _host.c_str(), the_host.c_str());
+#ifdef HTTPCLIENT_1_1_COMPATIBLE
+        // a pooled connection is parked for later instead of being closed
+        if(!_pool || !_tcpDeprecated) {
+            _canReuse = false;
+        }
+#else
         _canReuse = false;
+#endif
         disconnect(true);
     }
     _host = the_host;
@@ -389,7 +635,24 @@ void HTTPClient::disconnect(bool preserveClient)
                 _client->flush();
         }
 
-        if(_reuse && _canReuse) {
+        bool reuse = _reuse && _canReuse;
+#ifdef HTTPCLIENT_1_1_COMPATIBLE
+        if(reuse && _pool && _tcpDeprecated && !_bodyDone) {
+            // the unread rest of the body would be taken as the next response by another client
+            log_d("response body not consumed, not pooling");
+            reuse = false;
+        }
+#endif
+
+        if(reuse) {
+#ifdef HTTPCLIENT_1_1_COMPATIBLE
+            if(_pool && _tcpDeprecated) {
+                log_d("tcp returned to pool");
+                _pool->release(_poolKey, std::move(_tcpDeprecated));
+                _client = nullptr;
+                return;
+            }
+#endif
             log_d("tcp keep open for reuse");
         } else {
             log_d("tcp stop");
@@ -432,6 +695,30 @@ void HTTPClient::setReuse(bool reuse)
     _reuse = reuse;
 }
 
+#ifdef HTTPCLIENT_1_1_COMPATIBLE
+/**
+ * take idle connections from and return them to a pool shared with other clients
+ * only applies to connections created by begin(url), not to a supplied client
+ * @param pool HTTPConnectionPool*, must outlive this client
+ */
+void HTTPClient::setConnectionPool(HTTPConnectionPool* pool)
+{
+    _pool = pool;
+}
+
+/**
+ * key of the current target in the connection pool
+ */
+String HTTPClient::poolKey()
+{
+    String key = _protocol + "://" + _host + ":" + String(_port);
+    if(_transportTraits) {
+        key += _transportTraits->poolTag();
+    }
+    return key;
+}
+#endif
+
 /**
  * set User Agent
  * @param userAgent const char *
@@ -640,6 +927,9 @@ int HTTPClient::sendRequest(const char * type, uint8_t * payload, size_t size)
 
         code = handleHeaderResponse();
         log_d("sendRequest code=%d\n", code);
+        if(!strcmp(type, "HEAD")) {
+            _bodyDone = true;
+        }
 
         // Handle redirections as stated in RFC document:
         // https://www.w3.org/Protocols/rfc2616/rfc2616-sec10.html
@@ -848,7 +1138,11 @@ int HTTPClient::sendRequest(const char * type, Stream * stream, size_t size)
     }
 
     // handle Server Response (Header)
-    return returnError(handleHeaderResponse());
+    int code = handleHeaderResponse();
+    if(!strcmp(type, "HEAD")) {
+        _bodyDone = true;
+    }
+    return returnError(code);
 }
 
 /**
@@ -917,54 +1211,9 @@ int HTTPClient::writeToStream(Stream * stream)
             return returnError(ret);
         }
     } else if(_transferEncoding == HTTPC_TE_CHUNKED) {
-        int size = 0;
-        while(1) {
-            if(!connected()) {
-                return returnError(HTTPC_ERROR_CONNECTION_LOST);
-            }
-            String chunkHeader = _client->readStringUntil('\n');
-
-            if(chunkHeader.length() <= 0) {
-                return returnError(HTTPC_ERROR_READ_TIMEOUT);
-            }
-
-            chunkHeader.trim(); // remove \r
-
-            // read size of chunk
-            len = (uint32_t) strtol((const char *) chunkHeader.c_str(), NULL, 16);
-            size += len;
-            log_d(" read chunk len: %d", len);
-
-            // data left?
-            if(len > 0) {
-                int r = writeToStreamDataBlock(stream, len);
-                if(r < 0) {
-                    // error in writeToStreamDataBlock
-                    return returnError(r);
-                }
-                ret += r;
-            } else {
-
-                // if no length Header use global chunk size
-                if(_size <= 0) {
-                    _size = size;
-                }
-
-                // check if we have write all data out
-                if(ret != _size) {
-                    return returnError(HTTPC_ERROR_STREAM_WRITE);
-                }
-                break;
-            }
-
-            // read trailing \r\n at the end of the chunk
-            char buf[2];
-            auto trailing_seq_len = _client->readBytes((uint8_t*)buf, 2);
-            if (trailing_seq_len != 2 || buf[0] != '\r' || buf[1] != '\n') {
-                return returnError(HTTPC_ERROR_READ_TIMEOUT);
-            }
-
-            delay(0);
+        ret = writeToStreamChunked(stream);
+        if(ret < 0) {
+            return returnError(ret);
         }
     } else {
         return returnError(HTTPC_ERROR_ENCODING);
@@ -1045,24 +1294,7 @@ void HTTPClient::addHeader(const String& name, const String& value, bool first,
        !name.equalsIgnoreCase(F("Host")) &&
        !(name.equalsIgnoreCase(F("Authorization")) && _base64Authorization.length())){
 
-        String headerLine = name;
-        headerLine += ": ";
-
-        if (replace) {
-            int headerStart = _headers.indexOf(headerLine);
-            if (headerStart != -1 && (headerStart == 0 || _headers[headerStart - 1] == '\n')) {
-                int headerEnd = _headers.indexOf('\n', headerStart);
-                _headers = _headers.substring(0, headerStart) + _headers.substring(headerEnd + 1);
-            }
-        }
-
-        headerLine += value;
-        headerLine += "\r\n";
-        if(first) {
-            _headers = headerLine + _headers;
-        } else {
-            _headers += headerLine;
-        }
+        _headers.add(name.c_str(), name.length(), value.c_str(), value.length(), first, replace);
     }
 }
 
@@ -1125,6 +1357,22 @@ bool HTTPClient::hasHeader(const char* name)
  */
 bool HTTPClient::connect(void)
 {
+#ifdef HTTPCLIENT_1_1_COMPATIBLE
+    String key;
+    if(_pool && _transportTraits) {
+        key = poolKey();
+        // the target changed without the host name changing (port, scheme or credentials)
+        if(_tcpDeprecated && _poolKey != key && connected()) {
+            if(_reuse && _canReuse) {
+                _pool->release(_poolKey, std::move(_tcpDeprecated));
+            } else {
+                _tcpDeprecated->stop();
+                _tcpDeprecated.reset(nullptr);
+            }
+            _client = nullptr;
+        }
+    }
+#endif
     if(connected()) {
         if(_reuse) {
             log_d("already connected, reusing connection");
@@ -1139,6 +1387,17 @@ bool HTTPClient::connect(void)
 
 #ifdef HTTPCLIENT_1_1_COMPATIBLE
      if(_transportTraits && !_client) {
+        if(_pool) {
+            _tcpDeprecated = _pool->acquire(key);
+            if(_tcpDeprecated) {
+                _client = _tcpDeprecated.get();
+                _poolKey = key;
+                _client->setTimeout((_tcpTimeout + 500) / 1000);
+                log_d("reusing pooled connection to %s:%u", _host.c_str(), _port);
+                return true;
+            }
+        }
+        _poolKey = key;
         _tcpDeprecated = _transportTraits->create();
         if(!_tcpDeprecated) {
             log_e("failed to create client");
@@ -1189,7 +1448,13 @@ bool HTTPClient::sendHeader(const char * type)
         return false;
     }
 
-    String header = String(type) + " " + _uri + F(" HTTP/1.");
+    String header;
+    header.reserve(strlen(type) + _uri.length() + _host.length() + _userAgent.length() +
+                   _authorizationType.length() + _base64Authorization.length() + _headers.length() + 160);
+    header += type;
+    header += ' ';
+    header += _uri;
+    header += F(" HTTP/1.");
 
     if(_useHTTP10) {
         header += "0";
@@ -1226,7 +1491,8 @@ bool HTTPClient::sendHeader(const char * type)
         header += "\r\n";
     }
 
-    header += _headers + "\r\n";
+    _headers.appendTo(header);
+    header += "\r\n";
 
     return (_client->write((const uint8_t *) header.c_str(), header.length()) == header.length());
 }
@@ -1245,115 +1511,221 @@ int HTTPClient::handleHeaderResponse()
     _returnCode = 0;
     _size = -1;
     _canReuse = _reuse;
-
-    String transferEncoding;
+    _bodyDone = false;
 
     _transferEncoding = HTTPC_TE_IDENTITY;
-    unsigned long lastDataTime = millis();
+    bool encodingSupported = true;
     bool firstLine = true;
     String date;
 
-    while(connected()) {
-        size_t len = _client->available();
-        if(len > 0) {
-            String headerLine = _client->readStringUntil('\n');
-            headerLine.trim(); // remove \r
+    while(true) {
+        int len = readHeaderLine();
+        if(len < 0) {
+            return len;
+        }
+        char * headerLine = _line.get();
 
-            lastDataTime = millis();
+        log_v("RX: '%s'", headerLine);
 
-            log_v("RX: '%s'", headerLine.c_str());
+        if(firstLine) {
+            firstLine = false;
+            if(_canReuse && strncmp(headerLine, "HTTP/1.", sizeof "HTTP/1." - 1) == 0) {
+                _canReuse = (headerLine[sizeof "HTTP/1." - 1] != '0');
+            }
+            const char * codePos = strchr(headerLine, ' ');
+            _returnCode = codePos ? atoi(codePos + 1) : 0;
+        } else if(len > 0) {
+            char * headerValue = strchr(headerLine, ':');
+            if(!headerValue) {
+                continue;
+            }
+            *headerValue++ = 0;
+            while(*headerValue == ' ' || *headerValue == '\t') {
+                headerValue++;
+            }
+            const char * headerName = headerLine;
 
-            if(firstLine) {
-		        firstLine = false;
-                if(_canReuse && headerLine.startsWith("HTTP/1.")) {
-                    _canReuse = (headerLine[sizeof "HTTP/1." - 1] != '0');
-                }
-                int codePos = headerLine.indexOf(' ') + 1;
-                _returnCode = headerLine.substring(codePos, headerLine.indexOf(' ', codePos)).toInt();
-            } else if(headerLine.indexOf(':')) {
-                String headerName = headerLine.substring(0, headerLine.indexOf(':'));
-                String headerValue = headerLine.substring(headerLine.indexOf(':') + 1);
-                headerValue.trim();
-
-                if(headerName.equalsIgnoreCase("Date")) {
-                    date = headerValue;
-                }
+            if(strcasecmp(headerName, "Date") == 0) {
+                date = headerValue;
+            }
 
-                if(headerName.equalsIgnoreCase("Content-Length")) {
-                    _size = headerValue.toInt();
-                }
+            if(strcasecmp(headerName, "Content-Length") == 0) {
+                _size = atoi(headerValue);
+            }
 
-                if(_canReuse && headerName.equalsIgnoreCase("Connection")) {
-                    if(headerValue.indexOf("close") >= 0 && headerValue.indexOf("keep-alive") < 0) {
-                        _canReuse = false;
-                    }
+            if(_canReuse && strcasecmp(headerName, "Connection") == 0) {
+                if(strstr(headerValue, "close") && !strstr(headerValue, "keep-alive")) {
+                    _canReuse = false;
                 }
+            }
 
-                if(headerName.equalsIgnoreCase("Transfer-Encoding")) {
-                    transferEncoding = headerValue;
+            if(strcasecmp(headerName, "Transfer-Encoding") == 0) {
+                log_d("Transfer-Encoding: %s", headerValue);
+                encodingSupported = true;
+                if(strcasecmp(headerValue, "chunked") == 0) {
+                    _transferEncoding = HTTPC_TE_CHUNKED;
+                } else if(strcasecmp(headerValue, "identity") == 0) {
+                    _transferEncoding = HTTPC_TE_IDENTITY;
+                } else {
+                    encodingSupported = false;
                 }
+            }
 
-                if (headerName.equalsIgnoreCase("Location")) {
-                    _location = headerValue;
-                }
+            if(strcasecmp(headerName, "Location") == 0) {
+                _location = headerValue;
+            }
 
-                if (headerName.equalsIgnoreCase("Set-Cookie")) {
-                    setCookie(date, headerValue);
-                }
+            if(strcasecmp(headerName, "Set-Cookie") == 0) {
+                setCookie(date, headerValue);
+            }
 
-                for (size_t i = 0; i < _headerKeysCount; i++) {
-                    if (_currentHeaders[i].key.equalsIgnoreCase(headerName)) {
-                        // Uncomment the following lines if you need to add support for multiple headers with the same key:
-                        // if (!_currentHeaders[i].value.isEmpty()) {
-                        //     // Existing value, append this one with a comma
-                        //     _currentHeaders[i].value += ',';
-                        //     _currentHeaders[i].value += headerValue;
-                        // } else {
-                        _currentHeaders[i].value = headerValue;
-                        // }
-                        break; // We found a match, stop looking
-                    }
+            for(size_t i = 0; i < _headerKeysCount; i++) {
+                if(strcasecmp(_currentHeaders[i].key.c_str(), headerName) == 0) {
+                    // Uncomment the following lines if you need to add support for multiple headers with the same key:
+                    // if (!_currentHeaders[i].value.isEmpty()) {
+                    //     // Existing value, append this one with a comma
+                    //     _currentHeaders[i].value += ',';
+                    //     _currentHeaders[i].value += headerValue;
+                    // } else {
+                    _currentHeaders[i].value = headerValue;
+                    // }
+                    break; // We found a match, stop looking
                 }
-
             }
+        }
 
-            if(headerLine == "") {
-                log_d("code: %d", _returnCode);
+        if(len == 0) {
+            log_d("code: %d", _returnCode);
 
-                if(_size > 0) {
-                    log_d("size: %d", _size);
-                }
+            if(_size > 0) {
+                log_d("size: %d", _size);
+            }
 
-                if(transferEncoding.length() > 0) {
-                    log_d("Transfer-Encoding: %s", transferEncoding.c_str());
-                    if(transferEncoding.equalsIgnoreCase("chunked")) {
-                        _transferEncoding = HTTPC_TE_CHUNKED;
-                    } else if(transferEncoding.equalsIgnoreCase("identity")) {
-                        _transferEncoding = HTTPC_TE_IDENTITY;
-                    } else {
-                        return HTTPC_ERROR_ENCODING;
-                    }
-                } else {
-                    _transferEncoding = HTTPC_TE_IDENTITY;
-                }
+            if(!encodingSupported) {
+                return HTTPC_ERROR_ENCODING;
+            }
 
-                if(_returnCode) {
-                    return _returnCode;
-                } else {
-                    log_d("Remote host is not an HTTP Server!");
-                    return HTTPC_ERROR_NO_HTTP_SERVER;
-                }
+            // responses without a body leave the connection ready for the next request
+            _bodyDone = (_transferEncoding == HTTPC_TE_IDENTITY && _size == 0) ||
+                        (_returnCode >= 100 && _returnCode < 200) ||
+                        _returnCode == HTTP_CODE_NO_CONTENT || _returnCode == HTTP_CODE_NOT_MODIFIED;
+
+            if(_returnCode) {
+                return _returnCode;
+            } else {
+                log_d("Remote host is not an HTTP Server!");
+                return HTTPC_ERROR_NO_HTTP_SERVER;
             }
+        }
+    }
+}
 
-        } else {
+/**
+ * reads one response header line into _line, without line ending and trailing white space
+ * lines longer than HTTPCLIENT_MAX_HEADER_LINE are truncated
+ * @return length of the line or < 0 on error
+ */
+int HTTPClient::readHeaderLine()
+{
+    size_t len = 0;
+    bool truncated = false;
+    unsigned long lastDataTime = millis();
+
+    if(!_lineSize) {
+        _line.reset(new (std::nothrow) char[128]);
+        if(!_line) {
+            return HTTPC_ERROR_TOO_LESS_RAM;
+        }
+        _lineSize = 128;
+    }
+
+    while(true) {
+        int c = _client->read();
+        if(c < 0) {
+            if(!connected()) {
+                return HTTPC_ERROR_CONNECTION_LOST;
+            }
             if((millis() - lastDataTime) > _tcpTimeout) {
                 return HTTPC_ERROR_READ_TIMEOUT;
             }
-            delay(10);
+            delay(1);
+            continue;
+        }
+        lastDataTime = millis();
+        if(c == '\n') {
+            break;
+        }
+        if(len + 1 >= _lineSize) {
+            if(_lineSize >= HTTPCLIENT_MAX_HEADER_LINE) {
+                truncated = true;
+                continue;
+            }
+            size_t size = _lineSize * 2;
+            if(size > HTTPCLIENT_MAX_HEADER_LINE) {
+                size = HTTPCLIENT_MAX_HEADER_LINE;
+            }
+            char * line = new (std::nothrow) char[size];
+            if(!line) {
+                return HTTPC_ERROR_TOO_LESS_RAM;
+            }
+            memcpy(line, _line.get(), len);
+            _line.reset(line);
+            _lineSize = size;
         }
+        _line[len++] = c;
     }
 
-    return HTTPC_ERROR_CONNECTION_LOST;
+    while(len && isspace((unsigned char)_line[len - 1])) {
+        len--;
+    }
+    _line[len] = 0;
+    if(truncated) {
+        log_w("header line truncated to %u bytes", len);
+    }
+    return len;
+}
+
+/**
+ * write a buffer to Stream, retrying once on a short write
+ * @return < 0 = error >= 0 = size written
+ */
+static int writeToStreamBuffer(Stream * stream, uint8_t * buff, int len)
+{
+    int bytesWrite = stream->write(buff, len);
+
+    // are all Bytes a writen to stream ?
+    if(bytesWrite != len) {
+        log_d("short write asked for %d but got %d retry...", len, bytesWrite);
+
+        // check for write error
+        if(stream->getWriteError()) {
+            log_d("stream write error %d", stream->getWriteError());
+
+            //reset write error for retry
+            stream->clearWriteError();
+        }
+
+        // some time for the stream
+        delay(1);
+
+        int leftBytes = (len - bytesWrite);
+
+        // retry to send the missed bytes
+        int retryWrite = stream->write((buff + bytesWrite), leftBytes);
+        if(retryWrite != leftBytes) {
+            // failed again
+            log_w("short write asked for %d but got %d failed.", leftBytes, retryWrite);
+            return HTTPC_ERROR_STREAM_WRITE;
+        }
+        bytesWrite += retryWrite;
+    }
+
+    // check for write error
+    if(stream->getWriteError()) {
+        log_w("stream write error %d", stream->getWriteError());
+        return HTTPC_ERROR_STREAM_WRITE;
+    }
+    return bytesWrite;
 }
 
 /**
@@ -1405,44 +1777,12 @@ int HTTPClient::writeToStreamDataBlock(Stream * stream, int size)
                 int bytesRead = _client->readBytes(buff, readBytes);
 
                 // write it to Stream
-                int bytesWrite = stream->write(buff, bytesRead);
-                bytesWritten += bytesWrite;
-
-                // are all Bytes a writen to stream ?
-                if(bytesWrite != bytesRead) {
-                    log_d("short write asked for %d but got %d retry...", bytesRead, bytesWrite);
-
-                    // check for write error
-                    if(stream->getWriteError()) {
-                        log_d("stream write error %d", stream->getWriteError());
-
-                        //reset write error for retry
-                        stream->clearWriteError();
-                    }
-
-                    // some time for the stream
-                    delay(1);
-
-                    int leftBytes = (readBytes - bytesWrite);
-
-                    // retry to send the missed bytes
-                    bytesWrite = stream->write((buff + bytesWrite), leftBytes);
-                    bytesWritten += bytesWrite;
-
-                    if(bytesWrite != leftBytes) {
-                        // failed again
-                        log_w("short write asked for %d but got %d failed.", leftBytes, bytesWrite);
-                        free(buff);
-                        return HTTPC_ERROR_STREAM_WRITE;
-                    }
-                }
-
-                // check for write error
-                if(stream->getWriteError()) {
-                    log_w("stream write error %d", stream->getWriteError());
+                int bytesWrite = writeToStreamBuffer(stream, buff, bytesRead);
+                if(bytesWrite < 0) {
                     free(buff);
-                    return HTTPC_ERROR_STREAM_WRITE;
+                    return bytesWrite;
                 }
+                bytesWritten += bytesWrite;
 
                 // count bytes to read left
                 if(len > 0) {
@@ -1463,6 +1803,8 @@ int HTTPClient::writeToStreamDataBlock(Stream * stream, int size)
             log_d("bytesWritten %d and size %d mismatch!.", bytesWritten, size);
             return HTTPC_ERROR_STREAM_WRITE;
         }
+        // without Content-Length the body ends with the connection
+        _bodyDone = (size > 0);
 
     } else {
         log_w("too less ram! need %d", HTTP_TCP_BUFFER_SIZE);
@@ -1472,6 +1814,185 @@ int HTTPClient::writeToStreamDataBlock(Stream * stream, int size)
     return bytesWritten;
 }
 
+/**
+ * decode a chunked body and write the payload to Stream
+ * chunk framing is read byte by byte, so nothing after the body is consumed
+ * @param stream Stream *
+ * @return < 0 = error >= 0 = size written
+ */
+int HTTPClient::writeToStreamChunked(Stream * stream)
+{
+    enum {
+        CHUNK_SIZE,         // hex digits of the chunk size
+        CHUNK_EXTENSION,    // ignored up to the end of the line
+        CHUNK_SIZE_LF,
+        CHUNK_DATA,
+        CHUNK_DATA_CR,
+        CHUNK_DATA_LF,
+        TRAILER_START,      // after the last chunk, trailer lines until an empty line
+        TRAILER_LINE,
+        TRAILER_END_LF,
+        CHUNKED_DONE
+    } state = CHUNK_SIZE;
+
+    uint8_t * buff = (uint8_t *) malloc(HTTP_TCP_BUFFER_SIZE);
+    if(!buff) {
+        log_w("too less ram! need %d", HTTP_TCP_BUFFER_SIZE);
+        return HTTPC_ERROR_TOO_LESS_RAM;
+    }
+
+    uint32_t chunkLeft = 0;
+    uint8_t sizeDigits = 0;
+    int bytesWritten = 0;
+    int ret = 0;
+    unsigned long lastDataTime = millis();
+
+    while(!ret && state != CHUNKED_DONE) {
+        if(state == CHUNK_DATA) {
+            size_t sizeAvailable = _client->available();
+            if(!sizeAvailable) {
+                if(!connected()) {
+                    ret = HTTPC_ERROR_CONNECTION_LOST;
+                } else if((millis() - lastDataTime) > _tcpTimeout) {
+                    ret = HTTPC_ERROR_READ_TIMEOUT;
+                } else {
+                    delay(1);
+                }
+                continue;
+            }
+            size_t readBytes = std::min(std::min(sizeAvailable, (size_t)chunkLeft), (size_t)HTTP_TCP_BUFFER_SIZE);
+            int bytesRead = _client->read(buff, readBytes);
+            if(bytesRead <= 0) {
+                continue;
+            }
+            lastDataTime = millis();
+            int bytesWrite = writeToStreamBuffer(stream, buff, bytesRead);
+            if(bytesWrite < 0) {
+                ret = bytesWrite;
+                continue;
+            }
+            bytesWritten += bytesWrite;
+            chunkLeft -= bytesRead;
+            if(!chunkLeft) {
+                state = CHUNK_DATA_CR;
+            }
+            continue;
+        }
+
+        int c = _client->read();
+        if(c < 0) {
+            if(!connected()) {
+                ret = HTTPC_ERROR_CONNECTION_LOST;
+            } else if((millis() - lastDataTime) > _tcpTimeout) {
+                ret = HTTPC_ERROR_READ_TIMEOUT;
+            } else {
+                delay(1);
+            }
+            continue;
+        }
+        lastDataTime = millis();
+
+        // a bare LF ends the chunk size line as well
+        bool sizeLineEnd = false;
+
+        switch(state) {
+        case CHUNK_SIZE:
+            if(isxdigit(c) && sizeDigits < 8) {
+                chunkLeft = (chunkLeft << 4) | (isdigit(c) ? c - '0' : (tolower(c) - 'a' + 10));
+                sizeDigits++;
+            } else if(sizeDigits && (c == ';' || c == ' ' || c == '\t')) {
+                state = CHUNK_EXTENSION;
+            } else if(sizeDigits && c == '\r') {
+                state = CHUNK_SIZE_LF;
+            } else if(sizeDigits && c == '\n') {
+                sizeLineEnd = true;
+            } else {
+                log_d("invalid chunk size");
+                ret = HTTPC_ERROR_ENCODING;
+            }
+            break;
+        case CHUNK_EXTENSION:
+            if(c == '\r') {
+                state = CHUNK_SIZE_LF;
+            } else if(c == '\n') {
+                sizeLineEnd = true;
+            }
+            break;
+        case CHUNK_SIZE_LF:
+            if(c == '\n') {
+                sizeLineEnd = true;
+            } else {
+                ret = HTTPC_ERROR_ENCODING;
+            }
+            break;
+        case CHUNK_DATA_CR:
+            state = CHUNK_DATA_LF;
+            if(c != '\r') {
+                ret = HTTPC_ERROR_ENCODING;
+            }
+            break;
+        case CHUNK_DATA_LF:
+            state = CHUNK_SIZE;
+            sizeDigits = 0;
+            if(c != '\n') {
+                ret = HTTPC_ERROR_ENCODING;
+            }
+            delay(0);
+            break;
+        case TRAILER_START:
+            if(c == '\r') {
+                state = TRAILER_END_LF;
+            } else if(c == '\n') {
+                state = CHUNKED_DONE;
+            } else {
+                state = TRAILER_LINE;
+            }
+            break;
+        case TRAILER_LINE:
+            if(c == '\n') {
+                state = TRAILER_START;
+            }
+            break;
+        case TRAILER_END_LF:
+            if(c == '\n') {
+                state = CHUNKED_DONE;
+            } else {
+                ret = HTTPC_ERROR_ENCODING;
+            }
+            break;
+        default:
+            break;
+        }
+
+        if(sizeLineEnd) {
+            if(chunkLeft) {
+                log_v(" read chunk len: %u", (unsigned) chunkLeft);
+                state = CHUNK_DATA;
+            } else {
+                state = TRAILER_START;
+            }
+        }
+    }
+
+    free(buff);
+
+    if(ret < 0) {
+        return ret;
+    }
+    _bodyDone = true;
+
+    // if no length Header use global chunk size
+    if(_size <= 0) {
+        _size = bytesWritten;
+    }
+
+    // check if we have write all data out
+    if(bytesWritten != _size) {
+        return HTTPC_ERROR_STREAM_WRITE;
+    }
+    return bytesWritten;
+}
+
 /**
  * called to handle error return, may disconnect the connection if still exists
  * @param error
@@ -41,6 +41,14 @@
 
 #define HTTPCLIENT_DEFAULT_TCP_TIMEOUT (5000)
 
+/// connection pool defaults
+#ifndef HTTPCLIENT_POOL_MAX_SOCKETS
+#define HTTPCLIENT_POOL_MAX_SOCKETS (4)
+#endif
+#ifndef HTTPCLIENT_POOL_IDLE_TIMEOUT
+#define HTTPCLIENT_POOL_IDLE_TIMEOUT (30000)
+#endif
+
 /// HTTP client errors
 #define HTTPC_ERROR_CONNECTION_REFUSED  (-1)
 #define HTTPC_ERROR_SEND_HEADER_FAILED  (-2)
@@ -57,6 +65,11 @@
 /// size for the stream handling
 #define HTTP_TCP_BUFFER_SIZE (1460)
 
+/// longest response header line kept, longer lines are truncated
+#ifndef HTTPCLIENT_MAX_HEADER_LINE
+#define HTTPCLIENT_MAX_HEADER_LINE (2048)
+#endif
+
 /// HTTP codes see RFC7231
 typedef enum {
     HTTP_CODE_CONTINUE = 100,
@@ -145,8 +158,79 @@ typedef enum {
 #ifdef HTTPCLIENT_1_1_COMPATIBLE
 class TransportTraits;
 typedef std::unique_ptr<TransportTraits> TransportTraitsPtr;
+
+/**
+ * Idle connections shared by several HTTPClient instances.
+ * Connections are keyed by scheme, host, port and TLS credentials, so a client
+ * switching between backends picks up a warm socket instead of reconnecting.
+ * Only connections created by HTTPClient itself (begin(url) without a client)
+ * are pooled. At most maxSockets idle connections are kept, the least recently
+ * used one is closed when the pool is full.
+ */
+class HTTPConnectionPool
+{
+public:
+    HTTPConnectionPool(uint8_t maxSockets = HTTPCLIENT_POOL_MAX_SOCKETS, unsigned long idleTimeout = HTTPCLIENT_POOL_IDLE_TIMEOUT);
+    ~HTTPConnectionPool();
+
+    void setMaxSockets(uint8_t maxSockets);
+    void setIdleTimeout(unsigned long idleTimeout_ms);
+
+    // returns a live idle connection for key, or nullptr
+    std::unique_ptr<WiFiClient> acquire(const String& key);
+    // keeps client for later reuse, closes it if it can not be reused
+    void release(const String& key, std::unique_ptr<WiFiClient> client);
+    // closes connections idle for longer than the idle timeout
+    void evictIdle();
+    // closes all idle connections
+    void clear();
+
+    size_t idle();
+    uint32_t hits() const { return _hits; }
+    uint32_t misses() const { return _misses; }
+    void resetCounters() { _hits = 0; _misses = 0; }
+
+protected:
+    struct Entry {
+        String key;
+        std::unique_ptr<WiFiClient> client;
+        unsigned long released;
+    };
+
+    void _evictIdle(unsigned long now);
+
+    std::vector<Entry> _idle;
+    uint8_t _maxSockets;
+    unsigned long _idleTimeout;
+    uint32_t _hits = 0;
+    uint32_t _misses = 0;
+    SemaphoreHandle_t _lock;
+};
 #endif
 
+/// request headers stored as name/value slices of one reusable buffer
+class HTTPHeaderList
+{
+public:
+    bool add(const char* name, size_t nameLen, const char* value, size_t valueLen, bool first = false, bool replace = true);
+    int indexOf(const char* name, size_t nameLen) const; // case insensitive, -1 if missing
+    void remove(size_t i);
+    void clear(); // keeps the allocated memory for the next request
+    size_t count() const { return _slices.size(); }
+    size_t length() const; // size of all "name: value\r\n" lines
+    void appendTo(String& out) const;
+
+protected:
+    struct Slice {
+        uint16_t name;
+        uint16_t nameLen;
+        uint16_t valueLen; // the value follows the name in the arena
+    };
+
+    std::vector<Slice> _slices;
+    std::vector<char> _arena;
+};
+
 // cookie jar support
 typedef struct  {
     String host;       // host which tries to set the cookie
@@ -195,6 +279,9 @@ public:
     bool connected(void);
 
     void setReuse(bool reuse); /// keep-alive
+#ifdef HTTPCLIENT_1_1_COMPATIBLE
+    void setConnectionPool(HTTPConnectionPool* pool); /// share idle connections with other clients, nullptr to disable
+#endif
     void setUserAgent(const String& userAgent);
     void setAuthorization(const char * user, const char * password);
     void setAuthorization(const char * auth);
@@ -260,15 +347,21 @@ protected:
     bool connect(void);
     bool sendHeader(const char * type);
     int handleHeaderResponse();
+    int readHeaderLine();
     int writeToStreamDataBlock(Stream * stream, int len);
+    int writeToStreamChunked(Stream * stream);
 
     /// Cookie jar support
     void setCookie(String date, String headerValue);
     bool generateCookieString(String *cookieString);
 
 #ifdef HTTPCLIENT_1_1_COMPATIBLE
+    String poolKey();
+
     TransportTraitsPtr _transportTraits;
     std::unique_ptr<WiFiClient> _tcpDeprecated;
+    HTTPConnectionPool* _pool = nullptr;
+    String _poolKey;
 #endif
 
     WiFiClient* _client = nullptr;
@@ -284,7 +377,7 @@ protected:
 
     String _uri;
     String _protocol;
-    String _headers;
+    HTTPHeaderList _headers;
     String _userAgent = "ESP32HTTPClient";
     String _base64Authorization;
     String _authorizationType = "Basic";
@@ -292,10 +385,13 @@ protected:
     /// Response handling
     RequestArgument* _currentHeaders = nullptr;
     size_t           _headerKeysCount = 0;
+    std::unique_ptr<char[]> _line;
+    size_t           _lineSize = 0;
 
     int _returnCode = 0;
     int _size = -1;
     bool _canReuse = false;
+    bool _bodyDone = false;     // the whole response body has been read
     followRedirects_t _followRedirects = HTTPC_DISABLE_FOLLOW_REDIRECTS;
     uint16_t _redirectLimit = 10;
     String _location;
@@ -320,10 +320,10 @@ HTTPUpdateResult HTTPUpdate::handleUpdate(HTTPClient& http, const String& curren
                     }
 */
 
-                    // check for valid first magic byte
-//                    if(buf[0] != 0xE9) {
-                    if(tcp->peek() != 0xE9) {
-                        log_e("Magic header does not start with 0xE9\n");
+                    // check for valid first magic byte, an image or a patch against the running firmware
+                    int magic = tcp->peek();
+                    if(magic != 0xE9 && magic != UPDATE_PATCH_MAGIC_BYTE) {
+                        log_e("Magic header starts with 0x%02X, expected 0xE9 (image) or 0x%02X (patch)\n", magic & 0xFF, UPDATE_PATCH_MAGIC_BYTE);
                         _lastError = HTTP_UE_BIN_VERIFY_HEADER_FAILED;
                         http.end();
                         return HTTP_UPDATE_FAILED;
@@ -0,0 +1,76 @@
+#include "FS.h"
+#include "LittleFS.h"
+
+/* Compares listing a directory with File::openNextFile(), which opens every
+   entry, against FS::openDir() and FS::list(), which only read the directory
+   and stat() an entry when its size or time is asked for. */
+
+#define FORMAT_LITTLEFS_IF_FAILED true
+#define DIR_NAME   "/bench"
+#define FILE_COUNT 200
+
+void createFiles(fs::FS &fs){
+    fs.mkdir(DIR_NAME);
+    char path[32];
+    for(int i = 0; i < FILE_COUNT; i++){
+        snprintf(path, sizeof(path), DIR_NAME "/log-%04d.txt", i);
+        if(fs.exists(path)){
+            continue;
+        }
+        File file = fs.open(path, FILE_WRITE);
+        file.printf("entry %d\n", i);
+        file.close();
+    }
+}
+
+void listWithOpenNextFile(fs::FS &fs){
+    uint32_t start = millis();
+    size_t count = 0, bytes = 0;
+    File root = fs.open(DIR_NAME);
+    File file = root.openNextFile();
+    while(file){
+        count++;
+        bytes += file.size();
+        file = root.openNextFile();
+    }
+    Serial.printf("openNextFile(): %u entries, %u bytes in %u ms\n", count, bytes, millis() - start);
+}
+
+void listWithOpenDir(fs::FS &fs){
+    uint32_t start = millis();
+    size_t count = 0, bytes = 0;
+    Dir dir = fs.openDir(DIR_NAME);
+    while(dir.next()){
+        count++;
+        bytes += dir.fileSize();
+    }
+    Serial.printf("openDir():      %u entries, %u bytes in %u ms\n", count, bytes, millis() - start);
+}
+
+void listNames(fs::FS &fs){
+    uint32_t start = millis();
+    size_t chars = 0;
+    size_t count = fs.list(DIR_NAME, [&chars](Dir &entry){
+        chars += strlen(entry.fileName());
+        return true;
+    });
+    Serial.printf("list(), names:  %u entries, %u chars in %u ms\n", count, chars, millis() - start);
+}
+
+void setup(){
+    Serial.begin(115200);
+    if(!LittleFS.begin(FORMAT_LITTLEFS_IF_FAILED)){
+        Serial.println("LittleFS Mount Failed");
+        return;
+    }
+    Serial.println("Creating files...");
+    createFiles(LittleFS);
+
+    listWithOpenNextFile(LittleFS);
+    listWithOpenDir(LittleFS);
+    listNames(LittleFS);
+}
+
+void loop(){
+
+}
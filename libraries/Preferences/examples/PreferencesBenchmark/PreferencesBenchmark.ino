@@ -0,0 +1,85 @@
+#include <Preferences.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+
+/* Counts the NVS entries written and the time taken by direct puts against a
+   transaction and lazy writes. Written entries are taken from the free entry
+   count, so each run starts from an erased NVS partition.
+   Note: this erases all of NVS, including WiFi settings. */
+
+#define FIELDS 30       // fields of a config that is saved as a whole
+#define SAVES  5        // saves of the config, one field changed each time
+#define TICKS  100      // counter puts, every 100 ms
+
+Preferences prefs;
+
+size_t freeEntries(){
+    nvs_stats_t stats;
+    nvs_get_stats(NULL, &stats);
+    return stats.free_entries;
+}
+
+void resetNvs(){
+    prefs.end();
+    nvs_flash_erase();
+    nvs_flash_init();
+    prefs.begin("bench", false);
+}
+
+void saveConfig(uint32_t * config){
+    char key[8];
+    for(int i = 0; i < FIELDS; i++){
+        snprintf(key, sizeof(key), "f%d", i);
+        prefs.putUInt(key, config[i]);
+    }
+}
+
+void configBenchmark(bool transaction){
+    uint32_t config[FIELDS] = {0};
+    resetNvs();
+    saveConfig(config);
+    size_t before = freeEntries();
+    uint32_t start = micros();
+    for(int i = 0; i < SAVES; i++){
+        config[i] = i + 1;
+        if(transaction){
+            prefs.beginTransaction();
+        }
+        saveConfig(config);
+        if(transaction){
+            prefs.commit();
+        }
+    }
+    Serial.printf("config, %-12s %4u entries written in %6u us\n", transaction ? "transaction:" : "direct:", before - freeEntries(), micros() - start);
+}
+
+void counterBenchmark(uint32_t interval){
+    resetNvs();
+    prefs.setLazyWrite(interval);
+    size_t before = freeEntries();
+    uint32_t busy = 0;
+    for(uint32_t i = 0; i < TICKS; i++){
+        uint32_t start = micros();
+        prefs.putUInt("counter", i);
+        busy += micros() - start;
+        delay(100);
+    }
+    prefs.end();
+    Serial.printf("counter, lazy write %4u ms: %4u entries written, %6u us in putUInt()\n", interval, before - freeEntries(), busy);
+}
+
+void setup(){
+    Serial.begin(115200);
+    Serial.printf("%d field config saved %d times, one field changed each time\n", FIELDS, SAVES);
+    configBenchmark(false);
+    configBenchmark(true);
+
+    Serial.printf("counter put every 100 ms for %d s\n", TICKS / 10);
+    counterBenchmark(0);
+    counterBenchmark(1000);
+    counterBenchmark(5000);
+}
+
+void loop(){
+
+}
@@ -20,10 +20,23 @@
 const char * nvs_errors[] = { "OTHER", "NOT_INITIALIZED", "NOT_FOUND", "TYPE_MISMATCH", "READ_ONLY", "NOT_ENOUGH_SPACE", "INVALID_NAME", "INVALID_HANDLE", "REMOVE_FAILED", "KEY_TOO_LONG", "PAGE_FULL", "INVALID_STATE", "INVALID_LENGTH"};
 #define nvs_error(e) (((e)>ESP_ERR_NVS_BASE)?nvs_errors[(e)&~(ESP_ERR_NVS_BASE)]:nvs_errors[0])
 
+struct Preferences::Entry {
+    Entry * next;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    PreferenceType type;    // PT_INVALID for a removed key
+    size_t len;             // strings include the terminating 0
+    uint8_t value[];
+};
+
 Preferences::Preferences()
     :_handle(0)
     ,_started(false)
     ,_readOnly(false)
+    ,_transaction(false)
+    ,_clearPending(false)
+    ,_lazyInterval(0)
+    ,_dirtySince(0)
+    ,_pending(NULL)
 {}
 
 Preferences::~Preferences(){
@@ -58,6 +71,12 @@ void Preferences::end(){
     if(!_started){
         return;
     }
+    if(_transaction){
+        log_w("transaction not committed, %u changes dropped", pendingCount());
+        rollback();
+    } else {
+        commit();
+    }
     nvs_close(_handle);
     _started = false;
 }
@@ -70,6 +89,15 @@ bool Preferences::clear(){
     if(!_started || _readOnly){
         return false;
     }
+    if(_deferred()){
+        bool clean = !_pending && !_clearPending;
+        _dropPending();
+        _clearPending = true;
+        if(clean){
+            _dirtySince = millis();
+        }
+        return _checkLazyWrite();
+    }
     esp_err_t err = nvs_erase_all(_handle);
     if(err){
         log_e("nvs_erase_all fail: %s", nvs_error(err));
@@ -91,6 +119,9 @@ bool Preferences::remove(const char * key){
     if(!_started || !key || _readOnly){
         return false;
     }
+    if(_deferred()){
+        return _pendingPut(key, PT_INVALID, NULL, 0);
+    }
     esp_err_t err = nvs_erase_key(_handle, key);
     if(err){
         log_e("nvs_erase_key fail: %s %s", key, nvs_error(err));
@@ -104,6 +135,223 @@ bool Preferences::remove(const char * key){
     return true;
 }
 
+/*
+ * Batched writes
+ * */
+
+bool Preferences::beginTransaction(){
+    if(!_started || _readOnly || _transaction){
+        return false;
+    }
+    _transaction = true;
+    return true;
+}
+
+bool Preferences::commit(){
+    if(!_started || _readOnly){
+        return false;
+    }
+    _transaction = false;
+    if(!_pending && !_clearPending){
+        return true;
+    }
+    bool ok = true;
+    esp_err_t err;
+    if(_clearPending){
+        err = nvs_erase_all(_handle);
+        if(err){
+            log_e("nvs_erase_all fail: %s", nvs_error(err));
+            ok = false;
+        }
+    }
+    for(Entry * entry = _pending; entry; entry = entry->next){
+        ok = _writeEntry(entry) && ok;
+    }
+    _dropPending();
+    err = nvs_commit(_handle);
+    if(err){
+        log_e("nvs_commit fail: %s", nvs_error(err));
+        return false;
+    }
+    return ok;
+}
+
+void Preferences::rollback(){
+    _dropPending();
+    _transaction = false;
+}
+
+void Preferences::setLazyWrite(uint32_t interval){
+    _lazyInterval = interval;
+    if(!interval && !_transaction){
+        commit();
+    }
+}
+
+size_t Preferences::pendingCount(){
+    size_t count = _clearPending ? 1 : 0;
+    for(Entry * entry = _pending; entry; entry = entry->next){
+        count++;
+    }
+    return count;
+}
+
+Preferences::Entry * Preferences::_pendingFind(const char* key){
+    for(Entry * entry = _pending; entry; entry = entry->next){
+        if(!strcmp(entry->key, key)){
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+bool Preferences::_pendingPut(const char* key, PreferenceType type, const void* value, size_t len){
+    if(strlen(key) >= NVS_KEY_NAME_MAX_SIZE){
+        log_e("key too long: %s", key);
+        return false;
+    }
+    Entry * entry = (Entry *)malloc(sizeof(Entry) + len);
+    if(!entry){
+        log_e("malloc failed");
+        return false;
+    }
+    strcpy(entry->key, key);
+    entry->type = type;
+    entry->len = len;
+    if(len){
+        memcpy(entry->value, value, len);
+    }
+    entry->next = NULL;
+
+    // a key is pending once, a new value replaces the old one in place
+    Entry ** link = &_pending;
+    while(*link && strcmp((*link)->key, key)){
+        link = &(*link)->next;
+    }
+    if(*link){
+        entry->next = (*link)->next;
+        free(*link);
+    } else if(!_pending && !_clearPending){
+        _dirtySince = millis();
+    }
+    *link = entry;
+    return _checkLazyWrite();
+}
+
+// true when the pending changes decide the value, entry is NULL if the key is gone
+bool Preferences::_pendingGet(const char* key, PreferenceType type, const Entry** entry){
+    *entry = NULL;
+    if(!key || (!_pending && !_clearPending)){
+        return false;
+    }
+    Entry * pending = _pendingFind(key);
+    if(pending && (pending->type == type || pending->type == PT_INVALID)){
+        *entry = (pending->type == type) ? pending : NULL;
+        return true;
+    }
+    // IDF 4.4 NVS looks keys up by type, a put of another type does not replace the stored value
+    return _clearPending;
+}
+
+bool Preferences::_pendingValue(const char* key, PreferenceType type, void* value, size_t len){
+    const Entry * entry;
+    if(!_pendingGet(key, type, &entry)){
+        return false;
+    }
+    if(entry){
+        memcpy(value, entry->value, len);
+    }
+    return true;
+}
+
+// compares with NVS, so unchanged values cost a read instead of a flash write
+bool Preferences::_isStored(const Entry* entry){
+    uint64_t stored = 0;
+    size_t len = 0;
+    esp_err_t err;
+    switch(entry->type){
+        case PT_I8:  err = nvs_get_i8(_handle, entry->key, (int8_t*)&stored); break;
+        case PT_U8:  err = nvs_get_u8(_handle, entry->key, (uint8_t*)&stored); break;
+        case PT_I16: err = nvs_get_i16(_handle, entry->key, (int16_t*)&stored); break;
+        case PT_U16: err = nvs_get_u16(_handle, entry->key, (uint16_t*)&stored); break;
+        case PT_I32: err = nvs_get_i32(_handle, entry->key, (int32_t*)&stored); break;
+        case PT_U32: err = nvs_get_u32(_handle, entry->key, (uint32_t*)&stored); break;
+        case PT_I64: err = nvs_get_i64(_handle, entry->key, (int64_t*)&stored); break;
+        case PT_U64: err = nvs_get_u64(_handle, entry->key, &stored); break;
+        case PT_STR:
+        case PT_BLOB: {
+            err = (entry->type == PT_STR) ? nvs_get_str(_handle, entry->key, NULL, &len) : nvs_get_blob(_handle, entry->key, NULL, &len);
+            if(err || len != entry->len){
+                return false;
+            }
+            uint8_t * buf = (uint8_t *)malloc(len);
+            if(!buf){
+                return false;
+            }
+            err = (entry->type == PT_STR) ? nvs_get_str(_handle, entry->key, (char*)buf, &len) : nvs_get_blob(_handle, entry->key, buf, &len);
+            bool same = !err && !memcmp(buf, entry->value, len);
+            free(buf);
+            return same;
+        }
+        default:
+            return false;
+    }
+    return !err && !memcmp(&stored, entry->value, entry->len);
+}
+
+bool Preferences::_writeEntry(const Entry* entry){
+    esp_err_t err;
+    if(entry->type == PT_INVALID){
+        err = nvs_erase_key(_handle, entry->key);
+        if(err && err != ESP_ERR_NVS_NOT_FOUND){
+            log_e("nvs_erase_key fail: %s %s", entry->key, nvs_error(err));
+            return false;
+        }
+        return true;
+    }
+    if(_isStored(entry)){
+        return true;
+    }
+    uint64_t value = 0;
+    if(entry->len <= sizeof(value)){
+        memcpy(&value, entry->value, entry->len);
+    }
+    switch(entry->type){
+        case PT_I8:   err = nvs_set_i8(_handle, entry->key, (int8_t)value); break;
+        case PT_U8:   err = nvs_set_u8(_handle, entry->key, (uint8_t)value); break;
+        case PT_I16:  err = nvs_set_i16(_handle, entry->key, (int16_t)value); break;
+        case PT_U16:  err = nvs_set_u16(_handle, entry->key, (uint16_t)value); break;
+        case PT_I32:  err = nvs_set_i32(_handle, entry->key, (int32_t)value); break;
+        case PT_U32:  err = nvs_set_u32(_handle, entry->key, (uint32_t)value); break;
+        case PT_I64:  err = nvs_set_i64(_handle, entry->key, (int64_t)value); break;
+        case PT_U64:  err = nvs_set_u64(_handle, entry->key, value); break;
+        case PT_STR:  err = nvs_set_str(_handle, entry->key, (const char*)entry->value); break;
+        case PT_BLOB: err = nvs_set_blob(_handle, entry->key, entry->value, entry->len); break;
+        default:      return false;
+    }
+    if(err){
+        log_e("nvs_set fail: %s %s", entry->key, nvs_error(err));
+        return false;
+    }
+    return true;
+}
+
+void Preferences::_dropPending(){
+    while(_pending){
+        Entry * next = _pending->next;
+        free(_pending);
+        _pending = next;
+    }
+    _clearPending = false;
+}
+
+bool Preferences::_checkLazyWrite(){
+    if(_transaction || !_lazyInterval || (millis() - _dirtySince) < _lazyInterval){
+        return true;
+    }
+    return commit();
+}
+
 /*
  * Put a key value
  * */
@@ -112,6 +360,9 @@ size_t Preferences::putChar(const char* key, int8_t value){
     if(!_started || !key || _readOnly){
         return 0;
     }
+    if(_deferred()){
+        return _pendingPut(key, PT_I8, &value, sizeof(value)) ? 1 : 0;
+    }
     esp_err_t err = nvs_set_i8(_handle, key, value);
     if(err){
         log_e("nvs_set_i8 fail: %s %s", key, nvs_error(err));
@@ -129,6 +380,9 @@ size_t Preferences::putUChar(const char* key, uint8_t value){
     if(!_started || !key || _readOnly){
         return 0;
     }
+    if(_deferred()){
+        return _pendingPut(key, PT_U8, &value, sizeof(value)) ? 1 : 0;
+    }
     esp_err_t err = nvs_set_u8(_handle, key, value);
     if(err){
         log_e("nvs_set_u8 fail: %s %s", key, nvs_error(err));
@@ -146,6 +400,9 @@ size_t Preferences::putShort(const char* key, int16_t value){
     if(!_started || !key || _readOnly){
         return 0;
     }
+    if(_deferred()){
+        return _pendingPut(key, PT_I16, &value, sizeof(value)) ? 2 : 0;
+    }
     esp_err_t err = nvs_set_i16(_handle, key, value);
     if(err){
         log_e("nvs_set_i16 fail: %s %s", key, nvs_error(err));
@@ -163,6 +420,9 @@ size_t Preferences::putUShort(const char* key, uint16_t value){
     if(!_started || !key || _readOnly){
         return 0;
     }
+    if(_deferred()){
+        return _pendingPut(key, PT_U16, &value, sizeof(value)) ? 2 : 0;
+    }
     esp_err_t err = nvs_set_u16(_handle, key, value);
     if(err){
         log_e("nvs_set_u16 fail: %s %s", key, nvs_error(err));
@@ -180,6 +440,9 @@ size_t Preferences::putInt(const char* key, int32_t value){
     if(!_started || !key || _readOnly){
         return 0;
     }
+    if(_deferred()){
+        return _pendingPut(key, PT_I32, &value, sizeof(value)) ? 4 : 0;
+    }
     esp_err_t err = nvs_set_i32(_handle, key, value);
     if(err){
         log_e("nvs_set_i32 fail: %s %s", key, nvs_error(err));
@@ -197,6 +460,9 @@ size_t Preferences::putUInt(const char* key, uint32_t value){
     if(!_started || !key || _readOnly){
         return 0;
     }
+    if(_deferred()){
+        return _pendingPut(key, PT_U32, &value, sizeof(value)) ? 4 : 0;
+    }
     esp_err_t err = nvs_set_u32(_handle, key, value);
     if(err){
         log_e("nvs_set_u32 fail: %s %s", key, nvs_error(err));
@@ -222,6 +488,9 @@ size_t Preferences::putLong64(const char* key, int64_t value){
     if(!_started || !key || _readOnly){
         return 0;
     }
+    if(_deferred()){
+        return _pendingPut(key, PT_I64, &value, sizeof(value)) ? 8 : 0;
+    }
     esp_err_t err = nvs_set_i64(_handle, key, value);
     if(err){
         log_e("nvs_set_i64 fail: %s %s", key, nvs_error(err));
@@ -239,6 +508,9 @@ size_t Preferences::putULong64(const char* key, uint64_t value){
     if(!_started || !key || _readOnly){
         return 0;
     }
+    if(_deferred()){
+        return _pendingPut(key, PT_U64, &value, sizeof(value)) ? 8 : 0;
+    }
     esp_err_t err = nvs_set_u64(_handle, key, value);
     if(err){
         log_e("nvs_set_u64 fail: %s %s", key, nvs_error(err));
@@ -268,6 +540,9 @@ size_t Preferences::putString(const char* key, const char* value){
     if(!_started || !key || !value || _readOnly){
         return 0;
     }
+    if(_deferred()){
+        return _pendingPut(key, PT_STR, value, strlen(value) + 1) ? strlen(value) : 0;
+    }
     esp_err_t err = nvs_set_str(_handle, key, value);
     if(err){
         log_e("nvs_set_str fail: %s %s", key, nvs_error(err));
@@ -289,6 +564,9 @@ size_t Preferences::putBytes(const char* key, const void* value, size_t len){
     if(!_started || !key || !value || !len || _readOnly){
         return 0;
     }
+    if(_deferred()){
+        return _pendingPut(key, PT_BLOB, value, len) ? len : 0;
+    }
     esp_err_t err = nvs_set_blob(_handle, key, value, len);
     if(err){
         log_e("nvs_set_blob fail: %s %s", key, nvs_error(err));
@@ -306,6 +584,13 @@ PreferenceType Preferences::getType(const char* key) {
     if(!_started || !key || strlen(key)>15){
         return PT_INVALID;
     }
+    Entry * entry = _pendingFind(key);
+    if(entry){
+        return entry->type;
+    }
+    if(_clearPending){
+        return PT_INVALID;
+    }
     int8_t mt1; uint8_t mt2; int16_t mt3; uint16_t mt4;
     int32_t mt5; uint32_t mt6; int64_t mt7; uint64_t mt8;
     size_t len = 0;
@@ -335,6 +620,9 @@ int8_t Preferences::getChar(const char* key, const int8_t defaultValue){
     if(!_started || !key){
         return value;
     }
+    if(_pendingValue(key, PT_I8, &value, sizeof(value))){
+        return value;
+    }
     esp_err_t err = nvs_get_i8(_handle, key, &value);
     if(err){
         log_v("nvs_get_i8 fail: %s %s", key, nvs_error(err));
@@ -347,6 +635,9 @@ uint8_t Preferences::getUChar(const char* key, const uint8_t defaultValue){
     if(!_started || !key){
         return value;
     }
+    if(_pendingValue(key, PT_U8, &value, sizeof(value))){
+        return value;
+    }
     esp_err_t err = nvs_get_u8(_handle, key, &value);
     if(err){
         log_v("nvs_get_u8 fail: %s %s", key, nvs_error(err));
@@ -359,6 +650,9 @@ int16_t Preferences::getShort(const char* key, const int16_t defaultValue){
     if(!_started || !key){
         return value;
     }
+    if(_pendingValue(key, PT_I16, &value, sizeof(value))){
+        return value;
+    }
     esp_err_t err = nvs_get_i16(_handle, key, &value);
     if(err){
         log_v("nvs_get_i16 fail: %s %s", key, nvs_error(err));
@@ -371,6 +665,9 @@ uint16_t Preferences::getUShort(const char* key, const uint16_t defaultValue){
     if(!_started || !key){
         return value;
     }
+    if(_pendingValue(key, PT_U16, &value, sizeof(value))){
+        return value;
+    }
     esp_err_t err = nvs_get_u16(_handle, key, &value);
     if(err){
         log_v("nvs_get_u16 fail: %s %s", key, nvs_error(err));
@@ -383,6 +680,9 @@ int32_t Preferences::getInt(const char* key, const int32_t defaultValue){
     if(!_started || !key){
         return value;
     }
+    if(_pendingValue(key, PT_I32, &value, sizeof(value))){
+        return value;
+    }
     esp_err_t err = nvs_get_i32(_handle, key, &value);
     if(err){
         log_v("nvs_get_i32 fail: %s %s", key, nvs_error(err));
@@ -395,6 +695,9 @@ uint32_t Preferences::getUInt(const char* key, const uint32_t defaultValue){
     if(!_started || !key){
         return value;
     }
+    if(_pendingValue(key, PT_U32, &value, sizeof(value))){
+        return value;
+    }
     esp_err_t err = nvs_get_u32(_handle, key, &value);
     if(err){
         log_v("nvs_get_u32 fail: %s %s", key, nvs_error(err));
@@ -415,6 +718,9 @@ int64_t Preferences::getLong64(const char* key, const int64_t defaultValue){
     if(!_started || !key){
         return value;
     }
+    if(_pendingValue(key, PT_I64, &value, sizeof(value))){
+        return value;
+    }
     esp_err_t err = nvs_get_i64(_handle, key, &value);
     if(err){
         log_v("nvs_get_i64 fail: %s %s", key, nvs_error(err));
@@ -427,6 +733,9 @@ uint64_t Preferences::getULong64(const char* key, const uint64_t defaultValue){
     if(!_started || !key){
         return value;
     }
+    if(_pendingValue(key, PT_U64, &value, sizeof(value))){
+        return value;
+    }
     esp_err_t err = nvs_get_u64(_handle, key, &value);
     if(err){
         log_v("nvs_get_u64 fail: %s %s", key, nvs_error(err));
@@ -455,6 +764,18 @@ size_t Preferences::getString(const char* key, char* value, const size_t maxLen)
     if(!_started || !key || !value || !maxLen){
         return 0;
     }
+    const Entry * entry;
+    if(_pendingGet(key, PT_STR, &entry)){
+        if(!entry){
+            return 0;
+        }
+        if(entry->len > maxLen){
+            log_e("not enough space in value: %u < %u", maxLen, entry->len);
+            return 0;
+        }
+        memcpy(value, entry->value, entry->len);
+        return entry->len;
+    }
     esp_err_t err = nvs_get_str(_handle, key, NULL, &len);
     if(err){
         log_e("nvs_get_str len fail: %s %s", key, nvs_error(err));
@@ -478,6 +799,10 @@ String Preferences::getString(const char* key, const String defaultValue){
     if(!_started || !key){
         return String(defaultValue);
     }
+    const Entry * entry;
+    if(_pendingGet(key, PT_STR, &entry)){
+        return entry ? String((const char*)entry->value) : String(defaultValue);
+    }
     esp_err_t err = nvs_get_str(_handle, key, value, &len);
     if(err){
         log_e("nvs_get_str len fail: %s %s", key, nvs_error(err));
@@ -498,6 +823,10 @@ size_t Preferences::getBytesLength(const char* key){
     if(!_started || !key){
         return 0;
     }
+    const Entry * entry;
+    if(_pendingGet(key, PT_BLOB, &entry)){
+        return entry ? entry->len : 0;
+    }
     esp_err_t err = nvs_get_blob(_handle, key, NULL, &len);
     if(err){
         log_e("nvs_get_blob len fail: %s %s", key, nvs_error(err));
@@ -515,6 +844,11 @@ size_t Preferences::getBytes(const char* key, void * buf, size_t maxLen){
         log_e("not enough space in buffer: %u < %u", maxLen, len);
         return 0;
     }
+    const Entry * entry;
+    if(_pendingGet(key, PT_BLOB, &entry) && entry){
+        memcpy(buf, entry->value, len);
+        return len;
+    }
     esp_err_t err = nvs_get_blob(_handle, key, buf, &len);
     if(err){
         log_e("nvs_get_blob fail: %s %s", key, nvs_error(err));
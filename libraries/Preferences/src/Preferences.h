@@ -22,9 +22,26 @@ typedef enum {
 
 class Preferences {
     protected:
+        struct Entry;   // a put that is not written to NVS yet
+
         uint32_t _handle;
         bool _started;
         bool _readOnly;
+        bool _transaction;
+        bool _clearPending;
+        uint32_t _lazyInterval;
+        uint32_t _dirtySince;
+        Entry * _pending;
+
+        bool _deferred() const { return _transaction || _lazyInterval; }
+        Entry * _pendingFind(const char* key);
+        bool _pendingPut(const char* key, PreferenceType type, const void* value, size_t len);
+        bool _pendingGet(const char* key, PreferenceType type, const Entry** entry);
+        bool _pendingValue(const char* key, PreferenceType type, void* value, size_t len);
+        bool _isStored(const Entry* entry);
+        bool _writeEntry(const Entry* entry);
+        void _dropPending();
+        bool _checkLazyWrite();
     public:
         Preferences();
         ~Preferences();
@@ -35,6 +52,27 @@ class Preferences {
         bool clear();
         bool remove(const char * key);
 
+        /*
+          Keeps the following puts, removes and clear() in RAM until commit()
+          Gets see the pending values, end() without commit() drops them
+        */
+        bool beginTransaction();
+        /*
+          Writes the pending changes with a single nvs_commit()
+          Values equal to the stored ones are not written again
+        */
+        bool commit();
+        void rollback();
+        /*
+          Lazy writes: with an interval (ms), puts stay in RAM and are written by
+          the first put, remove or clear() after the interval has passed, by
+          commit() or by end(). There is no timer, a value put last stays in RAM
+          until one of these is called and is lost on reset. 0 writes the
+          pending values and disables it
+        */
+        void setLazyWrite(uint32_t interval);
+        size_t pendingCount();
+
         size_t putChar(const char* key, int8_t value);
         size_t putUChar(const char* key, uint8_t value);
         size_t putShort(const char* key, int16_t value);
@@ -0,0 +1,78 @@
+/*
+ * Connect the SD card as in the SD_Test example.
+ *
+ * Measures file write and read speed with the access patterns the SD
+ * disk layer caches: FatFS hands a whole 512 byte write or read straight
+ * to the card one sector at a time, logging code syncs every few KB. To
+ * compare with uncached access, build with SD_WRITE_CACHE_SECTORS=0 and
+ * SD_READ_AHEAD_SECTORS=0.
+ */
+#include "FS.h"
+#include "SD.h"
+#include "SPI.h"
+
+#define FILE_PATH  "/bench.bin"
+#define FILE_SIZE  (2 * 1024 * 1024)
+
+static uint8_t buf[4096];
+
+void report(const char * name, size_t bytes, uint32_t ms){
+    Serial.printf("%-36s %5u KB/s\n", name, ms ? (uint32_t)((uint64_t)bytes * 1000 / 1024 / ms) : 0);
+}
+
+void writeTest(fs::FS &fs, const char * name, size_t chunk, size_t syncEvery){
+    File file = fs.open(FILE_PATH, FILE_WRITE);
+    if(!file){
+        Serial.println("Failed to open file for writing");
+        return;
+    }
+    uint32_t start = millis();
+    for(size_t pos = 0; pos < FILE_SIZE; pos += chunk){
+        file.write(buf, chunk);
+        if(syncEvery && (pos + chunk) % syncEvery == 0){
+            file.flush();
+        }
+    }
+    file.close();
+    report(name, FILE_SIZE, millis() - start);
+}
+
+void readTest(fs::FS &fs, const char * name, bool randomOrder){
+    File file = fs.open(FILE_PATH);
+    if(!file){
+        Serial.println("Failed to open file for reading");
+        return;
+    }
+    size_t sectors = file.size() / 512;
+    uint32_t start = millis();
+    for(size_t i = 0; i < sectors; i++){
+        if(randomOrder){
+            file.seek(random(sectors) * 512);
+        }
+        file.read(buf, 512);
+    }
+    report(name, sectors * 512, millis() - start);
+    file.close();
+}
+
+void setup(){
+    Serial.begin(115200);
+    if(!SD.begin()){
+        Serial.println("Card Mount Failed");
+        return;
+    }
+    for(size_t i = 0; i < sizeof(buf); i++){
+        buf[i] = i;
+    }
+    Serial.printf("%u KB per case\n", FILE_SIZE / 1024);
+    writeTest(SD, "sequential write, 1 sector/call", 512, 0);
+    writeTest(SD, "logging write, flush every 4 KB", 512, 4096);
+    writeTest(SD, "sequential write, 8 sectors/call", 4096, 0);
+    readTest(SD, "sequential read, 1 sector/call", false);
+    readTest(SD, "random read, 1 sector/call", true);
+    SD.remove(FILE_PATH);
+}
+
+void loop(){
+
+}
@@ -23,6 +23,7 @@ extern "C" {
     #include "esp_vfs_fat.h"
     char CRC7(const char* data, int length);
     unsigned short CRC16(const char* data, int length);
+    unsigned short CRC16Update(unsigned short crc, const char* data, int length);
 }
 
 typedef enum {
@@ -58,6 +59,13 @@ typedef struct {
     unsigned long sectors;
     bool supports_crc;
     int status;
+    char * write_buf;           // pending sectors, written as one run
+    unsigned long write_sector;
+    int write_count;
+    char * read_buf;            // read-ahead sectors
+    unsigned long read_sector;
+    int read_count;
+    unsigned long read_next;    // sector after the last read, to detect sequential access
 } ardu_sdcard_t;
 
 static ardu_sdcard_t* s_cards[FF_VOLUMES] = { NULL };
@@ -98,6 +106,10 @@ bool sdWait(uint8_t pdrv, int timeout)
 
     do {
         resp = s_cards[pdrv]->spi->transfer(0xFF);
+        if (!resp && (millis() - start) > 2) {
+            // long busy (erase, program), let other tasks run
+            delay(1);
+        }
     } while (resp == 0x00 && (millis() - start) < (unsigned int)timeout);
 
     if (!resp) {
@@ -202,6 +214,13 @@ char sdCommand(uint8_t pdrv, char cmd, unsigned int arg, unsigned int* resp)
     return token;
 }
 
+// SPI chunk callback, the CRC is computed while the rest of the sector is transferred
+static void sdCRC16Chunk(void * arg, const uint8_t * data, uint32_t len)
+{
+    unsigned short * crc = (unsigned short *)arg;
+    *crc = CRC16Update(*crc, (const char*)data, len);
+}
+
 bool sdReadBytes(uint8_t pdrv, char* buffer, int length)
 {
     char token;
@@ -217,21 +236,31 @@ bool sdReadBytes(uint8_t pdrv, char* buffer, int length)
         return false;
     }
 
-    card->spi->transferBytes(NULL, (uint8_t*)buffer, length);
-    crc = card->spi->transfer16(0xFFFF);
-    return (!card->supports_crc || crc == CRC16(buffer, length));
+    if (!card->supports_crc) {
+        card->spi->transferBytes(NULL, (uint8_t*)buffer, length);
+        card->spi->transfer16(0xFFFF);
+        return true;
+    }
+    crc = 0;
+    card->spi->transferBytes(NULL, (uint8_t*)buffer, length, sdCRC16Chunk, &crc);
+    return card->spi->transfer16(0xFFFF) == crc;
 }
 
 char sdWriteBytes(uint8_t pdrv, const char* buffer, char token)
 {
     ardu_sdcard_t * card = s_cards[pdrv];
-    unsigned short crc = (card->supports_crc)?CRC16(buffer, 512):0xFFFF;
+    unsigned short crc = 0xFFFF;
     if (!sdWait(pdrv, 500)) {
         return false;
     }
 
     card->spi->write(token);
-    card->spi->writeBytes((uint8_t*)buffer, 512);
+    if (card->supports_crc) {
+        crc = 0;
+        card->spi->writeBytes((uint8_t*)buffer, 512, sdCRC16Chunk, &crc);
+    } else {
+        card->spi->writeBytes((uint8_t*)buffer, 512);
+    }
     card->spi->write16(crc);
     return (card->spi->transfer(0xFF) & 0x1F);
 }
@@ -414,6 +443,112 @@ bool sdWriteSectors(uint8_t pdrv, const char* buffer, unsigned long long sector,
     return false;
 }
 
+/*
+ * Sector cache
+ * */
+
+static bool sdOverlaps(unsigned long a, int a_count, unsigned long b, int b_count)
+{
+    return a < b + b_count && b < a + a_count;
+}
+
+static bool sdFlushWrites(uint8_t pdrv)
+{
+    ardu_sdcard_t * card = s_cards[pdrv];
+    int count = card->write_count;
+    if (!count) {
+        return true;
+    }
+    bool success = (count > 1) ? sdWriteSectors(pdrv, card->write_buf, card->write_sector, count)
+                               : sdWriteSector(pdrv, card->write_buf, card->write_sector);
+    if (!success) {
+        // the run stays pending and is written again with the next flush
+        log_e("write of %d sectors at %lu failed", count, card->write_sector);
+        return false;
+    }
+    card->write_count = 0;
+    return true;
+}
+
+// keeps the read-ahead sectors current when they are written
+static void sdUpdateReadCache(ardu_sdcard_t * card, const char* buffer, unsigned long sector, int count)
+{
+    if (!card->read_count || !sdOverlaps(sector, count, card->read_sector, card->read_count)) {
+        return;
+    }
+    unsigned long first = (sector > card->read_sector) ? sector : card->read_sector;
+    unsigned long last = sector + count;
+    if (last > card->read_sector + card->read_count) {
+        last = card->read_sector + card->read_count;
+    }
+    memcpy(card->read_buf + ((first - card->read_sector) << 9), buffer + ((first - sector) << 9), (last - first) << 9);
+}
+
+// returns true if the request was served from the read-ahead buffer
+static bool sdCachedRead(uint8_t pdrv, char* buffer, unsigned long sector, int count, bool* success)
+{
+    ardu_sdcard_t * card = s_cards[pdrv];
+    if (!card->read_buf || count >= SD_READ_AHEAD_SECTORS) {
+        return false;
+    }
+    if (!card->read_count || sector < card->read_sector || sector + count > card->read_sector + card->read_count) {
+        if (sector != card->read_next) {
+            return false;
+        }
+        int ahead = SD_READ_AHEAD_SECTORS;
+        if (card->sectors && sector + ahead > card->sectors) {
+            ahead = card->sectors - sector;
+        }
+        if (ahead <= count) {
+            return false;
+        }
+        card->read_count = 0;
+        if (card->write_count && sdOverlaps(sector, ahead, card->write_sector, card->write_count) && !sdFlushWrites(pdrv)) {
+            *success = false;
+            return true;
+        }
+        if (!sdReadSectors(pdrv, card->read_buf, sector, ahead)) {
+            *success = false;
+            return true;
+        }
+        card->read_sector = sector;
+        card->read_count = ahead;
+    }
+    memcpy(buffer, card->read_buf + ((sector - card->read_sector) << 9), count << 9);
+    *success = true;
+    return true;
+}
+
+// returns true if the request was taken by the write cache
+static bool sdCachedWrite(uint8_t pdrv, const char* buffer, unsigned long sector, int count, bool* success)
+{
+    ardu_sdcard_t * card = s_cards[pdrv];
+    if (!card->write_buf || count >= SD_WRITE_CACHE_SECTORS) {
+        return false;
+    }
+    *success = true;
+    if (card->write_count && sector >= card->write_sector && sector <= card->write_sector + card->write_count
+            && sector + count <= card->write_sector + SD_WRITE_CACHE_SECTORS) {
+        // rewrite within or append to the pending run
+        memcpy(card->write_buf + ((sector - card->write_sector) << 9), buffer, count << 9);
+        if (sector + count > card->write_sector + card->write_count) {
+            card->write_count = sector + count - card->write_sector;
+        }
+    } else {
+        if (!sdFlushWrites(pdrv)) {
+            *success = false;
+            return true;
+        }
+        memcpy(card->write_buf, buffer, count << 9);
+        card->write_sector = sector;
+        card->write_count = count;
+    }
+    if (card->write_count == SD_WRITE_CACHE_SECTORS) {
+        *success = sdFlushWrites(pdrv);
+    }
+    return true;
+}
+
 unsigned long sdGetSectorsCount(uint8_t pdrv)
 {
     for (int f = 0; f < 3; f++) {
@@ -631,14 +766,21 @@ DRESULT ff_sd_read(uint8_t pdrv, uint8_t* buffer, DWORD sector, UINT count)
         return RES_NOTRDY;
     }
     DRESULT res = RES_OK;
+    bool success;
 
     AcquireSPI lock(card);
 
-    if (count > 1) {
+    if (card->write_count && sdOverlaps(sector, count, card->write_sector, card->write_count) && !sdFlushWrites(pdrv)) {
+        return RES_ERROR;
+    }
+    if (sdCachedRead(pdrv, (char*)buffer, sector, count, &success)) {
+        res = success ? RES_OK : RES_ERROR;
+    } else if (count > 1) {
         res = sdReadSectors(pdrv, (char*)buffer, sector, count) ? RES_OK : RES_ERROR;
     } else {
         res = sdReadSector(pdrv, (char*)buffer, sector) ? RES_OK : RES_ERROR;
     }
+    card->read_next = sector + count;
     return res;
 }
 
@@ -653,14 +795,23 @@ DRESULT ff_sd_write(uint8_t pdrv, const uint8_t* buffer, DWORD sector, UINT coun
         return RES_WRPRT;
     }
     DRESULT res = RES_OK;
+    bool success;
 
     AcquireSPI lock(card);
 
-    if (count > 1) {
+    sdUpdateReadCache(card, (const char*)buffer, sector, count);
+    if (sdCachedWrite(pdrv, (const char*)buffer, sector, count, &success)) {
+        res = success ? RES_OK : RES_ERROR;
+    } else if (!sdFlushWrites(pdrv)) {
+        res = RES_ERROR;
+    } else if (count > 1) {
         res = sdWriteSectors(pdrv, (const char*)buffer, sector, count) ? RES_OK : RES_ERROR;
     } else {
         res = sdWriteSector(pdrv, (const char*)buffer, sector) ? RES_OK : RES_ERROR;
     }
+    if (res != RES_OK) {
+        card->read_count = 0;
+    }
     return res;
 }
 
@@ -670,7 +821,7 @@ DRESULT ff_sd_ioctl(uint8_t pdrv, uint8_t cmd, void* buff)
     case CTRL_SYNC:
         {
             AcquireSPI lock(s_cards[pdrv]);
-            if (sdSelectCard(pdrv)) {
+            if (sdFlushWrites(pdrv) && sdSelectCard(pdrv)) {
                 sdDeselectCard(pdrv);
                 return RES_OK;
             }
@@ -696,7 +847,7 @@ bool sd_read_raw(uint8_t pdrv, uint8_t* buffer, DWORD sector)
 
 bool sd_write_raw(uint8_t pdrv, uint8_t* buffer, DWORD sector)
 {
-    return ff_sd_write(pdrv, buffer, sector, 1) == ESP_OK;
+    return ff_sd_write(pdrv, buffer, sector, 1) == ESP_OK && ff_sd_ioctl(pdrv, CTRL_SYNC, NULL) == RES_OK;
 }
 
 /*
@@ -709,6 +860,10 @@ uint8_t sdcard_uninit(uint8_t pdrv)
     if (pdrv >= FF_VOLUMES || card == NULL) {
         return 1;
     }
+    if (!(card->status & STA_NOINIT)) {
+        AcquireSPI lock(card);
+        sdFlushWrites(pdrv);
+    }
     sdTransaction(pdrv, GO_IDLE_STATE, 0, NULL);
     ff_diskio_register(pdrv, NULL);
     s_cards[pdrv] = NULL;
@@ -717,6 +872,8 @@ uint8_t sdcard_uninit(uint8_t pdrv)
         err = esp_vfs_fat_unregister_path(card->base_path);
         free(card->base_path);
     }
+    free(card->write_buf);
+    free(card->read_buf);
     free(card);
     return err;
 }
@@ -743,6 +900,13 @@ uint8_t sdcard_init(uint8_t cs, SPIClass * spi, int hz)
     card->type = CARD_NONE;
     card->status = STA_NOINIT;
 
+    // the caches are optional, without memory every access goes to the card
+    card->write_buf = (SD_WRITE_CACHE_SECTORS > 1) ? (char *)malloc(SD_WRITE_CACHE_SECTORS * 512) : NULL;
+    card->write_count = 0;
+    card->read_buf = (SD_READ_AHEAD_SECTORS > 1) ? (char *)malloc(SD_READ_AHEAD_SECTORS * 512) : NULL;
+    card->read_count = 0;
+    card->read_next = 0;
+
     pinMode(card->ssPin, OUTPUT);
     digitalWrite(card->ssPin, HIGH);
 
@@ -766,6 +930,13 @@ uint8_t sdcard_unmount(uint8_t pdrv)
     if (pdrv >= FF_VOLUMES || card == NULL) {
         return 1;
     }
+    {
+        AcquireSPI lock(card);
+        sdFlushWrites(pdrv);
+        // a run that could not be written must not end up on the next card
+        card->write_count = 0;
+        card->read_count = 0;
+    }
     card->status |= STA_NOINIT;
     card->type = CARD_NONE;
 
@@ -19,6 +19,17 @@
 #include "sd_defines.h"
 // #include "diskio.h"
 
+// consecutive single sector writes are merged into one multi block write of up to this many sectors
+// and held until the run is full, another sector is accessed or the file system syncs, 0 disables
+#ifndef SD_WRITE_CACHE_SECTORS
+#define SD_WRITE_CACHE_SECTORS  8
+#endif
+
+// sequential small reads fetch this many sectors at once, 0 disables
+#ifndef SD_READ_AHEAD_SECTORS
+#define SD_READ_AHEAD_SECTORS   8
+#endif
+
 uint8_t sdcard_init(uint8_t cs, SPIClass * spi, int hz);
 uint8_t sdcard_uninit(uint8_t pdrv);
 
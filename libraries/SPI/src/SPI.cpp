@@ -265,6 +265,16 @@ void SPIClass::writeBytes(const uint8_t * data, uint32_t size)
     spiEndTransaction(_spi);
 }
 
+void SPIClass::writeBytes(const uint8_t * data, uint32_t size, spi_chunk_cb_t cb, void * arg)
+{
+    if(_inTransaction){
+        return spiWriteNLCb(_spi, data, size, cb, arg);
+    }
+    spiSimpleTransaction(_spi);
+    spiWriteNLCb(_spi, data, size, cb, arg);
+    spiEndTransaction(_spi);
+}
+
 void SPIClass::transfer(void * data, uint32_t size) 
 { 
 	transferBytes((const uint8_t *)data, (uint8_t *)data, size); 
@@ -297,6 +307,16 @@ void SPIClass::transferBytes(const uint8_t * data, uint8_t * out, uint32_t size)
     spiTransferBytes(_spi, data, out, size);
 }
 
+void SPIClass::transferBytes(const uint8_t * data, uint8_t * out, uint32_t size, spi_chunk_cb_t cb, void * arg)
+{
+    if(_inTransaction){
+        return spiTransferBytesNLCb(_spi, data, out, size, cb, arg);
+    }
+    spiSimpleTransaction(_spi);
+    spiTransferBytesNLCb(_spi, data, out, size, cb, arg);
+    spiEndTransaction(_spi);
+}
+
 /**
  * @param data uint8_t *
  * @param size uint8_t  max for size is 64Byte
@@ -79,12 +79,16 @@ public:
     uint32_t transfer32(uint32_t data);
   
     void transferBytes(const uint8_t * data, uint8_t * out, uint32_t size);
+    // cb gets the received data in chunks while the transfer is still running
+    void transferBytes(const uint8_t * data, uint8_t * out, uint32_t size, spi_chunk_cb_t cb, void * arg);
     void transferBits(uint32_t data, uint32_t * out, uint8_t bits);
 
     void write(uint8_t data);
     void write16(uint16_t data);
     void write32(uint32_t data);
     void writeBytes(const uint8_t * data, uint32_t size);
+    // cb gets the data in chunks while they are being sent
+    void writeBytes(const uint8_t * data, uint32_t size, spi_chunk_cb_t cb, void * arg);
     void writePixels(const void * data, uint32_t size);//ili9341 compatible
     void writePattern(const uint8_t * data, uint8_t size, uint32_t repeat);
 
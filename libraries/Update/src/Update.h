@@ -5,6 +5,7 @@
 #include <MD5Builder.h>
 #include <functional>
 #include "esp_partition.h"
+#include "UpdatePatch.h"
 
 #define UPDATE_ERROR_OK                 (0)
 #define UPDATE_ERROR_WRITE              (1)
@@ -19,6 +20,7 @@
 #define UPDATE_ERROR_NO_PARTITION       (10)
 #define UPDATE_ERROR_BAD_ARGUMENT       (11)
 #define UPDATE_ERROR_ABORT              (12)
+#define UPDATE_ERROR_PATCH              (13)
 
 #define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
 
@@ -31,6 +33,12 @@
 #define SPI_SECTORS_PER_BLOCK   16      // usually large erase block is 32k/64k
 #define SPI_FLASH_BLOCK_SIZE    (SPI_SECTORS_PER_BLOCK*SPI_FLASH_SEC_SIZE)
 
+#define UPDATE_MAX_BUFFERS      3
+
+#ifndef UPDATE_TASK_STACK_SIZE
+#define UPDATE_TASK_STACK_SIZE  4096
+#endif
+
 class UpdateClass {
   public:
     typedef std::function<void(size_t, size_t)> THandlerFunction_Progress;
@@ -42,6 +50,20 @@ class UpdateClass {
     */
     UpdateClass& onProgress(THandlerFunction_Progress fn);
 
+    /*
+      Number of sector buffers (1 to UPDATE_MAX_BUFFERS) used by the next begin()
+      With 2 or more, a separate task erases and writes the flash
+      while the next sector is being received
+      Each buffer takes SPI_FLASH_SEC_SIZE bytes of RAM
+    */
+    UpdateClass& setBufferCount(uint8_t count);
+
+    /*
+      Erase the whole target range in begin() when the size is given,
+      instead of erasing block by block while writing
+    */
+    UpdateClass& setPreErase(bool enable);
+
     /*
       Call this to check the space needed for the update
       Will return false if there is not enough space
@@ -50,6 +72,9 @@ class UpdateClass {
 
     /*
       Writes a buffer to the flash and increments the address
+      For U_FLASH the data may also be a patch made by tools/gen_update_patch.py,
+      it is detected by its header and applied against the running firmware
+      progress() and size() then count patch bytes, the MD5 is the one of the new firmware
       Returns the amount written
     */
     size_t write(uint8_t *data, size_t len);
@@ -111,6 +136,12 @@ class UpdateClass {
     size_t size(){ return _size; }
     size_t progress(){ return _progress; }
     size_t remaining(){ return _size - _progress; }
+    bool isPatch(){ return _patch != NULL; }
+
+    /*
+      Average bytes per second accepted since begin(), e.g. to report from onProgress
+    */
+    uint32_t throughput();
 
     /*
       Template to write from objects that expose
@@ -163,9 +194,25 @@ class UpdateClass {
     bool rollBack();
 
   private:
+    struct FlashJob {
+        uint8_t *buffer;
+        uint32_t offset;
+        size_t len;
+        size_t skip;
+    };
+
     void _reset();
     void _abort(uint8_t err);
     bool _writeBuffer();
+    uint8_t _flushSector(uint8_t *&buffer, size_t len, uint32_t offset);
+    bool _beginPatch();
+    bool _patchHeader(uint32_t sourceSize, uint32_t sourceCrc, uint32_t targetSize);
+    bool _patchWrite(const uint8_t *data, size_t len);
+    uint8_t _flashBuffer(uint8_t *buffer, size_t len, uint32_t offset, size_t skip);
+    bool _startPipeline();
+    bool _waitPipeline();
+    void _stopPipeline();
+    static void _flashTask(void *arg);
     bool _verifyHeader(uint8_t data);
     bool _verifyEnd();
     bool _enablePartition(const esp_partition_t* partition);
@@ -174,9 +221,27 @@ class UpdateClass {
 
     uint8_t _error;
     uint8_t *_buffer;
+    uint8_t *_buffers[UPDATE_MAX_BUFFERS];
+    uint8_t _bufferCount;
+    uint8_t _activeBuffers;
+    bool _preErase;
+    size_t _erasedSize;
+    QueueHandle_t _jobQueue;
+    QueueHandle_t _freeQueue;
+    TaskHandle_t _flashTaskHandle;
+    volatile uint8_t _flashError;
+    uint32_t _startTime;
     uint8_t *_skipBuffer;
     size_t _bufferLen;
     size_t _size;
+    size_t _imageSize;          // bytes going to the partition, differs from _size for patches
+    UpdatePatch *_patch;
+    const esp_partition_t* _patchSource;
+    uint8_t *_patchBuffer;
+    uint8_t *_patchOut;         // decoded sector, circulates through the pipeline like _buffer
+    size_t _patchOutLen;
+    uint32_t _patchOffset;
+    uint8_t _patchError;
     THandlerFunction_Progress _progress_callback;
     uint32_t _progress;
     uint32_t _paroffset;
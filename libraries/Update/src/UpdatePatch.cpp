@@ -0,0 +1,193 @@
+#include "UpdatePatch.h"
+#include <string.h>
+#include "esp32-hal-log.h"
+
+static uint32_t _readLE32(const uint8_t *p){
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+UpdatePatch::UpdatePatch(THandlerFunction_Read source, THandlerFunction_Write target, THandlerFunction_Header header)
+: _source(source)
+, _target(target)
+, _header(header)
+, _state(STATE_HEADER)
+, _headerLen(0)
+, _varint(0)
+, _varintShift(0)
+, _left(0)
+, _sourceSize(0)
+, _sourcePos(0)
+, _targetSize(0)
+, _targetWritten(0)
+{
+}
+
+bool UpdatePatch::_fail(const char *reason){
+    log_e("bad patch: %s", reason);
+    _state = STATE_ERROR;
+    return false;
+}
+
+bool UpdatePatch::_emit(const uint8_t *data, size_t len){
+    if(len > _targetSize - _targetWritten){
+        return _fail("target overflow");
+    }
+    if(!_target(data, len)){
+        _state = STATE_ERROR;
+        return false;
+    }
+    _targetWritten += len;
+    return true;
+}
+
+bool UpdatePatch::_copy(uint32_t len){
+    if(len > _sourceSize - _sourcePos){
+        return _fail("source overflow");
+    }
+    while(len){
+        size_t n = (len < sizeof(_chunk)) ? len : sizeof(_chunk);
+        if(!_source(_sourcePos, _chunk, n)){
+            return _fail("source read");
+        }
+        if(!_emit(_chunk, n)){
+            return false;
+        }
+        _sourcePos += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool UpdatePatch::_op(uint32_t value){
+    uint32_t arg = value >> 2;
+    switch(value & 3){
+    case OP_COPY:
+        return _copy(arg);
+    case OP_ADD:
+        if(arg > _sourceSize - _sourcePos){
+            return _fail("source overflow");
+        }
+        _left = arg;
+        _state = arg ? STATE_ADD : STATE_OP;
+        return true;
+    case OP_INSERT:
+        _left = arg;
+        _state = arg ? STATE_INSERT : STATE_OP;
+        return true;
+    case OP_SEEK: {
+        // zigzag: even values are positive, odd ones negative
+        int64_t pos = (int64_t)_sourcePos + ((arg & 1) ? -(int64_t)((arg >> 1) + 1) : (int64_t)(arg >> 1));
+        if(pos < 0 || pos > _sourceSize){
+            return _fail("seek out of range");
+        }
+        _sourcePos = (uint32_t)pos;
+        return true;
+    }
+    }
+    return false;
+}
+
+bool UpdatePatch::write(const uint8_t *data, size_t len){
+    while(len || (_state == STATE_OP && _targetWritten == _targetSize)){
+        switch(_state){
+        case STATE_HEADER: {
+            size_t n = UPDATE_PATCH_HEADER_SIZE - _headerLen;
+            if(n > len){
+                n = len;
+            }
+            memcpy(_headerBuf + _headerLen, data, n);
+            _headerLen += n;
+            data += n;
+            len -= n;
+            if(_headerLen < UPDATE_PATCH_HEADER_SIZE){
+                return true;
+            }
+            if(memcmp(_headerBuf, UPDATE_PATCH_MAGIC, 4)){
+                return _fail("magic");
+            }
+            _sourceSize = _readLE32(_headerBuf + 4);
+            _targetSize = _readLE32(_headerBuf + 12);
+            if(_header && !_header(_sourceSize, _readLE32(_headerBuf + 8), _targetSize)){
+                _state = STATE_ERROR;
+                return false;
+            }
+            _state = STATE_OP;
+            break;
+        }
+
+        case STATE_OP:
+            if(_targetWritten == _targetSize){
+                _state = STATE_DONE;
+                break;
+            }
+            while(len){
+                uint8_t b = *data++;
+                len--;
+                if(_varintShift > 28 || (_varintShift == 28 && (b & 0x70))){
+                    return _fail("varint");
+                }
+                _varint |= (uint32_t)(b & 0x7F) << _varintShift;
+                _varintShift += 7;
+                if(!(b & 0x80)){
+                    uint32_t value = _varint;
+                    _varint = 0;
+                    _varintShift = 0;
+                    if(!_op(value)){
+                        return false;
+                    }
+                    break;
+                }
+            }
+            break;
+
+        case STATE_ADD:
+            while(_left && len){
+                size_t n = _left;
+                if(n > len){
+                    n = len;
+                }
+                if(n > sizeof(_chunk)){
+                    n = sizeof(_chunk);
+                }
+                if(!_source(_sourcePos, _chunk, n)){
+                    return _fail("source read");
+                }
+                for(size_t i = 0; i < n; i++){
+                    _chunk[i] += data[i];
+                }
+                if(!_emit(_chunk, n)){
+                    return false;
+                }
+                _sourcePos += n;
+                _left -= n;
+                data += n;
+                len -= n;
+            }
+            if(!_left){
+                _state = STATE_OP;
+            }
+            break;
+
+        case STATE_INSERT: {
+            size_t n = (_left < len) ? _left : len;
+            if(!_emit(data, n)){
+                return false;
+            }
+            _left -= n;
+            data += n;
+            len -= n;
+            if(!_left){
+                _state = STATE_OP;
+            }
+            break;
+        }
+
+        case STATE_DONE:
+            return _fail("data after end");
+
+        case STATE_ERROR:
+            return false;
+        }
+    }
+    return _state != STATE_ERROR;
+}
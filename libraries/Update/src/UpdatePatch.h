@@ -0,0 +1,98 @@
+#ifndef ESP32UPDATEPATCH_H
+#define ESP32UPDATEPATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+
+/*
+  Streaming decoder for binary patches made by tools/gen_update_patch.py
+
+  A patch rebuilds the target image from a source image (the running app)
+  and starts with a 16 byte header, all values little endian:
+
+    "ESPD"  magic
+    uint32  source size
+    uint32  source CRC32 (same as zlib's crc32)
+    uint32  target size
+
+  followed by operations, each a varint of (value << 2 | op):
+
+    COPY    value bytes from the source
+    ADD     value bytes from the source, each plus the next patch byte
+    INSERT  the next value patch bytes
+    SEEK    move the source position by value (zigzag encoded)
+
+  The source is read at the current position, which every COPY and ADD
+  advances. Only a small chunk buffer is held, patch bytes can be fed in
+  any split.
+*/
+
+#define UPDATE_PATCH_MAGIC          "ESPD"
+#define UPDATE_PATCH_MAGIC_BYTE     'E'
+#define UPDATE_PATCH_HEADER_SIZE    16
+
+#ifndef UPDATE_PATCH_CHUNK_SIZE
+#define UPDATE_PATCH_CHUNK_SIZE     256
+#endif
+
+class UpdatePatch {
+  public:
+    typedef std::function<bool(uint32_t offset, uint8_t *data, size_t len)> THandlerFunction_Read;
+    typedef std::function<bool(const uint8_t *data, size_t len)> THandlerFunction_Write;
+    typedef std::function<bool(uint32_t sourceSize, uint32_t sourceCrc, uint32_t targetSize)> THandlerFunction_Header;
+
+    UpdatePatch(THandlerFunction_Read source, THandlerFunction_Write target, THandlerFunction_Header header = NULL);
+
+    /*
+      Decodes the next patch bytes
+      Returns false once the patch is malformed or a handler failed,
+      every later call fails as well
+    */
+    bool write(const uint8_t *data, size_t len);
+
+    bool hasError() const { return _state == STATE_ERROR; }
+    bool isFinished() const { return _state == STATE_DONE; }
+    uint32_t targetSize() const { return _targetSize; }
+    uint32_t targetWritten() const { return _targetWritten; }
+
+  private:
+    enum State {
+        STATE_HEADER,
+        STATE_OP,
+        STATE_ADD,
+        STATE_INSERT,
+        STATE_DONE,
+        STATE_ERROR
+    };
+
+    enum Op {
+        OP_COPY = 0,
+        OP_ADD = 1,
+        OP_INSERT = 2,
+        OP_SEEK = 3
+    };
+
+    bool _fail(const char *reason);
+    bool _op(uint32_t value);
+    bool _copy(uint32_t len);
+    bool _emit(const uint8_t *data, size_t len);
+
+    THandlerFunction_Read _source;
+    THandlerFunction_Write _target;
+    THandlerFunction_Header _header;
+
+    State _state;
+    uint8_t _headerBuf[UPDATE_PATCH_HEADER_SIZE];
+    size_t _headerLen;
+    uint32_t _varint;
+    uint8_t _varintShift;
+    uint32_t _left;             // bytes left in the current ADD or INSERT
+    uint32_t _sourceSize;
+    uint32_t _sourcePos;
+    uint32_t _targetSize;
+    uint32_t _targetWritten;
+    uint8_t _chunk[UPDATE_PATCH_CHUNK_SIZE] __attribute__((aligned(4)));
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include "esp_spi_flash.h"
 #include "esp_ota_ops.h"
 #include "esp_image_format.h"
+#include "esp_rom_crc.h"
 
 static const char * _err2str(uint8_t _error){
     if(_error == UPDATE_ERROR_OK){
@@ -31,6 +32,8 @@ static const char * _err2str(uint8_t _error){
         return ("Bad Argument");
     } else if(_error == UPDATE_ERROR_ABORT){
         return ("Aborted");
+    } else if(_error == UPDATE_ERROR_PATCH){
+        return ("Bad Patch");
     }
     return ("UNKNOWN");
 }
@@ -60,8 +63,26 @@ bool UpdateClass::_enablePartition(const esp_partition_t* partition){
 UpdateClass::UpdateClass()
 : _error(0)
 , _buffer(0)
+, _bufferCount(1)
+, _activeBuffers(0)
+, _preErase(false)
+, _erasedSize(0)
+, _jobQueue(NULL)
+, _freeQueue(NULL)
+, _flashTaskHandle(NULL)
+, _flashError(UPDATE_ERROR_OK)
+, _startTime(0)
+, _skipBuffer(NULL)
 , _bufferLen(0)
 , _size(0)
+, _imageSize(0)
+, _patch(NULL)
+, _patchSource(NULL)
+, _patchBuffer(NULL)
+, _patchOut(NULL)
+, _patchOutLen(0)
+, _patchOffset(0)
+, _patchError(UPDATE_ERROR_OK)
 , _progress_callback(NULL)
 , _progress(0)
 , _paroffset(0)
@@ -75,11 +96,50 @@ UpdateClass& UpdateClass::onProgress(THandlerFunction_Progress fn) {
     return *this;
 }
 
+UpdateClass& UpdateClass::setBufferCount(uint8_t count) {
+    if(count < 1) {
+        count = 1;
+    } else if(count > UPDATE_MAX_BUFFERS) {
+        count = UPDATE_MAX_BUFFERS;
+    }
+    _bufferCount = count;
+    return *this;
+}
+
+UpdateClass& UpdateClass::setPreErase(bool enable) {
+    _preErase = enable;
+    return *this;
+}
+
+uint32_t UpdateClass::throughput() {
+    uint32_t elapsed = millis() - _startTime;
+    if(!isRunning() || !elapsed) {
+        return 0;
+    }
+    return (uint64_t)_progress * 1000 / elapsed;
+}
+
 void UpdateClass::_reset() {
-    if (_buffer)
-        delete[] _buffer;
+    _stopPipeline();
+    for(uint8_t i = 0; i < _activeBuffers; i++) {
+        free(_buffers[i]);
+    }
+    _activeBuffers = 0;
     _buffer = 0;
+    free(_skipBuffer);
+    _skipBuffer = NULL;
     _bufferLen = 0;
+    delete _patch;
+    _patch = NULL;
+    // the pipeline may have swapped it with one of _buffers, together they are all freed once
+    free(_patchBuffer);
+    _patchBuffer = NULL;
+    _patchOut = NULL;
+    _patchOutLen = 0;
+    _patchOffset = 0;
+    _patchError = UPDATE_ERROR_OK;
+    _erasedSize = 0;
+    _flashError = UPDATE_ERROR_OK;
     _progress = 0;
     _size = 0;
     _command = U_FLASH;
@@ -150,7 +210,8 @@ bool UpdateClass::begin(size_t size, int command, int ledPin, uint8_t ledOn, con
         return false;
     }
 
-    if(size == UPDATE_SIZE_UNKNOWN){
+    bool sizeKnown = (size != UPDATE_SIZE_UNKNOWN);
+    if(!sizeKnown){
         size = _partition->size;
     } else if(size > _partition->size){
         _error = UPDATE_ERROR_SIZE;
@@ -159,17 +220,112 @@ bool UpdateClass::begin(size_t size, int command, int ledPin, uint8_t ledOn, con
     }
 
     //initialize
-    _buffer = (uint8_t*)malloc(SPI_FLASH_SEC_SIZE);
-    if(!_buffer){
+    for(uint8_t i = 0; i < _bufferCount; i++) {
+        _buffers[i] = (uint8_t*)malloc(SPI_FLASH_SEC_SIZE);
+        if(!_buffers[i]) {
+            break;
+        }
+        _activeBuffers++;
+    }
+    if(!_activeBuffers){
         log_e("malloc failed");
         return false;
     }
+    if(_activeBuffers < _bufferCount) {
+        log_w("only %u of %u buffers allocated", _activeBuffers, _bufferCount);
+    }
+    _buffer = _buffers[0];
+
+    if(_preErase && sizeKnown) {
+        size_t eraseSize = (size + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE;
+        if(!ESP.partitionEraseRange(_partition, 0, eraseSize)) {
+            _abort(UPDATE_ERROR_ERASE);
+            return false;
+        }
+        _erasedSize = eraseSize;
+    }
+
+    if(_activeBuffers > 1 && !_startPipeline()) {
+        log_w("flash task not started, writing synchronously");
+    }
+
     _size = size;
+    _imageSize = size;
     _command = command;
     _md5.begin();
+    _startTime = millis();
     return true;
 }
 
+bool UpdateClass::_startPipeline(){
+    _jobQueue = xQueueCreate(_activeBuffers, sizeof(FlashJob));
+    _freeQueue = xQueueCreate(_activeBuffers, sizeof(uint8_t *));
+    if(_jobQueue && _freeQueue) {
+        // _buffers[0] is filled first, the others wait in the free queue
+        for(uint8_t i = 1; i < _activeBuffers; i++) {
+            xQueueSend(_freeQueue, &_buffers[i], 0);
+        }
+        if(xTaskCreateUniversal(_flashTask, "update_flash", UPDATE_TASK_STACK_SIZE, this, uxTaskPriorityGet(NULL), &_flashTaskHandle, tskNO_AFFINITY) == pdPASS) {
+            return true;
+        }
+        _flashTaskHandle = NULL;
+    }
+    if(_jobQueue) {
+        vQueueDelete(_jobQueue);
+        _jobQueue = NULL;
+    }
+    if(_freeQueue) {
+        vQueueDelete(_freeQueue);
+        _freeQueue = NULL;
+    }
+    return false;
+}
+
+// blocks until every queued sector has been written, false if one of them failed
+bool UpdateClass::_waitPipeline(){
+    if(!_jobQueue) {
+        return true;
+    }
+    // all buffers but the one being filled come back to the free queue
+    uint8_t *buffers[UPDATE_MAX_BUFFERS];
+    for(uint8_t i = 0; i < _activeBuffers - 1; i++) {
+        xQueueReceive(_freeQueue, &buffers[i], portMAX_DELAY);
+    }
+    for(uint8_t i = 0; i < _activeBuffers - 1; i++) {
+        xQueueSend(_freeQueue, &buffers[i], 0);
+    }
+    return _flashError == UPDATE_ERROR_OK;
+}
+
+void UpdateClass::_stopPipeline(){
+    if(!_jobQueue) {
+        return;
+    }
+    // once idle, the task is blocked on the empty job queue and can be deleted
+    _waitPipeline();
+    vTaskDelete(_flashTaskHandle);
+    _flashTaskHandle = NULL;
+    vQueueDelete(_jobQueue);
+    _jobQueue = NULL;
+    vQueueDelete(_freeQueue);
+    _freeQueue = NULL;
+}
+
+void UpdateClass::_flashTask(void *arg){
+    UpdateClass *update = (UpdateClass *)arg;
+    FlashJob job;
+    for(;;) {
+        if(xQueueReceive(update->_jobQueue, &job, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        // after a failure the remaining sectors are only handed back
+        if(update->_flashError == UPDATE_ERROR_OK) {
+            update->_flashError = update->_flashBuffer(job.buffer, job.len, job.offset, job.skip);
+        }
+        xQueueSend(update->_freeQueue, &job.buffer, portMAX_DELAY);
+    }
+}
+
 void UpdateClass::_abort(uint8_t err){
     _reset();
     _error = err;
@@ -180,13 +336,44 @@ void UpdateClass::abort(){
 }
 
 bool UpdateClass::_writeBuffer(){
+    if(!_progress && _command == U_FLASH && _bufferLen >= UPDATE_PATCH_HEADER_SIZE && !memcmp(_buffer, UPDATE_PATCH_MAGIC, 4) && !_beginPatch()){
+        return false;
+    }
+    if (!_progress && _progress_callback) {
+        _progress_callback(0, _size);
+    }
+
+    if(_patch) {
+        // _buffer holds patch data, the decoded image is collected in _patchOut
+        if(!_patch->write(_buffer, _bufferLen)) {
+            _abort(_patchError != UPDATE_ERROR_OK ? _patchError : UPDATE_ERROR_PATCH);
+            return false;
+        }
+    } else {
+        uint8_t err = _flushSector(_buffer, _bufferLen, _progress);
+        if(err != UPDATE_ERROR_OK) {
+            _abort(err);
+            return false;
+        }
+    }
+
+    _progress += _bufferLen;
+    _bufferLen = 0;
+    if (_progress_callback) {
+        _progress_callback(_progress, _size);
+    }
+    return true;
+}
+
+// hands a full buffer to the flash task or writes it right away, returns an UPDATE_ERROR_* code
+// with the flash task running, buffer is replaced by the next free one
+uint8_t UpdateClass::_flushSector(uint8_t *&buffer, size_t len, uint32_t offset){
     //first bytes of new firmware
     uint8_t skip = 0;
-    if(!_progress && _command == U_FLASH){
+    if(!offset && _command == U_FLASH){
         //check magic
-        if(_buffer[0] != ESP_IMAGE_HEADER_MAGIC){
-            _abort(UPDATE_ERROR_MAGIC_BYTE);
-            return false;
+        if(buffer[0] != ESP_IMAGE_HEADER_MAGIC){
+            return UPDATE_ERROR_MAGIC_BYTE;
         }
 
         //Stash the first 16 bytes of data and set the offset so they are
@@ -196,46 +383,132 @@ bool UpdateClass::_writeBuffer(){
         _skipBuffer = (uint8_t*)malloc(skip);
         if(!_skipBuffer){
             log_e("malloc failed");
+            return UPDATE_ERROR_WRITE;
+        }
+        memcpy(_skipBuffer, buffer, skip);
+    }
+
+    if(_jobQueue) {
+        if(_flashError != UPDATE_ERROR_OK) {
+            return _flashError;
+        }
+        FlashJob job = { buffer, offset, len, skip };
+        xQueueSend(_jobQueue, &job, portMAX_DELAY);
+        // keep receiving into the next free buffer while this one is written
+        xQueueReceive(_freeQueue, &buffer, portMAX_DELAY);
+        return UPDATE_ERROR_OK;
+    }
+    return _flashBuffer(buffer, len, offset, skip);
+}
+
+bool UpdateClass::_beginPatch(){
+    _patchSource = esp_ota_get_running_partition();
+    _patchBuffer = (uint8_t*)malloc(SPI_FLASH_SEC_SIZE);
+    if(!_patchSource || !_patchBuffer){
+        log_e("patch setup failed");
+        _abort(UPDATE_ERROR_PATCH);
         return false;
+    }
+    _patchOut = _patchBuffer;
+    _patch = new UpdatePatch(
+        [this](uint32_t offset, uint8_t *data, size_t len){ return ESP.partitionRead(_patchSource, offset, (uint32_t*)data, len); },
+        [this](const uint8_t *data, size_t len){ return _patchWrite(data, len); },
+        [this](uint32_t sourceSize, uint32_t sourceCrc, uint32_t targetSize){ return _patchHeader(sourceSize, sourceCrc, targetSize); });
+    log_d("applying patch to %s", _patchSource->label);
+    return true;
+}
+
+// the patch handlers run inside _patch->write(), so they leave _abort() to _writeBuffer()
+bool UpdateClass::_patchHeader(uint32_t sourceSize, uint32_t sourceCrc, uint32_t targetSize){
+    if(!targetSize || targetSize > _partition->size){
+        log_e("bad patch target size %u", targetSize);
+        _patchError = UPDATE_ERROR_SPACE;
+        return false;
+    }
+    if(sourceSize > _patchSource->size){
+        log_e("bad patch source size %u", sourceSize);
+        _patchError = UPDATE_ERROR_PATCH;
+        return false;
+    }
+
+    // a patch only rebuilds the image it was made against, _patchOut is not in use yet
+    uint32_t crc = 0;
+    for(uint32_t offset = 0; offset < sourceSize; offset += SPI_FLASH_SEC_SIZE){
+        size_t len = min((uint32_t)SPI_FLASH_SEC_SIZE, sourceSize - offset);
+        if(!ESP.partitionRead(_patchSource, offset, (uint32_t*)_patchOut, len)){
+            _patchError = UPDATE_ERROR_READ;
+            return false;
         }
-        memcpy(_skipBuffer, _buffer, skip);
+        crc = esp_rom_crc32_le(crc, _patchOut, len);
     }
-    if (!_progress && _progress_callback) {
-        _progress_callback(0, _size);
+    if(crc != sourceCrc){
+        log_e("patch does not match the running firmware");
+        _patchError = UPDATE_ERROR_PATCH;
+        return false;
     }
-    size_t offset = _partition->address + _progress;
-    bool block_erase = (_size - _progress >= SPI_FLASH_BLOCK_SIZE) && (offset % SPI_FLASH_BLOCK_SIZE == 0);             // if it's the block boundary, than erase the whole block from here
-    bool part_head_sectors = _partition->address % SPI_FLASH_BLOCK_SIZE && offset < (_partition->address / SPI_FLASH_BLOCK_SIZE + 1) * SPI_FLASH_BLOCK_SIZE;    // sector belong to unaligned partition heading block
-    bool part_tail_sectors = offset >= (_partition->address + _size) / SPI_FLASH_BLOCK_SIZE * SPI_FLASH_BLOCK_SIZE;     // sector belong to unaligned partition tailing block
-    if (block_erase || part_head_sectors || part_tail_sectors){
-        if(!ESP.partitionEraseRange(_partition, _progress, block_erase ? SPI_FLASH_BLOCK_SIZE : SPI_FLASH_SEC_SIZE)){
-            _abort(UPDATE_ERROR_ERASE);
+
+    // begin() pre-erased for the patch size only
+    if(_erasedSize && _erasedSize < targetSize){
+        size_t eraseSize = (targetSize + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE - _erasedSize;
+        if(!ESP.partitionEraseRange(_partition, _erasedSize, eraseSize)){
+            _patchError = UPDATE_ERROR_ERASE;
             return false;
         }
+        _erasedSize += eraseSize;
+    }
+    _imageSize = targetSize;
+    return true;
+}
+
+bool UpdateClass::_patchWrite(const uint8_t *data, size_t len){
+    while(len){
+        size_t toBuff = min(SPI_FLASH_SEC_SIZE - _patchOutLen, len);
+        memcpy(_patchOut + _patchOutLen, data, toBuff);
+        _patchOutLen += toBuff;
+        data += toBuff;
+        len -= toBuff;
+        if(_patchOutLen == SPI_FLASH_SEC_SIZE){
+            _patchError = _flushSector(_patchOut, _patchOutLen, _patchOffset);
+            if(_patchError != UPDATE_ERROR_OK){
+                return false;
+            }
+            _patchOffset += _patchOutLen;
+            _patchOutLen = 0;
+        }
+    }
+    return true;
+}
+
+// erases as needed, writes and hashes one sector, returns an UPDATE_ERROR_* code
+uint8_t UpdateClass::_flashBuffer(uint8_t *buffer, size_t len, uint32_t progress, size_t skip){
+    if(progress + len > _erasedSize) {
+        size_t offset = _partition->address + progress;
+        bool block_erase = (_imageSize - progress >= SPI_FLASH_BLOCK_SIZE) && (offset % SPI_FLASH_BLOCK_SIZE == 0);             // if it's the block boundary, than erase the whole block from here
+        bool part_head_sectors = _partition->address % SPI_FLASH_BLOCK_SIZE && offset < (_partition->address / SPI_FLASH_BLOCK_SIZE + 1) * SPI_FLASH_BLOCK_SIZE;    // sector belong to unaligned partition heading block
+        bool part_tail_sectors = offset >= (_partition->address + _imageSize) / SPI_FLASH_BLOCK_SIZE * SPI_FLASH_BLOCK_SIZE;     // sector belong to unaligned partition tailing block
+        if (block_erase || part_head_sectors || part_tail_sectors){
+            if(!ESP.partitionEraseRange(_partition, progress, block_erase ? SPI_FLASH_BLOCK_SIZE : SPI_FLASH_SEC_SIZE)){
+                return UPDATE_ERROR_ERASE;
+            }
+        }
     }
 
     // try to skip empty blocks on unecrypted partitions
-    if ((_partition->encrypted || _chkDataInBlock(_buffer + skip/sizeof(uint32_t), _bufferLen - skip)) && !ESP.partitionWrite(_partition, _progress + skip, (uint32_t*)_buffer + skip/sizeof(uint32_t), _bufferLen - skip)) {
-        _abort(UPDATE_ERROR_WRITE);
-        return false;
+    if ((_partition->encrypted || _chkDataInBlock(buffer + skip, len - skip)) && !ESP.partitionWrite(_partition, progress + skip, (uint32_t*)(buffer + skip), len - skip)) {
+        return UPDATE_ERROR_WRITE;
     }
 
     //restore magic or md5 will fail
-    if(!_progress && _command == U_FLASH){
-        _buffer[0] = ESP_IMAGE_HEADER_MAGIC;
-    }
-    _md5.add(_buffer, _bufferLen);
-    _progress += _bufferLen;
-    _bufferLen = 0;
-    if (_progress_callback) {
-        _progress_callback(_progress, _size);
+    if(!progress && _command == U_FLASH){
+        buffer[0] = ESP_IMAGE_HEADER_MAGIC;
     }
-    return true;
+    _md5.add(buffer, len);
+    return UPDATE_ERROR_OK;
 }
 
 bool UpdateClass::_verifyHeader(uint8_t data) {
     if(_command == U_FLASH) {
-        if(data != ESP_IMAGE_HEADER_MAGIC) {
+        if(data != ESP_IMAGE_HEADER_MAGIC && data != UPDATE_PATCH_MAGIC_BYTE) {
             _abort(UPDATE_ERROR_MAGIC_BYTE);
             return false;
         }
@@ -290,7 +563,41 @@ bool UpdateClass::end(bool evenIfRemaining){
         if(_bufferLen > 0) {
             _writeBuffer();
         }
+        // the flash task reads _size while writing the last sectors
+        if(!_waitPipeline()) {
+            _abort(_flashError);
+            return false;
+        }
         _size = progress();
+        if(hasError()) {
+            return false;
+        }
+    }
+
+    if(_patch) {
+        if(!_patch->isFinished()) {
+            log_e("patch incomplete: %u/%u bytes", _patch->targetWritten(), _patch->targetSize());
+            _abort(UPDATE_ERROR_PATCH);
+            return false;
+        }
+        if(_patchOutLen) {
+            uint8_t err = _flushSector(_patchOut, _patchOutLen, _patchOffset);
+            if(err != UPDATE_ERROR_OK) {
+                _abort(err);
+                return false;
+            }
+            _patchOffset += _patchOutLen;
+            _patchOutLen = 0;
+        }
+    }
+
+    if(!_waitPipeline()) {
+        _abort(_flashError);
+        return false;
+    }
+    log_d("%u bytes at %u KB/s", _progress, throughput() / 1024);
+    if(_patch) {
+        log_d("patch rebuilt %u bytes", _patchOffset);
     }
 
     _md5.calculate();
@@ -52,6 +52,10 @@ static char* readBytesWithTimeout(WiFiClient& client, size_t maxLength, size_t&
     if (!newLength) {
       break;
     }
+    // do not read into a pipelined request
+    if (newLength > maxLength - dataLength) {
+      newLength = maxLength - dataLength;
+    }
     if (!buf) {
       buf = (char *) malloc(newLength + 1);
       if (!buf) {
@@ -74,102 +78,92 @@ static char* readBytesWithTimeout(WiFiClient& client, size_t maxLength, size_t&
 }
 
 bool WebServer::_parseRequest(WiFiClient& client) {
-  // Read the first line of HTTP request
-  String req = client.readStringUntil('\r');
-  client.readStringUntil('\n');
+  // The request line and the headers have already been read by the parser
+  // of the connection, see _handleConnection(). Only the body is left in the client.
+  if (!_currentConnection || !_currentConnection->parser.complete()) {
+    return false;
+  }
+  const HTTPRequestParser& parser = _currentConnection->parser;
   //reset header value
   for (int i = 0; i < _headerKeysCount; ++i) {
     _currentHeaders[i].value =String();
   }
+  _hostHeader = String();
 
-  // First line of HTTP request looks like "GET /path HTTP/1.1"
-  // Retrieve the "/path" part by finding the spaces
-  int addr_start = req.indexOf(' ');
-  int addr_end = req.indexOf(' ', addr_start + 1);
-  if (addr_start == -1 || addr_end == -1) {
-    log_e("Invalid request: %s", req.c_str());
-    return false;
-  }
-
-  String methodStr = req.substring(0, addr_start);
-  String url = req.substring(addr_start + 1, addr_end);
-  String versionEnd = req.substring(addr_end + 8);
-  _currentVersion = atoi(versionEnd.c_str());
-  String searchStr = "";
-  int hasSearch = url.indexOf('?');
-  if (hasSearch != -1){
-    searchStr = url.substring(hasSearch + 1);
-    url = url.substring(0, hasSearch);
-  }
-  _currentUri = url;
+  const char* methodStr = parser.method();
+  _currentVersion = parser.version();
+  String searchStr = parser.query();
+  _currentUri = parser.uri();
   _chunked = false;
   _clientContentLength = 0;  // not known yet, or invalid
 
   HTTPMethod method = HTTP_ANY;
   size_t num_methods = sizeof(_http_method_str) / sizeof(const char *);
   for (size_t i=0; i<num_methods; i++) {
-    if (methodStr == _http_method_str[i]) {
+    if (strcmp(methodStr, _http_method_str[i]) == 0) {
       method = (HTTPMethod)i;
       break;
     }
   }
   if (method == HTTP_ANY) {
-    log_e("Unknown HTTP Method: %s", methodStr.c_str());
+    log_e("Unknown HTTP Method: %s", methodStr);
     return false;
   }
   _currentMethod = method;
 
-  log_v("method: %s url: %s search: %s", methodStr.c_str(), url.c_str(), searchStr.c_str());
+  log_v("method: %s url: %s search: %s", methodStr, _currentUri.c_str(), searchStr.c_str());
 
   //attach handler
-  RequestHandler* handler;
-  for (handler = _firstHandler; handler; handler = handler->next()) {
-    if (handler->canHandle(_currentMethod, _currentUri))
-      break;
+  _currentHandler = _routes.find(_currentMethod, _currentUri);
+
+  const char* contentType = nullptr;
+  const char* connectionHeader = nullptr;
+  for (size_t i = 0; i < parser.headers(); i++) {
+    const char* headerName = parser.headerName(i);
+    const char* headerValue = parser.headerValue(i);
+    _collectHeader(headerName, headerValue);
+
+    log_v("headerName: %s", headerName);
+    log_v("headerValue: %s", headerValue);
+
+    if (strcasecmp_P(headerName, Content_Type) == 0){
+      contentType = headerValue;
+    } else if (strcasecmp_P(headerName, PSTR("Content-Length")) == 0){
+      _clientContentLength = atoi(headerValue);
+    } else if (strcasecmp_P(headerName, PSTR("Host")) == 0){
+      _hostHeader = headerValue;
+    } else if (strcasecmp_P(headerName, PSTR("Connection")) == 0){
+      connectionHeader = headerValue;
+    }
+  }
+
+  // HTTP/1.1 connections are persistent unless the client asks to close, HTTP/1.0 ones only on request
+  _currentKeepAlive = _keepAlive && _currentConnection->requests < _keepAliveMaxRequests;
+  if (_currentKeepAlive) {
+    if (_currentVersion) {
+      _currentKeepAlive = !connectionHeader || strcasecmp_P(connectionHeader, PSTR("close")) != 0;
+    } else {
+      _currentKeepAlive = connectionHeader && strcasecmp_P(connectionHeader, PSTR("keep-alive")) == 0;
+    }
   }
-  _currentHandler = handler;
 
-  String formData;
   // below is needed only when POST type request
   if (method == HTTP_POST || method == HTTP_PUT || method == HTTP_PATCH || method == HTTP_DELETE){
     String boundaryStr;
-    String headerName;
-    String headerValue;
     bool isForm = false;
     bool isEncoded = false;
-    //parse headers
-    while(1){
-      req = client.readStringUntil('\r');
-      client.readStringUntil('\n');
-      if (req == "") break;//no moar headers
-      int headerDiv = req.indexOf(':');
-      if (headerDiv == -1){
-        break;
-      }
-      headerName = req.substring(0, headerDiv);
-      headerValue = req.substring(headerDiv + 1);
-      headerValue.trim();
-       _collectHeader(headerName.c_str(),headerValue.c_str());
-
-      log_v("headerName: %s", headerName.c_str());
-      log_v("headerValue: %s", headerValue.c_str());
-
-      if (headerName.equalsIgnoreCase(FPSTR(Content_Type))){
-        using namespace mime;
-        if (headerValue.startsWith(FPSTR(mimeTable[txt].mimeType))){
-          isForm = false;
-        } else if (headerValue.startsWith(F("application/x-www-form-urlencoded"))){
-          isForm = false;
-          isEncoded = true;
-        } else if (headerValue.startsWith(F("multipart/"))){
-          boundaryStr = headerValue.substring(headerValue.indexOf('=') + 1);
-          boundaryStr.replace("\"","");
-          isForm = true;
-        }
-      } else if (headerName.equalsIgnoreCase(F("Content-Length"))){
-        _clientContentLength = headerValue.toInt();
-      } else if (headerName.equalsIgnoreCase(F("Host"))){
-        _hostHeader = headerValue;
+    if (contentType){
+      using namespace mime;
+      if (strncmp_P(contentType, mimeTable[txt].mimeType, strlen_P(mimeTable[txt].mimeType)) == 0){
+        isForm = false;
+      } else if (strncmp_P(contentType, PSTR("application/x-www-form-urlencoded"), 33) == 0){
+        isForm = false;
+        isEncoded = true;
+      } else if (strncmp_P(contentType, PSTR("multipart/"), 10) == 0){
+        const char* boundary = strchr(contentType, '=');
+        boundaryStr = boundary ? boundary + 1 : "";
+        boundaryStr.replace("\"","");
+        isForm = true;
       }
     }
 
@@ -208,33 +202,18 @@ bool WebServer::_parseRequest(WiFiClient& client) {
       }
     }
   } else {
-    String headerName;
-    String headerValue;
-    //parse headers
-    while(1){
-      req = client.readStringUntil('\r');
-      client.readStringUntil('\n');
-      if (req == "") break;//no moar headers
-      int headerDiv = req.indexOf(':');
-      if (headerDiv == -1){
-        break;
-      }
-      headerName = req.substring(0, headerDiv);
-      headerValue = req.substring(headerDiv + 2);
-      _collectHeader(headerName.c_str(),headerValue.c_str());
-
-	  log_v("headerName: %s", headerName.c_str());
-	  log_v("headerValue: %s", headerValue.c_str());
-
-	  if (headerName.equalsIgnoreCase("Host")){
-        _hostHeader = headerValue;
-      }
+    // a body is not expected here and would be taken for the next request
+    if (_clientContentLength > 0) {
+      _currentKeepAlive = false;
     }
     _parseArguments(searchStr);
   }
-  client.flush();
+  // anything left belongs to the next request on a kept alive connection
+  if (!_currentKeepAlive) {
+    client.flush();
+  }
 
-  log_v("Request: %s", url.c_str());
+  log_v("Request: %s", _currentUri.c_str());
   log_v(" Arguments: %s", searchStr.c_str());
 
   return true;
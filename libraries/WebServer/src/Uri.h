@@ -6,6 +6,9 @@
 
 class Uri {
 
+    private:
+        bool _literal = false;  // copies made by Uri::clone() match exactly _uri
+
     protected:
         const String _uri;
 
@@ -16,7 +19,9 @@ class Uri {
         virtual ~Uri() {}
 
         virtual Uri* clone() const {
-            return new Uri(_uri);
+            Uri *uri = new Uri(_uri);
+            uri->_literal = true;
+            return uri;
         };
 
         virtual void initPathArgs(__attribute__((unused)) std::vector<String> &pathArgs) {}
@@ -24,6 +29,19 @@ class Uri {
         virtual bool canHandle(const String &requestUri, __attribute__((unused)) std::vector<String> &pathArgs) {
             return _uri == requestUri;
         }
+
+        // Pattern used to index the uri in the route table of WebServer. With params set,
+        // each "{}" segment of the pattern matches one path segment of the request.
+        // Only plain Uri copies are indexed by default, subclasses matching differently are
+        // asked with canHandle() unless they override this.
+        virtual bool routePattern(String &pattern, bool &params) const {
+            if (!_literal) {
+                return false;
+            }
+            pattern = _uri;
+            params = false;
+            return true;
+        }
 };
 
 #endif
@@ -42,11 +42,21 @@ static const char Content_Length[] = "Content-Length";
 WebServer::WebServer(IPAddress addr, int port)
 : _corsEnabled(false)
 , _server(addr, port)
+, _currentConnection(nullptr)
+, _connections(nullptr)
+, _maxConnections(HTTP_MAX_CONNECTIONS)
+, _statusTimeout{0, HTTP_MAX_DATA_WAIT, HTTP_MAX_CLOSE_WAIT}
+, _stats()
+, _statsWindowStart(0)
+, _statsWindowRequests(0)
 , _currentMethod(HTTP_ANY)
 , _currentVersion(0)
-, _currentStatus(HC_NONE)
-, _statusChange(0)
 , _nullDelay(true)
+, _keepAlive(false)
+, _keepAliveTimeout(HTTP_KEEPALIVE_TIMEOUT)
+, _keepAliveMaxRequests(HTTP_KEEPALIVE_MAX_REQUESTS)
+, _currentKeepAlive(false)
+, _keepAliveResponse(false)
 , _currentHandler(nullptr)
 , _firstHandler(nullptr)
 , _lastHandler(nullptr)
@@ -66,11 +76,21 @@ WebServer::WebServer(IPAddress addr, int port)
 WebServer::WebServer(int port)
 : _corsEnabled(false)
 , _server(port)
+, _currentConnection(nullptr)
+, _connections(nullptr)
+, _maxConnections(HTTP_MAX_CONNECTIONS)
+, _statusTimeout{0, HTTP_MAX_DATA_WAIT, HTTP_MAX_CLOSE_WAIT}
+, _stats()
+, _statsWindowStart(0)
+, _statsWindowRequests(0)
 , _currentMethod(HTTP_ANY)
 , _currentVersion(0)
-, _currentStatus(HC_NONE)
-, _statusChange(0)
 , _nullDelay(true)
+, _keepAlive(false)
+, _keepAliveTimeout(HTTP_KEEPALIVE_TIMEOUT)
+, _keepAliveMaxRequests(HTTP_KEEPALIVE_MAX_REQUESTS)
+, _currentKeepAlive(false)
+, _keepAliveResponse(false)
 , _currentHandler(nullptr)
 , _firstHandler(nullptr)
 , _lastHandler(nullptr)
@@ -89,6 +109,7 @@ WebServer::WebServer(int port)
 
 WebServer::~WebServer() {
   _server.close();
+  delete[] _connections;
   if (_currentHeaders)
     delete[]_currentHeaders;
   RequestHandler* handler = _firstHandler;
@@ -101,16 +122,33 @@ WebServer::~WebServer() {
 
 void WebServer::begin() {
   close();
+  if (!_connections)
+    _connections = new HTTPConnection[_maxConnections];
   _server.begin();
   _server.setNoDelay(true);
 }
 
 void WebServer::begin(uint16_t port) {
   close();
+  if (!_connections)
+    _connections = new HTTPConnection[_maxConnections];
   _server.begin(port);
   _server.setNoDelay(true);
 }
 
+void WebServer::setMaxConnections(uint8_t maxConnections) {
+  if (_connections) {
+    log_e("setMaxConnections() must be called before begin()");
+    return;
+  }
+  _maxConnections = maxConnections ? maxConnections : 1;
+}
+
+void WebServer::setStatusTimeout(HTTPClientStatus status, unsigned long timeout_ms) {
+  if (status != HC_NONE && status <= HC_WAIT_CLOSE)
+    _statusTimeout[status] = timeout_ms;
+}
+
 String WebServer::_extractParam(String& authReq,const String& param,const char delimit){
   int _begin = authReq.indexOf(param);
   if (_begin == -1)
@@ -269,6 +307,7 @@ void WebServer::addHandler(RequestHandler* handler) {
 }
 
 void WebServer::_addRequestHandler(RequestHandler* handler) {
+    _routes.add(handler);
     if (!_lastHandler) {
       _firstHandler = handler;
       _lastHandler = handler;
@@ -284,57 +323,109 @@ void WebServer::serveStatic(const char* uri, FS& fs, const char* path, const cha
 }
 
 void WebServer::handleClient() {
-  if (_currentStatus == HC_NONE) {
+  if (!_connections) {
+    return;
+  }
+
+  // accept new clients while there are free connection slots
+  for (uint8_t i = 0; i < _maxConnections; i++) {
+    HTTPConnection& conn = _connections[i];
+    if (conn.status != HC_NONE) {
+      continue;
+    }
     WiFiClient client = _server.available();
     if (!client) {
-      if (_nullDelay) {
-        delay(1);
-      }
-      return;
+      break;
     }
 
     log_v("New client: client.localIP()=%s", client.localIP().toString().c_str());
 
-    _currentClient = client;
-    _currentStatus = HC_WAIT_READ;
-    _statusChange = millis();
+    conn.client = client;
+    conn.status = HC_WAIT_READ;
+    conn.statusChange = millis();
+    conn.arrival = conn.statusChange;
+    conn.requests = 0;
+    conn.parser.reset();
+    _stats.connections++;
+    _stats.activeConnections++;
+  }
+
+  if (!_stats.activeConnections) {
+    _updateStats();
+    if (_nullDelay) {
+      delay(1);
+    }
+    return;
+  }
+
+  // advance each connection by one step, a slow client does not block the others
+  bool callYield = false;
+  for (uint8_t i = 0; i < _maxConnections; i++) {
+    HTTPConnection& conn = _connections[i];
+    if (conn.status != HC_NONE && _handleConnection(conn)) {
+      callYield = true;
+    }
+  }
+  _updateStats();
+
+  if (callYield) {
+    yield();
   }
+}
 
+// returns true if the connection is waiting for the client
+bool WebServer::_handleConnection(HTTPConnection& conn) {
   bool keepCurrentClient = false;
   bool callYield = false;
+  bool timedOut = false;
 
-  if (_currentClient.connected()) {
-    switch (_currentStatus) {
+  if (conn.client.connected()) {
+    switch (conn.status) {
     case HC_NONE:
       // No-op to avoid C++ compiler warning
       break;
     case HC_WAIT_READ:
-      // Wait for data from client to become available
-      if (_currentClient.available()) {
-        if (_parseRequest(_currentClient)) {
-          // because HTTP_MAX_SEND_WAIT is expressed in milliseconds,
-          // it must be divided by 1000
-          _currentClient.setTimeout(HTTP_MAX_SEND_WAIT / 1000);
-          _contentLength = CONTENT_LENGTH_NOT_SET;
-          _handleRequest();
-
-// Fix for issue with Chrome based browsers: https://github.com/espressif/arduino-esp32/issues/3652
-//           if (_currentClient.connected()) {
-//             _currentStatus = HC_WAIT_CLOSE;
-//             _statusChange = millis();
-//             keepCurrentClient = true;
-//           }
+      // consume the request line and headers as they arrive without blocking,
+      // pipelined requests are handled back to back
+      while (!keepCurrentClient && !timedOut && conn.client.connected()) {
+        bool idle = !conn.parser.started();
+        if (conn.client.available()) {
+          conn.parser.parse(conn.client);
+          if (idle && conn.parser.started()) {
+            // first bytes of a request on a kept alive connection
+            conn.statusChange = millis();
+            if (conn.requests) {
+              conn.arrival = conn.statusChange;
+            }
+          }
+        }
+        if (conn.parser.complete()) {
+          if (!_handleConnectionRequest(conn)) {
+            break;
+          }
+          conn.parser.reset();
+          conn.statusChange = millis();
+          continue;
+        } else if (conn.parser.failed()) {
+          break;
         }
-      } else { // !_currentClient.available()
-        if (millis() - _statusChange <= HTTP_MAX_DATA_WAIT) {
+        // an idle kept alive connection waits for the next request, otherwise the request is incomplete
+        bool keptAlive = conn.requests && !conn.parser.started();
+        unsigned long timeout = keptAlive ? _keepAliveTimeout : _statusTimeout[HC_WAIT_READ];
+        if (millis() - conn.statusChange <= timeout) {
           keepCurrentClient = true;
+        } else if (keptAlive) {
+          // the client did not send another request, this is not an error
+          break;
+        } else {
+          timedOut = true;
         }
         callYield = true;
       }
       break;
     case HC_WAIT_CLOSE:
       // Wait for client to close the connection
-      if (millis() - _statusChange <= HTTP_MAX_CLOSE_WAIT) {
+      if (millis() - conn.statusChange <= _statusTimeout[HC_WAIT_CLOSE]) {
         keepCurrentClient = true;
         callYield = true;
       }
@@ -342,19 +433,73 @@ void WebServer::handleClient() {
   }
 
   if (!keepCurrentClient) {
-    _currentClient = WiFiClient();
-    _currentStatus = HC_NONE;
-    _currentUpload.reset();
+    if (timedOut) {
+      _stats.timeouts++;
+    }
+    conn.client = WiFiClient();
+    conn.status = HC_NONE;
+    _stats.activeConnections--;
   }
+  return callYield;
+}
 
-  if (callYield) {
-    yield();
+// runs the handler for the request parsed by conn, returns true if the connection stays open
+bool WebServer::_handleConnectionRequest(HTTPConnection& conn) {
+  uint32_t queueWait = millis() - conn.arrival;
+  _stats.queueWaitTotal += queueWait;
+  if (queueWait > _stats.queueWaitMax) {
+    _stats.queueWaitMax = queueWait;
   }
+
+  bool keepAlive = false;
+  _currentConnection = &conn;
+  _currentClient = conn.client;
+  _keepAliveResponse = false;
+  conn.requests++;
+  if (_parseRequest(_currentClient)) {
+    // because HTTP_MAX_SEND_WAIT is expressed in milliseconds,
+    // it must be divided by 1000
+    _currentClient.setTimeout(HTTP_MAX_SEND_WAIT / 1000);
+    _contentLength = CONTENT_LENGTH_NOT_SET;
+    _handleRequest();
+    _stats.requests++;
+    _statsWindowRequests++;
+    keepAlive = _keepAliveResponse && _currentClient.connected();
+
+// Fix for issue with Chrome based browsers: https://github.com/espressif/arduino-esp32/issues/3652
+//           if (_currentClient.connected()) {
+//             conn.status = HC_WAIT_CLOSE;
+//             conn.statusChange = millis();
+//             keepCurrentClient = true;
+//           }
+  }
+  _currentClient = WiFiClient();
+  _currentConnection = nullptr;
+  _currentUpload.reset();
+  return keepAlive;
+}
+
+void WebServer::_updateStats() {
+  unsigned long now = millis();
+  if (now - _statsWindowStart >= 1000) {
+    // a window longer than a second means handleClient() was not called in time
+    _stats.requestsPerSecond = (now - _statsWindowStart < 2000) ? _statsWindowRequests : 0;
+    _statsWindowRequests = 0;
+    _statsWindowStart = now;
+  }
+  _stats.maxConnections = _maxConnections;
 }
 
 void WebServer::close() {
   _server.close();
-  _currentStatus = HC_NONE;
+  if (_connections) {
+    for (uint8_t i = 0; i < _maxConnections; i++) {
+      _connections[i].client = WiFiClient();
+      _connections[i].status = HC_NONE;
+    }
+  }
+  _stats = HTTPServerStats();
+  _stats.maxConnections = _maxConnections;
   if(!_headerKeysCount)
     collectHeaders(0, 0);
 }
@@ -364,17 +509,11 @@ void WebServer::stop() {
 }
 
 void WebServer::sendHeader(const String& name, const String& value, bool first) {
-  String headerLine = name;
-  headerLine += F(": ");
-  headerLine += value;
-  headerLine += "\r\n";
+  sendHeader(name.c_str(), value.c_str(), first);
+}
 
-  if (first) {
-    _responseHeaders = headerLine + _responseHeaders;
-  }
-  else {
-    _responseHeaders += headerLine;
-  }
+void WebServer::sendHeader(const char* name, const char* value, bool first) {
+  _responseHeaders.add(name, value, first);
 }
 
 void WebServer::setContentLength(const size_t contentLength) {
@@ -389,54 +528,63 @@ void WebServer::enableCORS(boolean value) {
   _corsEnabled = value;
 }
 
+void WebServer::enableKeepAlive(boolean value, unsigned long idleTimeout_ms, uint16_t maxRequests) {
+  _keepAlive = value;
+  _keepAliveTimeout = idleTimeout_ms;
+  _keepAliveMaxRequests = maxRequests ? maxRequests : 1;
+}
+
 void WebServer::enableCrossOrigin(boolean value) {
   enableCORS(value);
 }
 
-void WebServer::_prepareHeader(String& response, int code, const char* content_type, size_t contentLength) {
-    response = String(F("HTTP/1.")) + String(_currentVersion) + ' ';
-    response += String(code);
-    response += ' ';
-    response += _responseCodeToString(code);
-    response += "\r\n";
-
+void WebServer::_prepareHeader(int code, const char* content_type, size_t contentLength) {
     using namespace mime;
     if (!content_type)
         content_type = mimeTable[html].mimeType;
 
-    sendHeader(String(F("Content-Type")), String(FPSTR(content_type)), true);
+    _responseHeaders.add("Content-Type", content_type, true);
     if (_contentLength == CONTENT_LENGTH_NOT_SET) {
-        sendHeader(String(FPSTR(Content_Length)), String(contentLength));
+        _responseHeaders.add(Content_Length, contentLength);
     } else if (_contentLength != CONTENT_LENGTH_UNKNOWN) {
-        sendHeader(String(FPSTR(Content_Length)), String(_contentLength));
+        _responseHeaders.add(Content_Length, _contentLength);
     } else if(_contentLength == CONTENT_LENGTH_UNKNOWN && _currentVersion){ //HTTP/1.1 or above client
       //let's do chunked
       _chunked = true;
-      sendHeader(String(F("Accept-Ranges")),String(F("none")));
-      sendHeader(String(F("Transfer-Encoding")),String(F("chunked")));
+      _responseHeaders.add("Accept-Ranges", "none");
+      _responseHeaders.add("Transfer-Encoding", "chunked");
     }
     if (_corsEnabled) {
-        sendHeader(String(FPSTR("Access-Control-Allow-Origin")), String("*"));
-	sendHeader(String(FPSTR("Access-Control-Allow-Methods")), String("*"));
-	sendHeader(String(FPSTR("Access-Control-Allow-Headers")), String("*"));
+      _responseHeaders.add("Access-Control-Allow-Origin", "*");
+      _responseHeaders.add("Access-Control-Allow-Methods", "*");
+      _responseHeaders.add("Access-Control-Allow-Headers", "*");
     }
-    sendHeader(String(F("Connection")), String(F("close")));
+    // the connection can only be reused if the client can tell where the body ends
+    _keepAliveResponse = _currentKeepAlive && (_chunked || _contentLength != CONTENT_LENGTH_UNKNOWN);
+    _responseHeaders.add("Connection", _keepAliveResponse ? "keep-alive" : "close");
 
-    response += _responseHeaders;
-    response += "\r\n";
-    _responseHeaders = "";
+    _responseHeaders.finish(_currentVersion, code, _responseCodeToChars(code));
+}
+
+void WebServer::_sendPreparedHeader() {
+    _currentClientWrite(_responseHeaders.data(), _responseHeaders.length());
+    _responseHeaders.clear();
 }
 
 void WebServer::send(int code, const char* content_type, const String& content) {
-    String header;
     // Can we asume the following?
     //if(code == 200 && content.length() == 0 && _contentLength == CONTENT_LENGTH_NOT_SET)
     //  _contentLength = CONTENT_LENGTH_UNKNOWN;
     if (content.length() == 0) {
         log_w("content length is zero");
     }
-    _prepareHeader(header, code, content_type, content.length());
-    _currentClientWrite(header.c_str(), header.length());
+    _prepareHeader(code, content_type, content.length());
+    // small bodies go out with the header in a single write
+    if (content.length() && !_chunked && _responseHeaders.append(content.c_str(), content.length())) {
+      _sendPreparedHeader();
+      return;
+    }
+    _sendPreparedHeader();
     if(content.length())
       sendContent(content);
 }
@@ -465,20 +613,18 @@ void WebServer::send_P(int code, PGM_P content_type, PGM_P content) {
         contentLength = strlen_P(content);
     }
 
-    String header;
     char type[64];
     memccpy_P((void*)type, (PGM_VOID_P)content_type, 0, sizeof(type));
-    _prepareHeader(header, code, (const char* )type, contentLength);
-    _currentClientWrite(header.c_str(), header.length());
+    _prepareHeader(code, (const char* )type, contentLength);
+    _sendPreparedHeader();
     sendContent_P(content);
 }
 
 void WebServer::send_P(int code, PGM_P content_type, PGM_P content, size_t contentLength) {
-    String header;
     char type[64];
     memccpy_P((void*)type, (PGM_VOID_P)content_type, 0, sizeof(type));
-    _prepareHeader(header, code, (const char* )type, contentLength);
-    sendContent(header);
+    _prepareHeader(code, (const char* )type, contentLength);
+    _sendPreparedHeader();
     sendContent_P(content, contentLength);
 }
 
@@ -487,21 +633,10 @@ void WebServer::sendContent(const String& content) {
 }
 
 void WebServer::sendContent(const char* content, size_t contentLength) {
-  const char * footer = "\r\n";
   if(_chunked) {
-    char * chunkSize = (char *)malloc(11);
-    if(chunkSize){
-      sprintf(chunkSize, "%x%s", contentLength, footer);
-      _currentClientWrite(chunkSize, strlen(chunkSize));
-      free(chunkSize);
-    }
-  }
-  _currentClientWrite(content, contentLength);
-  if(_chunked){
-    _currentClient.write(footer, 2);
-    if (contentLength == 0) {
-      _chunked = false;
-    }
+    _sendChunk(content, contentLength, false);
+  } else {
+    _currentClientWrite(content, contentLength);
   }
 }
 
@@ -510,21 +645,36 @@ void WebServer::sendContent_P(PGM_P content) {
 }
 
 void WebServer::sendContent_P(PGM_P content, size_t size) {
-  const char * footer = "\r\n";
   if(_chunked) {
-    char * chunkSize = (char *)malloc(11);
-    if(chunkSize){
-      sprintf(chunkSize, "%x%s", size, footer);
-      _currentClientWrite(chunkSize, strlen(chunkSize));
-      free(chunkSize);
-    }
+    _sendChunk(content, size, true);
+  } else {
+    _currentClientWrite_P(content, size);
   }
-  _currentClientWrite_P(content, size);
-  if(_chunked){
-    _currentClient.write(footer, 2);
-    if (size == 0) {
-      _chunked = false;
+}
+
+// frames content as one chunk, small chunks are gathered into a single write
+void WebServer::_sendChunk(const char* content, size_t contentLength, bool progmem) {
+  const char * footer = "\r\n";
+  char chunkSize[12];
+  size_t chunkSizeLen = snprintf(chunkSize, sizeof(chunkSize), "%x%s", (unsigned)contentLength, footer);
+  size_t arenaSize;
+  char* arena = _responseHeaders.arena(arenaSize);
+  if (arena && chunkSizeLen + contentLength + 2 <= arenaSize) {
+    memcpy(arena, chunkSize, chunkSizeLen);
+    memcpy_P(arena + chunkSizeLen, content, contentLength);
+    memcpy(arena + chunkSizeLen + contentLength, footer, 2);
+    _currentClientWrite(arena, chunkSizeLen + contentLength + 2);
+  } else {
+    _currentClientWrite(chunkSize, chunkSizeLen);
+    if (progmem) {
+      _currentClientWrite_P(content, contentLength);
+    } else {
+      _currentClientWrite(content, contentLength);
     }
+    _currentClientWrite(footer, 2);
+  }
+  if (contentLength == 0) {
+    _chunked = false;
   }
 }
 
@@ -536,7 +686,7 @@ void WebServer::_streamFileCore(const size_t fileSize, const String & fileName,
   if (fileName.endsWith(String(FPSTR(mimeTable[gz].endsWith))) &&
       contentType != String(FPSTR(mimeTable[gz].mimeType)) &&
       contentType != String(FPSTR(mimeTable[none].mimeType))) {
-    sendHeader(F("Content-Encoding"), F("gzip"));
+    sendHeader("Content-Encoding", "gzip");
   }
   send(code, contentType, "");
 }
@@ -631,6 +781,12 @@ bool WebServer::hasHeader(String name) {
   return false;
 }
 
+const char* WebServer::requestHeader(const char* name) {
+  if (!_currentConnection)
+    return nullptr;
+  return _currentConnection->parser.header(name);
+}
+
 String WebServer::hostHeader() {
   return _hostHeader;
 }
@@ -677,47 +833,51 @@ void WebServer::_finalizeResponse() {
 }
 
 String WebServer::_responseCodeToString(int code) {
+  return String(_responseCodeToChars(code));
+}
+
+const char* WebServer::_responseCodeToChars(int code) {
   switch (code) {
-    case 100: return F("Continue");
-    case 101: return F("Switching Protocols");
-    case 200: return F("OK");
-    case 201: return F("Created");
-    case 202: return F("Accepted");
-    case 203: return F("Non-Authoritative Information");
-    case 204: return F("No Content");
-    case 205: return F("Reset Content");
-    case 206: return F("Partial Content");
-    case 300: return F("Multiple Choices");
-    case 301: return F("Moved Permanently");
-    case 302: return F("Found");
-    case 303: return F("See Other");
-    case 304: return F("Not Modified");
-    case 305: return F("Use Proxy");
-    case 307: return F("Temporary Redirect");
-    case 400: return F("Bad Request");
-    case 401: return F("Unauthorized");
-    case 402: return F("Payment Required");
-    case 403: return F("Forbidden");
-    case 404: return F("Not Found");
-    case 405: return F("Method Not Allowed");
-    case 406: return F("Not Acceptable");
-    case 407: return F("Proxy Authentication Required");
-    case 408: return F("Request Time-out");
-    case 409: return F("Conflict");
-    case 410: return F("Gone");
-    case 411: return F("Length Required");
-    case 412: return F("Precondition Failed");
-    case 413: return F("Request Entity Too Large");
-    case 414: return F("Request-URI Too Large");
-    case 415: return F("Unsupported Media Type");
-    case 416: return F("Requested range not satisfiable");
-    case 417: return F("Expectation Failed");
-    case 500: return F("Internal Server Error");
-    case 501: return F("Not Implemented");
-    case 502: return F("Bad Gateway");
-    case 503: return F("Service Unavailable");
-    case 504: return F("Gateway Time-out");
-    case 505: return F("HTTP Version not supported");
-    default:  return F("");
+    case 100: return "Continue";
+    case 101: return "Switching Protocols";
+    case 200: return "OK";
+    case 201: return "Created";
+    case 202: return "Accepted";
+    case 203: return "Non-Authoritative Information";
+    case 204: return "No Content";
+    case 205: return "Reset Content";
+    case 206: return "Partial Content";
+    case 300: return "Multiple Choices";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 303: return "See Other";
+    case 304: return "Not Modified";
+    case 305: return "Use Proxy";
+    case 307: return "Temporary Redirect";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 402: return "Payment Required";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 406: return "Not Acceptable";
+    case 407: return "Proxy Authentication Required";
+    case 408: return "Request Time-out";
+    case 409: return "Conflict";
+    case 410: return "Gone";
+    case 411: return "Length Required";
+    case 412: return "Precondition Failed";
+    case 413: return "Request Entity Too Large";
+    case 414: return "Request-URI Too Large";
+    case 415: return "Unsupported Media Type";
+    case 416: return "Requested range not satisfiable";
+    case 417: return "Expectation Failed";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 502: return "Bad Gateway";
+    case 503: return "Service Unavailable";
+    case 504: return "Gateway Time-out";
+    case 505: return "HTTP Version not supported";
+    default:  return "";
   }
 }
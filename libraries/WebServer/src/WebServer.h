@@ -29,6 +29,8 @@
 #include <WiFi.h>
 #include "HTTP_Method.h"
 #include "Uri.h"
+#include "detail/HTTPRequestParser.h"
+#include "detail/HTTPResponseHeader.h"
 
 enum HTTPUploadStatus { UPLOAD_FILE_START, UPLOAD_FILE_WRITE, UPLOAD_FILE_END,
                         UPLOAD_FILE_ABORTED };
@@ -46,6 +48,27 @@ enum HTTPAuthMethod { BASIC_AUTH, DIGEST_AUTH };
 #define HTTP_MAX_SEND_WAIT 5000 //ms to wait for data chunk to be ACKed
 #define HTTP_MAX_CLOSE_WAIT 2000 //ms to wait for the client to close the connection
 
+#ifndef HTTP_STATIC_CHUNK_SIZE
+#define HTTP_STATIC_CHUNK_SIZE 4096 //bytes read from the file system per write by serveStatic()
+#endif
+#ifndef HTTP_STATIC_CACHE_ENTRIES
+#define HTTP_STATIC_CACHE_ENTRIES 16 //file metadata entries cached by each serveStatic() handler
+#endif
+#ifndef HTTP_STATIC_CACHE_TTL
+#define HTTP_STATIC_CACHE_TTL 10000 //ms before cached file metadata is read again
+#endif
+
+#ifndef HTTP_KEEPALIVE_TIMEOUT
+#define HTTP_KEEPALIVE_TIMEOUT 5000 //ms a kept alive connection may stay idle between requests
+#endif
+#ifndef HTTP_KEEPALIVE_MAX_REQUESTS
+#define HTTP_KEEPALIVE_MAX_REQUESTS 100 //requests served over a kept alive connection before it is closed
+#endif
+
+#ifndef HTTP_MAX_CONNECTIONS
+#define HTTP_MAX_CONNECTIONS 1 //default number of clients served concurrently, see setMaxConnections()
+#endif
+
 #define CONTENT_LENGTH_UNKNOWN ((size_t) -1)
 #define CONTENT_LENGTH_NOT_SET ((size_t) -2)
 
@@ -61,7 +84,19 @@ typedef struct {
   uint8_t buf[HTTP_UPLOAD_BUFLEN];
 } HTTPUpload;
 
+typedef struct {
+  uint8_t  activeConnections;  // connections currently open
+  uint8_t  maxConnections;
+  uint32_t connections;        // connections accepted since begin()
+  uint32_t requests;           // requests handled since begin()
+  uint32_t timeouts;           // connections dropped because a state timed out
+  uint32_t requestsPerSecond;  // requests handled during the last full second
+  uint32_t queueWaitMax;       // ms from accept (first bytes for later kept alive requests) to running the handler
+  uint32_t queueWaitTotal;     // sum over all requests, divide by requests for the average
+} HTTPServerStats;
+
 #include "detail/RequestHandler.h"
+#include "detail/RouteTable.h"
 
 namespace fs {
 class FS;
@@ -81,6 +116,12 @@ public:
   virtual void close();
   void stop();
 
+  // number of clients that are served concurrently, must be called before begin()
+  void setMaxConnections(uint8_t maxConnections);
+  // ms a connection may stay in HC_WAIT_READ or HC_WAIT_CLOSE
+  void setStatusTimeout(HTTPClientStatus status, unsigned long timeout_ms);
+  const HTTPServerStats& stats() { return _stats; }
+
   bool authenticate(const char * username, const char * password);
   void requestAuthentication(HTTPAuthMethod mode = BASIC_AUTH, const char* realm = NULL, const String& authFailMsg = String("") );
 
@@ -110,6 +151,7 @@ public:
   String headerName(int i);       // get request header name by number
   int headers();                  // get header count
   bool hasHeader(String name);    // check if header exists
+  const char* requestHeader(const char* name); // get any header of the current request, NULL if not sent
 
   int clientContentLength() { return _clientContentLength; }      // return "content-length" of incoming HTTP header from "_currentClient"
 
@@ -129,10 +171,14 @@ public:
 
   void enableDelay(boolean value);
   void enableCORS(boolean value = true);
+  // keep connections open between requests (HTTP/1.1 persistent connections) and parse
+  // pipelined requests back to back
+  void enableKeepAlive(boolean value = true, unsigned long idleTimeout_ms = HTTP_KEEPALIVE_TIMEOUT, uint16_t maxRequests = HTTP_KEEPALIVE_MAX_REQUESTS);
   void enableCrossOrigin(boolean value = true);
 
   void setContentLength(const size_t contentLength);
   void sendHeader(const String& name, const String& value, bool first = false);
+  void sendHeader(const char* name, const char* value, bool first = false);
   void sendContent(const String& content);
   void sendContent(const char* content, size_t contentLength);
   void sendContent_P(PGM_P content);
@@ -149,17 +195,32 @@ public:
 protected:
   virtual size_t _currentClientWrite(const char* b, size_t l) { return _currentClient.write( b, l ); }
   virtual size_t _currentClientWrite_P(PGM_P b, size_t l) { return _currentClient.write_P( b, l ); }
+  struct HTTPConnection {
+    WiFiClient        client;
+    HTTPRequestParser parser;
+    HTTPClientStatus  status = HC_NONE;
+    unsigned long     statusChange = 0;
+    unsigned long     arrival = 0;   // accept, or first bytes of a later request, for the stats
+    uint16_t          requests = 0;  // requests served over this connection
+  };
+
   void _addRequestHandler(RequestHandler* handler);
+  bool _handleConnection(HTTPConnection& conn);
+  bool _handleConnectionRequest(HTTPConnection& conn);
+  void _updateStats();
   void _handleRequest();
   void _finalizeResponse();
   bool _parseRequest(WiFiClient& client);
   void _parseArguments(String data);
   static String _responseCodeToString(int code);
+  static const char* _responseCodeToChars(int code);
   bool _parseForm(WiFiClient& client, String boundary, uint32_t len);
   bool _parseFormUploadAborted();
   void _uploadWriteByte(uint8_t b);
   int _uploadReadByte(WiFiClient& client);
-  void _prepareHeader(String& response, int code, const char* content_type, size_t contentLength);
+  void _prepareHeader(int code, const char* content_type, size_t contentLength);
+  void _sendPreparedHeader();
+  void _sendChunk(const char* content, size_t contentLength, bool progmem);
   bool _collectHeader(const char* headerName, const char* headerValue);
 
   void _streamFileCore(const size_t fileSize, const String & fileName, const String & contentType, const int code = 200);
@@ -177,16 +238,27 @@ protected:
   WiFiServer  _server;
 
   WiFiClient  _currentClient;
+  HTTPConnection* _currentConnection;
+  HTTPConnection* _connections;
+  uint8_t     _maxConnections;
+  unsigned long _statusTimeout[HC_WAIT_CLOSE + 1];
+  HTTPServerStats _stats;
+  unsigned long _statsWindowStart;
+  uint32_t    _statsWindowRequests;
   HTTPMethod  _currentMethod;
   String      _currentUri;
   uint8_t     _currentVersion;
-  HTTPClientStatus _currentStatus;
-  unsigned long _statusChange;
   boolean     _nullDelay;
+  boolean     _keepAlive;
+  unsigned long _keepAliveTimeout;
+  uint16_t    _keepAliveMaxRequests;
+  bool        _currentKeepAlive;   // the current request may keep the connection open
+  bool        _keepAliveResponse;  // the response sent for the current request keeps it open
 
   RequestHandler*  _currentHandler;
   RequestHandler*  _firstHandler;
   RequestHandler*  _lastHandler;
+  RouteTable       _routes;
   THandlerFunction _notFoundHandler;
   THandlerFunction _fileUploadHandler;
 
@@ -201,7 +273,7 @@ protected:
   RequestArgument* _currentHeaders;
   size_t           _contentLength;
   int              _clientContentLength;	// "Content-Length" from header of incoming POST or GET request
-  String           _responseHeaders;
+  HTTPResponseHeader _responseHeaders;
 
   String           _hostHeader;
   bool             _chunked;
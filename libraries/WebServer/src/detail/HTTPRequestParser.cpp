@@ -0,0 +1,178 @@
+/*
+  HTTPRequestParser.cpp - Incremental HTTP request head parser.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <Arduino.h>
+#include <esp32-hal-log.h>
+#include "HTTPRequestParser.h"
+
+static bool isSpace(char c) {
+  return c == ' ' || c == '\t';
+}
+
+void HTTPRequestParser::reset() {
+  _state = PARSE_REQUEST_LINE;
+  _buf[0] = '\0';
+  _len = 1;
+  _lineStart = 1;
+  _method = 0;
+  _uri = 0;
+  _query = 0;
+  _version = 0;
+  _headerCount = 0;
+}
+
+HTTPRequestParser::State HTTPRequestParser::parse(Stream& stream) {
+  if (stream.hasPeekBufferAPI()) {
+    // feed() stops at the end of the head, so only the head is consumed
+    size_t available;
+    while (_state != PARSE_COMPLETE && _state != PARSE_ERROR && (available = stream.peekAvailable())) {
+      stream.peekConsume(feed(stream.peekBuffer(), available));
+    }
+    return _state;
+  }
+  while (_state != PARSE_COMPLETE && _state != PARSE_ERROR && stream.available()) {
+    int c = stream.read();
+    if (c < 0) {
+      break;
+    }
+    _pushByte((char)c);
+  }
+  return _state;
+}
+
+size_t HTTPRequestParser::feed(const char* data, size_t len) {
+  size_t i = 0;
+  while (i < len && _state != PARSE_COMPLETE && _state != PARSE_ERROR) {
+    _pushByte(data[i++]);
+  }
+  return i;
+}
+
+const char* HTTPRequestParser::header(const char* name) const {
+  for (size_t i = 0; i < _headerCount; i++) {
+    if (strcasecmp(headerName(i), name) == 0) {
+      return headerValue(i);
+    }
+  }
+  return NULL;
+}
+
+bool HTTPRequestParser::_pushByte(char c) {
+  if (c != '\n') {
+    // keep one byte for the terminating NUL of the line
+    if (_len >= sizeof(_buf) - 1) {
+      log_e("Request header too large (max: %d)", HTTP_REQUEST_BUFLEN);
+      _state = PARSE_ERROR;
+      return false;
+    }
+    _buf[_len++] = c;
+    return true;
+  }
+
+  // complete line in _buf[_lineStart, _len), strip CR
+  size_t end = _len;
+  if (end > _lineStart && _buf[end - 1] == '\r') {
+    end--;
+  }
+  _buf[end] = '\0';
+  char* line = _buf + _lineStart;
+
+  if (_state == PARSE_REQUEST_LINE) {
+    if (line[0] == '\0') {
+      // tolerate empty lines in front of the request line (RFC 7230 3.5)
+      _len = _lineStart;
+      return true;
+    }
+    if (!_parseRequestLine(line)) {
+      _state = PARSE_ERROR;
+      return false;
+    }
+    _state = PARSE_HEADERS;
+  } else if (line[0] == '\0') {
+    _state = PARSE_COMPLETE;
+    return true;
+  } else if (!_parseHeader(line)) {
+    // malformed or one header too many, drop the line
+    _len = _lineStart;
+    return true;
+  }
+  _len = end + 1;
+  _lineStart = _len;
+  return true;
+}
+
+bool HTTPRequestParser::_parseRequestLine(char* line) {
+  // First line of HTTP request looks like "GET /path?search HTTP/1.1"
+  char* addr_start = strchr(line, ' ');
+  if (!addr_start) {
+    log_e("Invalid request: %s", line);
+    return false;
+  }
+  char* addr_end = strchr(addr_start + 1, ' ');
+  if (!addr_end) {
+    log_e("Invalid request: %s", line);
+    return false;
+  }
+  *addr_start = '\0';
+  *addr_end = '\0';
+  _method = line - _buf;
+  _uri = addr_start + 1 - _buf;
+
+  char* search = strchr(addr_start + 1, '?');
+  if (search) {
+    *search = '\0';
+    _query = search + 1 - _buf;
+  }
+
+  const char* version = addr_end + 1;
+  if (strncmp(version, "HTTP/1.", 7) == 0) {
+    _version = atoi(version + 7);
+  }
+  return true;
+}
+
+bool HTTPRequestParser::_parseHeader(char* line) {
+  if (_headerCount >= HTTP_MAX_REQUEST_HEADERS) {
+    log_w("Too many request headers (max: %d)", HTTP_MAX_REQUEST_HEADERS);
+    return false;
+  }
+  char* div = strchr(line, ':');
+  if (!div) {
+    return false;
+  }
+  char* nameEnd = div;
+  while (nameEnd > line && isSpace(nameEnd[-1])) {
+    nameEnd--;
+  }
+  *nameEnd = '\0';
+
+  char* value = div + 1;
+  while (isSpace(*value)) {
+    value++;
+  }
+  char* valueEnd = value + strlen(value);
+  while (valueEnd > value && isSpace(valueEnd[-1])) {
+    valueEnd--;
+  }
+  *valueEnd = '\0';
+
+  _headers[_headerCount].name = line - _buf;
+  _headers[_headerCount].value = value - _buf;
+  _headerCount++;
+  return true;
+}
@@ -0,0 +1,96 @@
+/*
+  HTTPRequestParser.h - Incremental HTTP request head parser.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef HTTPREQUESTPARSER_H
+#define HTTPREQUESTPARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Stream;
+
+// size of the per connection buffer holding the request line and all headers
+#ifndef HTTP_REQUEST_BUFLEN
+#define HTTP_REQUEST_BUFLEN 2048
+#endif
+
+// headers beyond this count are skipped
+#ifndef HTTP_MAX_REQUEST_HEADERS
+#define HTTP_MAX_REQUEST_HEADERS 32
+#endif
+
+// offsets into the buffer are uint16_t, the header count is uint8_t
+static_assert(HTTP_REQUEST_BUFLEN <= UINT16_MAX, "HTTP_REQUEST_BUFLEN must not exceed 65535");
+static_assert(HTTP_MAX_REQUEST_HEADERS <= UINT8_MAX, "HTTP_MAX_REQUEST_HEADERS must not exceed 255");
+
+// Parses the request line and the headers of a HTTP request into a fixed buffer
+// without allocating. The input is consumed exactly up to the empty line that
+// terminates the headers, so the body or a pipelined request is left in the stream.
+// All returned strings are NUL terminated views into the buffer, valid until reset().
+class HTTPRequestParser {
+public:
+  enum State { PARSE_REQUEST_LINE, PARSE_HEADERS, PARSE_COMPLETE, PARSE_ERROR };
+
+  HTTPRequestParser() { reset(); }
+
+  void reset();
+
+  // consumes whatever the stream has available, never blocks
+  State parse(Stream& stream);
+  // returns the number of bytes consumed
+  size_t feed(const char* data, size_t len);
+
+  State state() const { return _state; }
+  bool complete() const { return _state == PARSE_COMPLETE; }
+  bool failed() const { return _state == PARSE_ERROR; }
+  // true once any byte of a request has been received
+  bool started() const { return _len > 1; }
+
+  const char* method() const { return _buf + _method; }
+  const char* uri() const { return _buf + _uri; }
+  const char* query() const { return _buf + _query; } // empty if there is no '?'
+  uint8_t version() const { return _version; }         // minor version of HTTP/1.x
+
+  size_t headers() const { return _headerCount; }
+  const char* headerName(size_t i) const { return _buf + _headers[i].name; }
+  const char* headerValue(size_t i) const { return _buf + _headers[i].value; }
+  const char* header(const char* name) const;          // case insensitive, NULL if not found
+
+protected:
+  bool _pushByte(char c);
+  bool _parseRequestLine(char* line);
+  bool _parseHeader(char* line);
+
+  struct Header {
+    uint16_t name;
+    uint16_t value;
+  };
+
+  State    _state;
+  uint16_t _len;        // bytes used in _buf, _buf[0] is kept as the empty string
+  uint16_t _lineStart;  // offset of the line currently being received
+  uint16_t _method;
+  uint16_t _uri;
+  uint16_t _query;
+  uint8_t  _version;
+  uint8_t  _headerCount;
+  Header   _headers[HTTP_MAX_REQUEST_HEADERS];
+  char     _buf[HTTP_REQUEST_BUFLEN];
+};
+
+#endif //HTTPREQUESTPARSER_H
@@ -0,0 +1,114 @@
+/*
+  HTTPResponseHeader.cpp - Fixed buffer for building HTTP response headers.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <Arduino.h>
+#include <esp32-hal-log.h>
+#include "HTTPResponseHeader.h"
+
+HTTPResponseHeader::~HTTPResponseHeader() {
+  if (_buf != _fixed) {
+    free(_buf);
+  }
+}
+
+void HTTPResponseHeader::clear() {
+  _start = HEADROOM;
+  _len = HEADROOM;
+}
+
+char* HTTPResponseHeader::arena(size_t& size) {
+  if (_len != HEADROOM) {
+    return nullptr;
+  }
+  size = _size;
+  return _buf;
+}
+
+bool HTTPResponseHeader::append(const char* data, size_t len) {
+  if (_len + len > _size) {
+    return false;
+  }
+  memcpy(_buf + _len, data, len);
+  _len += len;
+  return true;
+}
+
+bool HTTPResponseHeader::_reserve(size_t len) {
+  if (_len + len <= _size) {
+    return true;
+  }
+  size_t size = _size * 2;
+  while (size < _len + len) {
+    size *= 2;
+  }
+  log_w("Response headers exceed %d bytes", HTTP_RESPONSE_HEADER_BUFLEN);
+  char* buf = (char*)malloc(size);
+  if (!buf) {
+    log_e("Not enough memory for response headers");
+    return false;
+  }
+  memcpy(buf, _buf, _len);
+  if (_buf != _fixed) {
+    free(_buf);
+  }
+  _buf = buf;
+  _size = size;
+  return true;
+}
+
+bool HTTPResponseHeader::add(const char* name, const char* value, bool first) {
+  size_t nameLen = strlen(name);
+  size_t valueLen = strlen(value);
+  size_t lineLen = nameLen + valueLen + 4;
+  // keep room for the final CRLF
+  if (!_reserve(lineLen + 2)) {
+    return false;
+  }
+  char* line = _buf + _len;
+  if (first) {
+    memmove(_buf + HEADROOM + lineLen, _buf + HEADROOM, _len - HEADROOM);
+    line = _buf + HEADROOM;
+  }
+  memcpy(line, name, nameLen);
+  line += nameLen;
+  *line++ = ':';
+  *line++ = ' ';
+  memcpy(line, value, valueLen);
+  line += valueLen;
+  *line++ = '\r';
+  *line = '\n';
+  _len += lineLen;
+  return true;
+}
+
+bool HTTPResponseHeader::add(const char* name, size_t value, bool first) {
+  char buf[12];
+  return add(name, utoa(value, buf, 10), first);
+}
+
+void HTTPResponseHeader::finish(uint8_t version, int code, const char* reason) {
+  char status[HEADROOM + 1];
+  int statusLen = snprintf(status, sizeof(status), "HTTP/1.%u %d %s\r\n", version, code, reason);
+  if (statusLen < 0 || statusLen > (int)HEADROOM) {
+    statusLen = HEADROOM;
+  }
+  _start = HEADROOM - statusLen;
+  memcpy(_buf + _start, status, statusLen);
+  _buf[_len++] = '\r';
+  _buf[_len++] = '\n';
+}
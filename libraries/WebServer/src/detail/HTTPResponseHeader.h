@@ -0,0 +1,67 @@
+/*
+  HTTPResponseHeader.h - Fixed buffer for building HTTP response headers.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef HTTPRESPONSEHEADER_H
+#define HTTPRESPONSEHEADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// size of the buffer holding the status line and the response headers,
+// the buffer moves to the heap only if the headers do not fit
+#ifndef HTTP_RESPONSE_HEADER_BUFLEN
+#define HTTP_RESPONSE_HEADER_BUFLEN 768
+#endif
+
+// Collects "name: value" lines in a fixed buffer. Space for the status line is
+// kept in front of them, so the complete header goes out with a single write().
+// Once it has been sent the buffer can be reused as scratch space, see arena().
+class HTTPResponseHeader {
+public:
+  HTTPResponseHeader() : _buf(_fixed), _size(sizeof(_fixed)), _start(HEADROOM), _len(HEADROOM) {}
+  ~HTTPResponseHeader();
+
+  void clear();
+  bool add(const char* name, const char* value, bool first = false);
+  bool add(const char* name, size_t value, bool first = false);
+
+  // adds the status line and the terminating empty line
+  void finish(uint8_t version, int code, const char* reason);
+  // adds body bytes after finish(), returns false if they do not fit into the buffer
+  bool append(const char* data, size_t len);
+
+  const char* data() const { return _buf + _start; }
+  size_t length() const { return _len - _start; }
+
+  // scratch space to assemble small writes, NULL while headers are pending
+  char* arena(size_t& size);
+
+protected:
+  // longest status line is "HTTP/1.1 407 Proxy Authentication Required\r\n"
+  static const size_t HEADROOM = 64;
+
+  bool _reserve(size_t len);
+
+  char*  _buf;
+  size_t _size;
+  size_t _start; // start of the status line once finished, else HEADROOM
+  size_t _len;   // end of the header lines, they start at HEADROOM
+  char   _fixed[HTTP_RESPONSE_HEADER_BUFLEN];
+};
+
+#endif //HTTPRESPONSEHEADER_H
@@ -11,6 +11,9 @@ public:
     virtual bool canUpload(String uri) { (void) uri; return false; }
     virtual bool handle(WebServer& server, HTTPMethod requestMethod, String requestUri) { (void) server; (void) requestMethod; (void) requestUri; return false; }
     virtual void upload(WebServer& server, String requestUri, HTTPUpload& upload) { (void) server; (void) requestUri; (void) upload; }
+    // Describes the handler for the route table of WebServer, see Uri::routePattern().
+    // Handlers returning false are matched by calling canHandle() in registration order.
+    virtual bool routePattern(String &pattern, bool &params, HTTPMethod &method) { (void) pattern; (void) params; (void) method; return false; }
 
     RequestHandler* next() { return _next; }
     void next(RequestHandler* r) { _next = r; }
@@ -30,6 +30,11 @@ public:
         return _uri->canHandle(requestUri, pathArgs);
     }
 
+    bool routePattern(String &pattern, bool &params, HTTPMethod &method) override {
+        method = _method;
+        return _uri->routePattern(pattern, params);
+    }
+
     bool canUpload(String requestUri) override  {
         if (!_ufn || !canHandle(HTTP_POST, requestUri))
             return false;
@@ -67,6 +72,7 @@ public:
     , _uri(uri)
     , _path(path)
     , _cache_header(cache_header)
+    , _cacheClock(0)
     {
         File f = fs.open(path);
         _isFile = (f && (! f.isDirectory()));
@@ -90,62 +96,254 @@ public:
 
         log_v("StaticRequestHandler::handle: request=%s _uri=%s\r\n", requestUri.c_str(), _uri.c_str());
 
-        String path(_path);
+        // Base URI doesn't point to a file.
+        // If a directory is requested, look for index file.
+        if (!_isFile && requestUri.endsWith("/"))
+            requestUri += "index.htm";
 
-        if (!_isFile) {
-            // Base URI doesn't point to a file.
-            // If a directory is requested, look for index file.
-            if (requestUri.endsWith("/")) 
-              requestUri += "index.htm";
+        File f;
+        CacheEntry* entry = _cached(requestUri);
+        if (!entry) {
+            entry = _resolve(requestUri, f);
+            if (!entry)
+                return false;
+        }
+
+        char etag[24];
+        _formatETag(*entry, etag, sizeof(etag));
+
+        // answered from the cached metadata without touching the file system
+        const char* ifNoneMatch = etag[0] ? server.requestHeader("If-None-Match") : nullptr;
+        if (ifNoneMatch && (strstr(ifNoneMatch, etag) || strcmp(ifNoneMatch, "*") == 0)) {
+            _sendHeaders(server, *entry, etag);
+            server.setContentLength(0);
+            server.send(304, mimeTable[entry->mime].mimeType, "");
+            return true;
+        }
 
+        if (!f)
+            f = _fs.open(entry->path, "r");
+        if (!f || !f.available()) {
+            entry->uri = String();
+            return false;
+        }
+        // the cached metadata may be up to HTTP_STATIC_CACHE_TTL old, the headers must match what is sent
+        size_t size = f.size();
+        time_t lastWrite = f.getLastWrite();
+        if (size != entry->size || lastWrite != entry->lastWrite) {
+            entry->size = size;
+            entry->lastWrite = lastWrite;
+            entry->validated = millis();
+            _formatETag(*entry, etag, sizeof(etag));
+        }
+
+        size_t start = 0;
+        size_t end = entry->size - 1;
+        int code = 200;
+        const char* range = server.requestHeader("Range");
+        if (range) {
+            int res = _parseRange(range, entry->size, start, end);
+            if (res < 0) {
+                server.sendHeader("Content-Range", String("bytes */") + String(entry->size));
+                server.send(416, mimeTable[txt].mimeType, "");
+                return true;
+            }
+            if (res > 0) {
+                code = 206;
+                char contentRange[48];
+                snprintf(contentRange, sizeof(contentRange), "bytes %u-%u/%u", (unsigned)start, (unsigned)end, (unsigned)entry->size);
+                server.sendHeader("Content-Range", contentRange);
+            }
+        }
+
+        _sendHeaders(server, *entry, etag);
+        size_t length = entry->size ? end - start + 1 : 0;
+        server.setContentLength(length);
+        server.send(code, mimeTable[entry->mime].mimeType, "");
+
+        if (start && !f.seek(start))
+            return true;
+        _streamRange(server, f, length);
+        return true;
+    }
+
+    static String getContentType(const String& path) {
+        return String(mimeTable[_mimeType(path)].mimeType);
+    }
+
+protected:
+    struct CacheEntry {
+        String uri;           // request uri, empty if the entry is unused
+        String path;          // file on _fs, with ".gz" if the compressed variant is served
+        size_t size;
+        time_t lastWrite;
+        mime::type mime;      // type of the uncompressed file
+        bool gz;
+        unsigned long validated;
+        uint32_t used;
+    };
+
+    static mime::type _mimeType(const String& path) {
+        // Check all entries but last one for match, return if found
+        for (size_t i=0; i < sizeof(mimeTable)/sizeof(mimeTable[0])-1; i++) {
+            if (path.endsWith(mimeTable[i].endsWith))
+                return (mime::type)i;
+        }
+        // Fall-through and just return default type
+        return none;
+    }
+
+    CacheEntry* _cached(const String& requestUri) {
+        for (CacheEntry& entry : _cache) {
+            if (entry.uri.length() && entry.uri == requestUri) {
+                if (millis() - entry.validated >= HTTP_STATIC_CACHE_TTL)
+                    return nullptr;
+                entry.used = ++_cacheClock;
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    // looks up the file for requestUri and stores its metadata in the least recently used entry
+    CacheEntry* _resolve(const String& requestUri, File& f) {
+        String path(_path);
+        if (!_isFile) {
             // Append whatever follows this URI in request to get the file path.
             path += requestUri.substring(_baseUriLength);
         }
         log_v("StaticRequestHandler::handle: path=%s, isFile=%d\r\n", path.c_str(), _isFile);
 
-        String contentType = getContentType(path);
+        mime::type type = _mimeType(path);
 
         // look for gz file, only if the original specified path is not a gz.  So part only works to send gzip via content encoding when a non compressed is asked for
         // if you point the the path to gzip you will serve the gzip as content type "application/x-gzip", not text or javascript etc...
         if (!path.endsWith(FPSTR(mimeTable[gz].endsWith)) && !_fs.exists(path))  {
             String pathWithGz = path + FPSTR(mimeTable[gz].endsWith);
             if(_fs.exists(pathWithGz))
-                path += FPSTR(mimeTable[gz].endsWith);
+                path = pathWithGz;
         }
 
-        File f = _fs.open(path, "r");
-        if (!f || !f.available())
-            return false;
+        f = _fs.open(path, "r");
+        if (!f || f.isDirectory())
+            return nullptr;
+
+        CacheEntry* entry = nullptr;
+        for (CacheEntry& e : _cache) {
+            if (e.uri == requestUri) {
+                entry = &e;
+                break;
+            }
+        }
+        if (!entry) {
+            if (_cache.size() < HTTP_STATIC_CACHE_ENTRIES) {
+                _cache.emplace_back();
+                entry = &_cache.back();
+            } else {
+                entry = &_cache[0];
+                for (CacheEntry& e : _cache) {
+                    if (e.used < entry->used)
+                        entry = &e;
+                }
+            }
+        }
+        entry->uri = requestUri;
+        entry->path = path;
+        entry->size = f.size();
+        entry->lastWrite = f.getLastWrite();
+        entry->mime = type;
+        entry->gz = path.endsWith(FPSTR(mimeTable[gz].endsWith));
+        entry->validated = millis();
+        entry->used = ++_cacheClock;
+        return entry;
+    }
+
+    static void _formatETag(const CacheEntry& entry, char* etag, size_t size) {
+        etag[0] = '\0';
+        if (entry.lastWrite) {
+            snprintf(etag, size, "\"%lx-%x\"", (unsigned long)entry.lastWrite, (unsigned)entry.size);
+        }
+    }
 
+    void _sendHeaders(WebServer& server, const CacheEntry& entry, const char* etag) {
         if (_cache_header.length() != 0)
             server.sendHeader("Cache-Control", _cache_header);
+        if (etag[0])
+            server.sendHeader("ETag", etag);
+        server.sendHeader("Accept-Ranges", "bytes");
+        if (entry.gz && entry.mime != gz && entry.mime != none)
+            server.sendHeader("Content-Encoding", "gzip");
+    }
 
-        server.streamFile(f, contentType);
-        return true;
+    // parses a single "bytes=first-last" range, returns 1 for a valid range,
+    // 0 if the header is ignored and -1 if the range can not be satisfied
+    static int _parseRange(const char* range, size_t size, size_t& start, size_t& end) {
+        if (strncmp(range, "bytes=", 6) != 0 || strchr(range, ','))
+            return 0;
+        range += 6;
+        char* next;
+        if (*range == '-') {
+            // suffix range, the last N bytes
+            unsigned long suffix = strtoul(range + 1, &next, 10);
+            if (next == range + 1 || *next)
+                return 0;
+            if (!suffix || !size)
+                return -1;
+            start = suffix < size ? size - suffix : 0;
+            end = size - 1;
+            return 1;
+        }
+        unsigned long first = strtoul(range, &next, 10);
+        if (next == range || *next != '-')
+            return 0;
+        range = next + 1;
+        unsigned long last = size ? size - 1 : 0;
+        if (*range) {
+            last = strtoul(range, &next, 10);
+            if (*next)
+                return 0;
+        }
+        if (first >= size || last < first)
+            return -1;
+        start = first;
+        end = last < size ? last : size - 1;
+        return 1;
     }
 
-    static String getContentType(const String& path) {
-        char buff[sizeof(mimeTable[0].mimeType)];
-        // Check all entries but last one for match, return if found
-        for (size_t i=0; i < sizeof(mimeTable)/sizeof(mimeTable[0])-1; i++) {
-            strcpy_P(buff, mimeTable[i].endsWith);
-            if (path.endsWith(buff)) {
-                strcpy_P(buff, mimeTable[i].mimeType);
-                return String(buff);
+    // sends length bytes from the current position of f in large chunks
+    void _streamRange(WebServer& server, File& f, size_t length) {
+        uint8_t small[128];
+        uint8_t* buf = small;
+        size_t bufSize = sizeof(small);
+        if (!_chunk)
+            _chunk.reset(new (std::nothrow) uint8_t[HTTP_STATIC_CHUNK_SIZE]);
+        if (_chunk) {
+            buf = _chunk.get();
+            bufSize = HTTP_STATIC_CHUNK_SIZE;
+        }
+        while (length) {
+            size_t n = f.read(buf, length < bufSize ? length : bufSize);
+            if (!n) {
+                // shorter than the announced Content-Length, the connection can not be reused
+                server.client().stop();
+                break;
             }
+            server.sendContent((const char*)buf, n);
+            length -= n;
+            if (length && !server.client().connected())
+                break;
         }
-        // Fall-through and just return default type
-        strcpy_P(buff, mimeTable[sizeof(mimeTable)/sizeof(mimeTable[0])-1].mimeType);
-        return String(buff);
     }
 
-protected:
     FS _fs;
     String _uri;
     String _path;
     String _cache_header;
     bool _isFile;
     size_t _baseUriLength;
+    std::vector<CacheEntry> _cache;
+    uint32_t _cacheClock;
+    std::unique_ptr<uint8_t[]> _chunk;
 };
 
 
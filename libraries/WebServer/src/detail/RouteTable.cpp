@@ -0,0 +1,167 @@
+/*
+  RouteTable.cpp - Route lookup for WebServer request handlers.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <Arduino.h>
+#include "WebServer.h"
+#include "RouteTable.h"
+
+RouteTable::Node::~Node() {
+  for (Node* child : children) {
+    delete child;
+  }
+  delete param;
+}
+
+static int compareSegment(const String& segment, const char* s, size_t len) {
+  if (segment.length() != len) {
+    return segment.length() < len ? -1 : 1;
+  }
+  return memcmp(segment.c_str(), s, len);
+}
+
+// binary search for a literal child, pos is set to the insert position if not found
+RouteTable::Node* RouteTable::_child(const Node* node, const char* segment, size_t len, size_t& pos) {
+  size_t lo = 0;
+  size_t hi = node->children.size();
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    int cmp = compareSegment(node->children[mid]->segment, segment, len);
+    if (cmp == 0) {
+      pos = mid;
+      return node->children[mid];
+    }
+    if (cmp < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  pos = lo;
+  return nullptr;
+}
+
+void RouteTable::add(RequestHandler* handler) {
+  Route route = { handler, _count++, HTTP_ANY };
+  String pattern;
+  bool params = false;
+  if (!handler->routePattern(pattern, params, route.method)) {
+    _unrouted.push_back(route);
+    return;
+  }
+
+  Node* node = &_root;
+  const char* p = pattern.c_str();
+  for (;;) {
+    const char* end = strchr(p, '/');
+    size_t len = end ? (size_t)(end - p) : strlen(p);
+    if (params && len == 2 && p[0] == '{' && p[1] == '}') {
+      if (!node->param) {
+        node->param = new Node();
+      }
+      node = node->param;
+    } else {
+      size_t pos;
+      Node* child = _child(node, p, len, pos);
+      if (!child) {
+        child = new Node();
+        child->segment.concat(p, len);
+        node->children.insert(node->children.begin() + pos, child);
+      }
+      node = child;
+    }
+    if (!end) {
+      break;
+    }
+    p = end + 1;
+  }
+  node->routes.push_back(route);
+}
+
+// segment points to the next path segment of the request, or is NULL once all are matched.
+// Only routes registered at or after the order given by after are considered.
+void RouteTable::_match(const Node* node, HTTPMethod method, const char* segment, uint32_t after, const Route*& best) {
+  if (!segment) {
+    for (const Route& route : node->routes) {
+      if (route.order < after) {
+        continue;
+      }
+      if (best && best->order < route.order) {
+        break;
+      }
+      if (route.method == HTTP_ANY || route.method == method) {
+        best = &route;
+        break;
+      }
+    }
+    return;
+  }
+
+  const char* end = strchr(segment, '/');
+  size_t len = end ? (size_t)(end - segment) : strlen(segment);
+  const char* next = end ? end + 1 : nullptr;
+
+  size_t pos;
+  const Node* child = _child(node, segment, len, pos);
+  if (child) {
+    _match(child, method, next, after, best);
+  }
+  if (node->param) {
+    _match(node->param, method, next, after, best);
+  }
+}
+
+RequestHandler* RouteTable::find(HTTPMethod method, const String& uri) {
+  uint32_t after = 0;
+  size_t unrouted = 0;
+  for (;;) {
+    const Route* best = nullptr;
+    _match(&_root, method, uri.c_str(), after, best);
+
+    // handlers that can not be indexed win if they were registered first
+    for (; unrouted < _unrouted.size(); unrouted++) {
+      const Route& route = _unrouted[unrouted];
+      if (best && best->order < route.order) {
+        break;
+      }
+      if (route.handler->canHandle(method, uri)) {
+        return route.handler;
+      }
+    }
+    if (!best) {
+      return nullptr;
+    }
+    // sets the path arguments of the handler
+    if (best->handler->canHandle(method, uri)) {
+      return best->handler;
+    }
+    // declined, try what was registered after it
+    after = best->order + 1;
+  }
+}
+
+void RouteTable::clear() {
+  for (Node* child : _root.children) {
+    delete child;
+  }
+  _root.children.clear();
+  delete _root.param;
+  _root.param = nullptr;
+  _root.routes.clear();
+  _unrouted.clear();
+  _count = 0;
+}
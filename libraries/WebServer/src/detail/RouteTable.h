@@ -0,0 +1,65 @@
+/*
+  RouteTable.h - Route lookup for WebServer request handlers.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ROUTETABLE_H
+#define ROUTETABLE_H
+
+#include <vector>
+#include <WString.h>
+#include "HTTP_Method.h"
+
+class RequestHandler;
+
+// Finds the first registered handler for a request without asking every handler.
+// Handlers that describe their uri with routePattern() are stored in a trie of path
+// segments, built when they are added. All others are kept in a list and asked with
+// canHandle(), but only those registered before the best match of the trie. If that
+// match declines the request, the search goes on with the handlers registered after it.
+class RouteTable {
+public:
+  RouteTable() : _count(0) {}
+  ~RouteTable() { clear(); }
+
+  void add(RequestHandler* handler);
+  RequestHandler* find(HTTPMethod method, const String& uri);
+  void clear();
+
+protected:
+  struct Route {
+    RequestHandler* handler;
+    uint32_t order;
+    HTTPMethod method;
+  };
+
+  struct Node {
+    String segment;
+    std::vector<Node*> children;  // literal segments, sorted
+    Node* param = nullptr;        // "{}" segment
+    std::vector<Route> routes;    // handlers ending here, in registration order
+    ~Node();
+  };
+
+  static Node* _child(const Node* node, const char* segment, size_t len, size_t& pos);
+  static void _match(const Node* node, HTTPMethod method, const char* segment, uint32_t after, const Route*& best);
+
+  Node _root;
+  std::vector<Route> _unrouted;
+  uint32_t _count;
+};
+
+#endif //ROUTETABLE_H
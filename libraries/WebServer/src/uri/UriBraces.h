@@ -25,6 +25,19 @@ class UriBraces : public Uri {
             pathArgs.resize(numParams);
         }
 
+        bool routePattern(String &pattern, bool &params) const override final {
+            // only braces spanning a whole path segment can be indexed
+            for (int i = _uri.indexOf('{'); i != -1; i = _uri.indexOf('{', i + 1)) {
+                if (i == 0 || _uri[i - 1] != '/' || _uri[i + 1] != '}')
+                    return false;
+                if (_uri[i + 2] != '/' && _uri[i + 2] != '\0')
+                    return false;
+            }
+            pattern = _uri;
+            params = true;
+            return true;
+        }
+
         bool canHandle(const String &requestUri, std::vector<String> &pathArgs) override final {
             if (Uri::canHandle(requestUri, pathArgs))
                 return true;
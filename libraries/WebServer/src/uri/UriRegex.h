@@ -22,6 +22,10 @@ class UriRegex : public Uri {
             pathArgs.resize(matches.size() - 1);
         }
 
+        bool routePattern(__attribute__((unused)) String &pattern, __attribute__((unused)) bool &params) const override final {
+            return false;
+        }
+
         bool canHandle(const String &requestUri, std::vector<String> &pathArgs) override final {
             if (Uri::canHandle(requestUri, pathArgs))
                 return true;
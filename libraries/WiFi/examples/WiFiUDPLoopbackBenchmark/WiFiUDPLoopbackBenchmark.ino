@@ -0,0 +1,74 @@
+/*
+ *  Measures how fast WiFiUDP receives packets, with parsePacket() and read()
+ *  against recvBatch(). The packets are sent to the soft AP address of the
+ *  same device, so no other station is needed. Bursts are kept below the
+ *  lwIP receive mailbox size (CONFIG_LWIP_UDP_RECVMBOX_SIZE) so none are
+ *  dropped. Only the time spent in calls that return packets is counted.
+ */
+#include <WiFi.h>
+#include <WiFiUdp.h>
+
+#define PORT    3333
+#define BURST   4
+#define BURSTS  500
+
+WiFiUDP sender;
+WiFiUDP receiver;
+uint8_t packet[1400];
+
+void sendBurst(size_t size){
+  for(int i = 0; i < BURST; i++){
+    sender.beginPacket(WiFi.softAPIP(), PORT);
+    sender.write(packet, size);
+    sender.endPacket();
+  }
+}
+
+void run(size_t size, bool batch){
+  uint32_t busy = 0;
+  uint32_t received = 0;
+  size_t bytes = 0;
+  for(int b = 0; b < BURSTS; b++){
+    sendBurst(size);
+    int pending = BURST;
+    uint32_t start = millis();
+    while(pending && millis() - start < 100){
+      uint32_t t = micros();
+      int n = 0;
+      if(batch){
+        n = receiver.recvBatch([&bytes](const uint8_t *data, size_t len, IPAddress ip, uint16_t port){
+          bytes += len;
+        }, pending);
+      } else if(receiver.parsePacket()){
+        bytes += receiver.read(packet, sizeof(packet));
+        n = 1;
+      }
+      if(n){
+        busy += micros() - t;
+        pending -= n;
+        received += n;
+      } else {
+        delay(0);
+      }
+    }
+  }
+  Serial.printf("%4u bytes, %-13s %5u of %u packets, %5.2f us/packet, %6u packets/s\n", size, batch ? "recvBatch:" : "parsePacket:",
+                received, BURST * BURSTS, received ? (float)busy / received : 0, busy ? (uint32_t)((uint64_t)received * 1000000 / busy) : 0);
+}
+
+void setup(){
+  Serial.begin(115200);
+  WiFi.softAP("udp-benchmark");
+  receiver.begin(PORT);
+  sender.begin(PORT + 1);
+  memset(packet, 0x55, sizeof(packet));
+
+  size_t sizes[] = {32, 512, 1400};
+  for(int i = 0; i < 3; i++){
+    run(sizes[i], false);
+    run(sizes[i], true);
+  }
+}
+
+void loop(){
+}
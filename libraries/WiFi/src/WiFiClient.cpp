@@ -153,6 +153,22 @@ public:
     size_t available(){
         return _fill - _pos + r_available();
     }
+
+    size_t peekAvailable(){
+        if(_pos == _fill && !fillBuffer()){
+            return 0;
+        }
+        return _fill - _pos;
+    }
+
+    const char * peekBuffer(){
+        return (const char *)_buffer + _pos;
+    }
+
+    void peekConsume(size_t len){
+        size_t a = _fill - _pos;
+        _pos += (len > a) ? a : len;
+    }
 };
 
 class WiFiClientSocketHandle {
@@ -498,6 +514,40 @@ int WiFiClient::available()
     return res;
 }
 
+bool WiFiClient::hasPeekBufferAPI() const
+{
+    return true;
+}
+
+size_t WiFiClient::peekAvailable()
+{
+    if(!_rxBuffer) {
+        return 0;
+    }
+    size_t res = _rxBuffer->peekAvailable();
+    if(_rxBuffer->failed()) {
+        log_e("fail on fd %d, errno: %d, \"%s\"", fd(), errno, strerror(errno));
+        stop();
+        return 0;
+    }
+    return res;
+}
+
+const char * WiFiClient::peekBuffer()
+{
+    if(!_rxBuffer) {
+        return NULL;
+    }
+    return _rxBuffer->peekBuffer();
+}
+
+void WiFiClient::peekConsume(size_t size)
+{
+    if(_rxBuffer) {
+        _rxBuffer->peekConsume(size);
+    }
+}
+
 // Though flushing means to send all pending data,
 // seems that in Arduino it also means to clear RX
 void WiFiClient::flush() {
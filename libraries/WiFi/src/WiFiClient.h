@@ -65,6 +65,11 @@ public:
     void stop();
     uint8_t connected();
 
+    bool hasPeekBufferAPI() const override;
+    size_t peekAvailable() override;
+    const char *peekBuffer() override;
+    void peekConsume(size_t size) override;
+
     operator bool()
     {
         return connected();
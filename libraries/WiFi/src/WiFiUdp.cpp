@@ -18,7 +18,6 @@
 */
 
 #include "WiFiUdp.h"
-#include <new>  //std::nothrow
 #include <lwip/sockets.h>
 #include <lwip/netdb.h>
 #include <errno.h>
@@ -33,6 +32,9 @@ WiFiUDP::WiFiUDP()
 , tx_buffer(0)
 , tx_buffer_len(0)
 , rx_buffer(0)
+, rx_buffer_size(WIFI_UDP_RX_BUFFER_SIZE)
+, rx_pos(0)
+, rx_len(0)
 {}
 
 WiFiUDP::~WiFiUDP(){
@@ -105,10 +107,10 @@ void WiFiUDP::stop(){
   }
   tx_buffer_len = 0;
   if(rx_buffer){
-    cbuf *b = rx_buffer;
+    free(rx_buffer);
     rx_buffer = NULL;
-    delete b;
   }
+  rx_pos = rx_len = 0;
   if(udp_server == -1)
     return;
   if(multicast_ip != 0){
@@ -204,47 +206,69 @@ size_t WiFiUDP::write(const uint8_t *buffer, size_t size){
   return i;
 }
 
-int WiFiUDP::parsePacket(){
-  if(rx_buffer)
-    return 0;
-  struct sockaddr_in si_other;
-  int slen = sizeof(si_other) , len;
-  char *buf = (char *)malloc(1460);
-  if(!buf) {
-    return 0;
+int WiFiUDP::_recv(){
+  if(!rx_buffer){
+    rx_buffer = (uint8_t *)malloc(rx_buffer_size);
+    if(!rx_buffer){
+      log_e("could not create rx buffer: %d", errno);
+      return -1;
+    }
   }
-  if ((len = recvfrom(udp_server, buf, 1460, MSG_DONTWAIT, (struct sockaddr *) &si_other, (socklen_t *)&slen)) == -1){
-    free(buf);
-    if(errno == EWOULDBLOCK){
-      return 0;
+  rx_pos = rx_len = 0;
+  struct sockaddr_in si_other;
+  socklen_t slen = sizeof(si_other);
+  int len = recvfrom(udp_server, rx_buffer, rx_buffer_size, MSG_DONTWAIT, (struct sockaddr *) &si_other, &slen);
+  if(len == -1){
+    if(errno != EWOULDBLOCK){
+      log_e("could not receive data: %d", errno);
     }
-    log_e("could not receive data: %d", errno);
-    return 0;
+    return -1;
   }
   remote_ip = IPAddress(si_other.sin_addr.s_addr);
   remote_port = ntohs(si_other.sin_port);
-  if (len > 0) {
-    rx_buffer = new(std::nothrow) cbuf(len);
-    rx_buffer->write(buf, len);
-  }
-  free(buf);
+  rx_len = len;
   return len;
 }
 
+int WiFiUDP::parsePacket(){
+  if(rx_pos < rx_len)
+    return 0;
+  int len = _recv();
+  return (len > 0) ? len : 0;
+}
+
+int WiFiUDP::recvBatch(PacketHandler handler, int max){
+  int count = 0;
+  while(count < max){
+    int len = _recv();
+    if(len < 0){
+      break;
+    }
+    count++;
+    if(handler){
+      handler(rx_buffer, len, remote_ip, remote_port);
+    }
+    rx_len = 0;
+  }
+  return count;
+}
+
+void WiFiUDP::setRxBufferSize(size_t size){
+  if(rx_buffer){
+    free(rx_buffer);
+    rx_buffer = NULL;
+  }
+  rx_pos = rx_len = 0;
+  rx_buffer_size = size;
+}
+
 int WiFiUDP::available(){
-  if(!rx_buffer) return 0;
-  return rx_buffer->available();
+  return rx_len - rx_pos;
 }
 
 int WiFiUDP::read(){
-  if(!rx_buffer) return -1;
-  int out = rx_buffer->read();
-  if(!rx_buffer->available()){
-    cbuf *b = rx_buffer;
-    rx_buffer = 0;
-    delete b;
-  }
-  return out;
+  if(rx_pos == rx_len) return -1;
+  return rx_buffer[rx_pos++];
 }
 
 int WiFiUDP::read(unsigned char* buffer, size_t len){
@@ -252,26 +276,23 @@ int WiFiUDP::read(unsigned char* buffer, size_t len){
 }
 
 int WiFiUDP::read(char* buffer, size_t len){
-  if(!rx_buffer) return 0;
-  int out = rx_buffer->read(buffer, len);
-  if(!rx_buffer->available()){
-    cbuf *b = rx_buffer;
-    rx_buffer = 0;
-    delete b;
+  size_t n = rx_len - rx_pos;
+  if(n > len){
+    n = len;
   }
-  return out;
+  if(!n) return 0;
+  memcpy(buffer, rx_buffer + rx_pos, n);
+  rx_pos += n;
+  return n;
 }
 
 int WiFiUDP::peek(){
-  if(!rx_buffer) return -1;
-  return rx_buffer->peek();
+  if(rx_pos == rx_len) return -1;
+  return rx_buffer[rx_pos];
 }
 
 void WiFiUDP::flush(){
-  if(!rx_buffer) return;
-  cbuf *b = rx_buffer;
-  rx_buffer = 0;
-  delete b;
+  rx_pos = rx_len = 0;
 }
 
 IPAddress WiFiUDP::remoteIP(){
@@ -37,9 +37,16 @@
 
 #include <Arduino.h>
 #include <Udp.h>
-#include <cbuf.h>
+#include <functional>
+
+#ifndef WIFI_UDP_RX_BUFFER_SIZE
+#define WIFI_UDP_RX_BUFFER_SIZE 1460
+#endif
 
 class WiFiUDP : public UDP {
+public:
+  typedef std::function<void(const uint8_t *data, size_t len, IPAddress ip, uint16_t port)> PacketHandler;
+
 private:
   int udp_server;
   IPAddress multicast_ip;
@@ -48,7 +55,13 @@ private:
   uint16_t remote_port;
   char * tx_buffer;
   size_t tx_buffer_len;
-  cbuf * rx_buffer;
+  uint8_t * rx_buffer;      // allocated once, packets are received straight into it
+  size_t rx_buffer_size;
+  size_t rx_pos;
+  size_t rx_len;
+
+  int _recv();
+
 public:
   WiFiUDP();
   ~WiFiUDP();
@@ -64,6 +77,11 @@ public:
   size_t write(uint8_t);
   size_t write(const uint8_t *buffer, size_t size);
   int parsePacket();
+  // receives up to max queued packets without waiting and hands each to handler,
+  // returns the number of packets. Unread data left from parsePacket() is dropped.
+  int recvBatch(PacketHandler handler, int max = 16);
+  // larger packets are truncated, drops a pending packet (default WIFI_UDP_RX_BUFFER_SIZE)
+  void setRxBufferSize(size_t size);
   int available();
   int read();
   int read(unsigned char* buffer, size_t len);
@@ -38,6 +38,7 @@ WiFiClientSecure::WiFiClientSecure()
     ssl_init(sslclient);
     sslclient->socket = -1;
     sslclient->handshake_timeout = 120000;
+    sslclient->session_resume = true;
     _use_insecure = false;
     _CA_cert = NULL;
     _cert = NULL;
@@ -59,6 +60,7 @@ WiFiClientSecure::WiFiClientSecure(int sock)
     ssl_init(sslclient);
     sslclient->socket = sock;
     sslclient->handshake_timeout = 120000;
+    sslclient->session_resume = true;
 
     if (sock >= 0) {
         _connected = true;
@@ -93,8 +95,8 @@ void WiFiClientSecure::stop()
         close(sslclient->socket);
         sslclient->socket = -1;
         _connected = false;
-        _peek = -1;
     }
+    _freeBuffer();
     stop_ssl_socket(sslclient, _CA_cert, _cert, _private_key);
 }
 
@@ -172,11 +174,10 @@ int WiFiClientSecure::connect(const char *host, uint16_t port, const char *pskId
 }
 
 int WiFiClientSecure::peek(){
-    if(_peek >= 0){
-        return _peek;
+    if(!timedPeekAvailable()){
+        return -1;
     }
-    _peek = timedRead();
-    return _peek;
+    return _rxBuf[_rxPos];
 }
 
 size_t WiFiClientSecure::write(uint8_t data)
@@ -186,6 +187,9 @@ size_t WiFiClientSecure::write(uint8_t data)
 
 int WiFiClientSecure::read()
 {
+    if(_rxPos < _rxFill){
+        return _rxBuf[_rxPos++];
+    }
     uint8_t data = -1;
     int res = read(&data, 1);
     if (res < 0) {
@@ -209,46 +213,101 @@ size_t WiFiClientSecure::write(const uint8_t *buf, size_t size)
 
 int WiFiClientSecure::read(uint8_t *buf, size_t size)
 {
-    int peeked = 0;
-    int avail = available();
-    if ((!buf && size) || avail <= 0) {
+    if ((!buf && size) || available() <= 0) {
         return -1;
     }
     if(!size){
         return 0;
     }
-    if(_peek >= 0){
-        buf[0] = _peek;
-        _peek = -1;
-        size--;
-        avail--;
-        if(!size || !avail){
-            return 1;
+    if(_rxPos == _rxFill){
+        if(size >= WIFI_CLIENT_SECURE_RX_BUFFER_SIZE){
+            // large reads go straight to the caller
+            int res = get_ssl_receive(sslclient, buf, size);
+            if (res < 0) {
+                stop();
+            }
+            return res;
+        }
+        if(!_fillBuffer()){
+            return -1;
         }
-        buf++;
-        peeked = 1;
     }
-    
-    int res = get_ssl_receive(sslclient, buf, size);
-    if (res < 0) {
-        stop();
-        return peeked?peeked:res;
+    size_t len = _rxFill - _rxPos;
+    if(len > size){
+        len = size;
     }
-    return res + peeked;
+    memcpy(buf, _rxBuf + _rxPos, len);
+    _rxPos += len;
+    return len;
 }
 
 int WiFiClientSecure::available()
 {
-    int peeked = (_peek >= 0);
+    size_t buffered = _rxFill - _rxPos;
     if (!_connected) {
-        return peeked;
+        return buffered;
+    }
+    if (buffered) {
+        // no need to poll the socket while there is data
+        return buffered + mbedtls_ssl_get_bytes_avail(&sslclient->ssl_ctx);
     }
     int res = data_to_read(sslclient);
     if (res < 0) {
         stop();
-        return peeked?peeked:res;
     }
-    return res+peeked;
+    return res;
+}
+
+// moves decrypted data from mbedtls into the buffer, only called with an empty buffer, never blocks
+size_t WiFiClientSecure::_fillBuffer()
+{
+    _rxPos = 0;
+    _rxFill = 0;
+    if (available() <= 0) {
+        return 0;
+    }
+    if (!_rxBuf) {
+        _rxBuf = (uint8_t *)malloc(WIFI_CLIENT_SECURE_RX_BUFFER_SIZE);
+        if (!_rxBuf) {
+            log_e("Not enough memory to allocate buffer");
+            return 0;
+        }
+    }
+    // the record is decrypted already, this does not wait for the socket
+    int res = get_ssl_receive(sslclient, _rxBuf, WIFI_CLIENT_SECURE_RX_BUFFER_SIZE);
+    if (res < 0) {
+        stop();
+        return 0;
+    }
+    _rxFill = res;
+    return res;
+}
+
+void WiFiClientSecure::_freeBuffer()
+{
+    free(_rxBuf);
+    _rxBuf = NULL;
+    _rxPos = 0;
+    _rxFill = 0;
+}
+
+size_t WiFiClientSecure::peekAvailable()
+{
+    if (_rxPos == _rxFill) {
+        _fillBuffer();
+    }
+    return _rxFill - _rxPos;
+}
+
+const char *WiFiClientSecure::peekBuffer()
+{
+    return (const char *)_rxBuf + _rxPos;
+}
+
+void WiFiClientSecure::peekConsume(size_t size)
+{
+    size_t buffered = _rxFill - _rxPos;
+    _rxPos += (size > buffered) ? buffered : size;
 }
 
 uint8_t WiFiClientSecure::connected()
@@ -374,6 +433,17 @@ void WiFiClientSecure::setAlpnProtocols(const char **alpn_protos)
 {
     _alpn_protos = alpn_protos;
 }
+
+void WiFiClientSecure::setSessionResumption(bool enable)
+{
+    sslclient->session_resume = enable;
+}
+
+void WiFiClientSecure::clearCache()
+{
+    ssl_clear_cache();
+}
+
 int WiFiClientSecure::setTimeout(uint32_t seconds)
 {
     _timeout = seconds * 1000;
@@ -25,14 +25,20 @@
 #include <WiFi.h>
 #include "ssl_client.h"
 
+#ifndef WIFI_CLIENT_SECURE_RX_BUFFER_SIZE
+#define WIFI_CLIENT_SECURE_RX_BUFFER_SIZE   1024
+#endif
+
 class WiFiClientSecure : public WiFiClient
 {
 protected:
     sslclient_context *sslclient;
  
     int _lastError = 0;
-    int _peek = -1;
     int _timeout;
+    uint8_t *_rxBuf = NULL;     // decrypted data, read() and the parsers are served from here
+    size_t _rxPos = 0;
+    size_t _rxFill = 0;
     bool _use_insecure;
     const char *_CA_cert;
     const char *_cert;
@@ -65,6 +71,10 @@ public:
     void flush() {}
     void stop();
     uint8_t connected();
+    bool hasPeekBufferAPI() const override { return true; }
+    size_t peekAvailable() override;
+    const char *peekBuffer() override;
+    void peekConsume(size_t size) override;
     int lastError(char *buf, const size_t size);
     void setInsecure(); // Don't validate the chain, just accept whatever is given.  VERY INSECURE!
     void setPreSharedKey(const char *pskIdent, const char *psKey); // psKey in Hex
@@ -78,6 +88,8 @@ public:
     bool verify(const char* fingerprint, const char* domain_name);
     void setHandshakeTimeout(unsigned long handshake_timeout);
     void setAlpnProtocols(const char **alpn_protos);
+    void setSessionResumption(bool enable); // resume the last session with the same host, port and credentials (default on)
+    static void clearCache(); // drops saved sessions and parsed certificates no connection uses
     const mbedtls_x509_crt* getPeerCertificate() { return mbedtls_ssl_get_peer_cert(&sslclient->ssl_ctx); };
     bool getFingerprintSHA256(uint8_t sha256_result[32]) { return get_peer_fingerprint(sslclient, sha256_result); };
     int setTimeout(uint32_t seconds);
@@ -109,6 +121,8 @@ public:
 
 private:
     char *_streamLoad(Stream& stream, size_t size);
+    size_t _fillBuffer();
+    void _freeBuffer();
 
     //friend class WiFiServer;
     using Print::write;
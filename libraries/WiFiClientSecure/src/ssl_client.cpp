@@ -43,6 +43,306 @@ static int _handle_error(int err, const char * function, int line)
 
 #define handle_error(e) _handle_error(e, __FUNCTION__, __LINE__)
 
+/*
+ * Process wide caches
+ *
+ * Parsed CA and client certificates are shared by all connections using the
+ * same PEM data, so a reconnect does not parse them again. Private keys are not
+ * shared: without MBEDTLS_THREADING_C concurrent RSA signatures with one key
+ * race on its blinding values.
+ * Sessions are kept per host, port and credentials, so a reconnect can resume
+ * the previous session instead of running a full handshake.
+ * */
+
+#ifndef SSL_CLIENT_SESSION_CACHE_SIZE
+#define SSL_CLIENT_SESSION_CACHE_SIZE   4
+#endif
+
+// parsed credentials kept while no connection uses them
+#ifndef SSL_CLIENT_CRED_CACHE_SIZE
+#define SSL_CLIENT_CRED_CACHE_SIZE      4
+#endif
+
+typedef struct ssl_cached_cred {
+    uint8_t hash[32];           // SHA-256 of the PEM data
+    mbedtls_x509_crt crt;
+    int refs;
+    unsigned long used;
+    struct ssl_cached_cred *next;
+} ssl_cached_cred;
+
+typedef struct {
+    uint8_t id[32];             // SHA-256 of host, port and credentials
+    bool valid;
+    unsigned long used;
+    mbedtls_ssl_session session;
+} ssl_cached_session;
+
+static SemaphoreHandle_t _cache_lock = NULL;
+static portMUX_TYPE _cache_lock_mux = portMUX_INITIALIZER_UNLOCKED;
+static ssl_cached_cred *_creds = NULL;
+static ssl_cached_session _sessions[SSL_CLIENT_SESSION_CACHE_SIZE];
+
+// one random generator for all connections, seeding it on every connect is slow
+static mbedtls_entropy_context _entropy;
+static mbedtls_ctr_drbg_context _drbg;
+static bool _drbg_seeded = false;
+
+static void _cache_take()
+{
+    if (_cache_lock == NULL) {
+        // the mutex can not be created inside the critical section, a task losing the race deletes its own
+        SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+        portENTER_CRITICAL(&_cache_lock_mux);
+        if (_cache_lock == NULL) {
+            _cache_lock = lock;
+            lock = NULL;
+        }
+        portEXIT_CRITICAL(&_cache_lock_mux);
+        if (lock != NULL) {
+            vSemaphoreDelete(lock);
+        }
+    }
+    xSemaphoreTake(_cache_lock, portMAX_DELAY);
+}
+
+static void _cache_give()
+{
+    xSemaphoreGive(_cache_lock);
+}
+
+static void _sha256(mbedtls_sha256_context *ctx, const void *data, size_t len)
+{
+    mbedtls_sha256_update(ctx, (const unsigned char *)data, len);
+}
+
+static void _cred_free(ssl_cached_cred *cred)
+{
+    mbedtls_x509_crt_free(&cred->crt);
+    free(cred);
+}
+
+// frees the least recently used credentials no connection holds, beyond keep of them
+static void _cred_trim(int keep)
+{
+    while (true) {
+        int unused = 0;
+        ssl_cached_cred **oldest = NULL;
+        for (ssl_cached_cred **c = &_creds; *c; c = &(*c)->next) {
+            if ((*c)->refs) {
+                continue;
+            }
+            unused++;
+            if (!oldest || (long)((*c)->used - (*oldest)->used) < 0) {
+                oldest = c;
+            }
+        }
+        if (unused <= keep) {
+            return;
+        }
+        ssl_cached_cred *cred = *oldest;
+        *oldest = cred->next;
+        _cred_free(cred);
+    }
+}
+
+static void _pem_hash(const char *pem, uint8_t hash[32])
+{
+    mbedtls_sha256_context sha256_ctx;
+    mbedtls_sha256_init(&sha256_ctx);
+    mbedtls_sha256_starts(&sha256_ctx, false);
+    _sha256(&sha256_ctx, pem, strlen(pem) + 1);
+    mbedtls_sha256_finish(&sha256_ctx, hash);
+    mbedtls_sha256_free(&sha256_ctx);
+}
+
+static ssl_cached_cred *_cred_get(const char *pem, int *err)
+{
+    size_t len = strlen(pem) + 1;
+    uint8_t hash[32];
+    _pem_hash(pem, hash);
+
+    _cache_take();
+    for (ssl_cached_cred *c = _creds; c; c = c->next) {
+        if (!memcmp(c->hash, hash, sizeof(hash))) {
+            c->refs++;
+            c->used = millis();
+            _cache_give();
+            return c;
+        }
+    }
+    _cache_give();
+
+    // parse outside of the lock, this is the slow part
+    ssl_cached_cred *cred = (ssl_cached_cred *)calloc(1, sizeof(ssl_cached_cred));
+    if (!cred) {
+        *err = MBEDTLS_ERR_SSL_ALLOC_FAILED;
+        return NULL;
+    }
+    mbedtls_x509_crt_init(&cred->crt);
+    int ret = mbedtls_x509_crt_parse(&cred->crt, (const unsigned char *)pem, len);
+    if (ret < 0) {
+        _cred_free(cred);
+        *err = ret;
+        return NULL;
+    }
+    memcpy(cred->hash, hash, sizeof(hash));
+    cred->refs = 1;
+    cred->used = millis();
+
+    _cache_take();
+    cred->next = _creds;
+    _creds = cred;
+    _cache_give();
+    return cred;
+}
+
+static void _cred_put(ssl_cached_cred *cred)
+{
+    if (!cred) {
+        return;
+    }
+    _cache_take();
+    cred->refs--;
+    cred->used = millis();
+    _cred_trim(SSL_CLIENT_CRED_CACHE_SIZE);
+    _cache_give();
+}
+
+static void _session_id(uint8_t id[32], sslclient_context *ssl_client, const char *host, uint32_t port, const char *pskIdent, const char *psKey, bool insecure, bool useRootCABundle)
+{
+    // a session only serves connections that would have verified the server the same way
+    uint8_t flags = (insecure ? 1 : 0) | (useRootCABundle ? 2 : 0);
+    mbedtls_sha256_context sha256_ctx;
+    mbedtls_sha256_init(&sha256_ctx);
+    mbedtls_sha256_starts(&sha256_ctx, false);
+    _sha256(&sha256_ctx, host, strlen(host) + 1);
+    _sha256(&sha256_ctx, &port, sizeof(port));
+    _sha256(&sha256_ctx, &flags, sizeof(flags));
+    ssl_cached_cred *creds[] = { ssl_client->ca_cred, ssl_client->cert_cred };
+    for (int i = 0; i < 2; i++) {
+        if (creds[i]) {
+            _sha256(&sha256_ctx, creds[i]->hash, sizeof(creds[i]->hash));
+        } else {
+            _sha256(&sha256_ctx, "", 1);
+        }
+    }
+    // the client key is loaded together with the client certificate
+    if (ssl_client->cert_cred) {
+        _sha256(&sha256_ctx, ssl_client->client_key_hash, sizeof(ssl_client->client_key_hash));
+    } else {
+        _sha256(&sha256_ctx, "", 1);
+    }
+    if (pskIdent != NULL && psKey != NULL) {
+        _sha256(&sha256_ctx, pskIdent, strlen(pskIdent) + 1);
+        _sha256(&sha256_ctx, psKey, strlen(psKey) + 1);
+    }
+    mbedtls_sha256_finish(&sha256_ctx, id);
+    mbedtls_sha256_free(&sha256_ctx);
+}
+
+static ssl_cached_session *_session_find(const uint8_t id[32])
+{
+    for (int i = 0; i < SSL_CLIENT_SESSION_CACHE_SIZE; i++) {
+        if (_sessions[i].valid && !memcmp(_sessions[i].id, id, sizeof(_sessions[i].id))) {
+            return &_sessions[i];
+        }
+    }
+    return NULL;
+}
+
+static void _session_load(sslclient_context *ssl_client, const uint8_t id[32])
+{
+    _cache_take();
+    ssl_cached_session *s = _session_find(id);
+    if (s) {
+        log_v("Resuming TLS session");
+        if (mbedtls_ssl_set_session(&ssl_client->ssl_ctx, &s->session) == 0) {
+            s->used = millis();
+        }
+    }
+    _cache_give();
+}
+
+static void _session_save(sslclient_context *ssl_client, const uint8_t id[32])
+{
+    _cache_take();
+    ssl_cached_session *s = _session_find(id);
+    if (!s) {
+        // free slot or the least recently used one
+        s = &_sessions[0];
+        for (int i = 0; i < SSL_CLIENT_SESSION_CACHE_SIZE && s->valid; i++) {
+            if (!_sessions[i].valid || (long)(_sessions[i].used - s->used) < 0) {
+                s = &_sessions[i];
+            }
+        }
+    }
+    if (s->valid) {
+        mbedtls_ssl_session_free(&s->session);
+    }
+    mbedtls_ssl_session_init(&s->session);
+    s->valid = mbedtls_ssl_get_session(&ssl_client->ssl_ctx, &s->session) == 0;
+    if (s->valid) {
+        memcpy(s->id, id, sizeof(s->id));
+        s->used = millis();
+    } else {
+        mbedtls_ssl_session_free(&s->session);
+    }
+    _cache_give();
+}
+
+static void _session_drop(const uint8_t id[32])
+{
+    _cache_take();
+    ssl_cached_session *s = _session_find(id);
+    if (s) {
+        mbedtls_ssl_session_free(&s->session);
+        s->valid = false;
+    }
+    _cache_give();
+}
+
+static int _drbg_seed()
+{
+    int ret = 0;
+    _cache_take();
+    if (!_drbg_seeded) {
+        mbedtls_entropy_init(&_entropy);
+        mbedtls_ctr_drbg_init(&_drbg);
+        ret = mbedtls_ctr_drbg_seed(&_drbg, mbedtls_entropy_func, &_entropy, (const unsigned char *) pers, strlen(pers));
+        if (ret == 0) {
+            _drbg_seeded = true;
+        } else {
+            mbedtls_ctr_drbg_free(&_drbg);
+            mbedtls_entropy_free(&_entropy);
+        }
+    }
+    _cache_give();
+    return ret;
+}
+
+// mbedtls only locks the generator with MBEDTLS_THREADING_C
+static int _drbg_random(void *p_rng, unsigned char *output, size_t output_len)
+{
+    _cache_take();
+    int ret = mbedtls_ctr_drbg_random(p_rng, output, output_len);
+    _cache_give();
+    return ret;
+}
+
+void ssl_clear_cache()
+{
+    _cache_take();
+    for (int i = 0; i < SSL_CLIENT_SESSION_CACHE_SIZE; i++) {
+        if (_sessions[i].valid) {
+            mbedtls_ssl_session_free(&_sessions[i].session);
+            _sessions[i].valid = false;
+        }
+    }
+    _cred_trim(0);
+    _cache_give();
+}
+
 
 void ssl_init(sslclient_context *ssl_client)
 {
@@ -50,7 +350,7 @@ void ssl_init(sslclient_context *ssl_client)
     memset(ssl_client, 0, sizeof(sslclient_context));
     mbedtls_ssl_init(&ssl_client->ssl_ctx);
     mbedtls_ssl_config_init(&ssl_client->ssl_conf);
-    mbedtls_ctr_drbg_init(&ssl_client->drbg_ctx);
+    mbedtls_pk_init(&ssl_client->client_key);
 }
 
 
@@ -144,10 +444,7 @@ int start_ssl_client(sslclient_context *ssl_client, const IPAddress& ip, uint32_
 
 
     log_v("Seeding the random number generator");
-    mbedtls_entropy_init(&ssl_client->entropy_ctx);
-
-    ret = mbedtls_ctr_drbg_seed(&ssl_client->drbg_ctx, mbedtls_entropy_func,
-                                &ssl_client->entropy_ctx, (const unsigned char *) pers, strlen(pers));
+    ret = _drbg_seed();
     if (ret < 0) {
         return handle_error(ret);
     }
@@ -176,16 +473,13 @@ int start_ssl_client(sslclient_context *ssl_client, const IPAddress& ip, uint32_
         log_d("WARNING: Skipping SSL Verification. INSECURE!");
     } else if (rootCABuff != NULL) {
         log_v("Loading CA cert");
-        mbedtls_x509_crt_init(&ssl_client->ca_cert);
         mbedtls_ssl_conf_authmode(&ssl_client->ssl_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
-        ret = mbedtls_x509_crt_parse(&ssl_client->ca_cert, (const unsigned char *)rootCABuff, strlen(rootCABuff) + 1);
-        mbedtls_ssl_conf_ca_chain(&ssl_client->ssl_conf, &ssl_client->ca_cert, NULL);
-        //mbedtls_ssl_conf_verify(&ssl_client->ssl_ctx, my_verify, NULL );
-        if (ret < 0) {
-            // free the ca_cert in the case parse failed, otherwise, the old ca_cert still in the heap memory, that lead to "out of memory" crash.
-            mbedtls_x509_crt_free(&ssl_client->ca_cert);
+        ssl_client->ca_cred = _cred_get(rootCABuff, &ret);
+        if (ssl_client->ca_cred == NULL) {
             return handle_error(ret);
         }
+        mbedtls_ssl_conf_ca_chain(&ssl_client->ssl_conf, &ssl_client->ca_cred->crt, NULL);
+        //mbedtls_ssl_conf_verify(&ssl_client->ssl_ctx, my_verify, NULL );
     } else if (useRootCABundle) {
         log_v("Attaching root CA cert bundle");
         ret = arduino_esp_crt_bundle_attach(&ssl_client->ssl_conf);
@@ -228,48 +522,51 @@ int start_ssl_client(sslclient_context *ssl_client, const IPAddress& ip, uint32_
     }
 
     if (!insecure && cli_cert != NULL && cli_key != NULL) {
-        mbedtls_x509_crt_init(&ssl_client->client_cert);
-        mbedtls_pk_init(&ssl_client->client_key);
-
         log_v("Loading CRT cert");
-
-        ret = mbedtls_x509_crt_parse(&ssl_client->client_cert, (const unsigned char *)cli_cert, strlen(cli_cert) + 1);
-        if (ret < 0) {
-        // free the client_cert in the case parse failed, otherwise, the old client_cert still in the heap memory, that lead to "out of memory" crash.
-        mbedtls_x509_crt_free(&ssl_client->client_cert);
+        ssl_client->cert_cred = _cred_get(cli_cert, &ret);
+        if (ssl_client->cert_cred == NULL) {
             return handle_error(ret);
         }
 
         log_v("Loading private key");
+        _pem_hash(cli_key, ssl_client->client_key_hash);
         ret = mbedtls_pk_parse_key(&ssl_client->client_key, (const unsigned char *)cli_key, strlen(cli_key) + 1, NULL, 0);
-
         if (ret != 0) {
-            mbedtls_x509_crt_free(&ssl_client->client_cert); // cert+key are free'd in pair
             return handle_error(ret);
         }
 
-        mbedtls_ssl_conf_own_cert(&ssl_client->ssl_conf, &ssl_client->client_cert, &ssl_client->client_key);
+        mbedtls_ssl_conf_own_cert(&ssl_client->ssl_conf, &ssl_client->cert_cred->crt, &ssl_client->client_key);
     }
 
     log_v("Setting hostname for TLS session...");
 
     // Hostname set here should match CN in server certificate
-    if((ret = mbedtls_ssl_set_hostname(&ssl_client->ssl_ctx, hostname != NULL ? hostname : ip.toString().c_str())) != 0){
+    String host = hostname != NULL ? String(hostname) : ip.toString();
+    if((ret = mbedtls_ssl_set_hostname(&ssl_client->ssl_ctx, host.c_str())) != 0){
         return handle_error(ret);
     }
 
-    mbedtls_ssl_conf_rng(&ssl_client->ssl_conf, mbedtls_ctr_drbg_random, &ssl_client->drbg_ctx);
+    mbedtls_ssl_conf_rng(&ssl_client->ssl_conf, _drbg_random, &_drbg);
 
     if ((ret = mbedtls_ssl_setup(&ssl_client->ssl_ctx, &ssl_client->ssl_conf)) != 0) {
         return handle_error(ret);
     }
 
+    uint8_t session_id[32];
+    if (ssl_client->session_resume) {
+        _session_id(session_id, ssl_client, host.c_str(), port, pskIdent, psKey, insecure, useRootCABundle);
+        _session_load(ssl_client, session_id);
+    }
+
     mbedtls_ssl_set_bio(&ssl_client->ssl_ctx, &ssl_client->socket, mbedtls_net_send, mbedtls_net_recv, NULL );
 
     log_v("Performing the SSL/TLS handshake...");
     unsigned long handshake_start_time=millis();
     while ((ret = mbedtls_ssl_handshake(&ssl_client->ssl_ctx)) != 0) {
         if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            if (ssl_client->session_resume) {
+                _session_drop(session_id);
+            }
             return handle_error(ret);
         }
         if((millis()-handshake_start_time)>ssl_client->handshake_timeout)
@@ -297,19 +594,11 @@ int start_ssl_client(sslclient_context *ssl_client, const IPAddress& ip, uint32_
     } else {
         log_v("Certificate verified.");
     }
-    
-    if (rootCABuff != NULL) {
-        mbedtls_x509_crt_free(&ssl_client->ca_cert);
-    }
 
-    if (cli_cert != NULL) {
-        mbedtls_x509_crt_free(&ssl_client->client_cert);
+    if (ssl_client->session_resume) {
+        _session_save(ssl_client, session_id);
     }
 
-    if (cli_key != NULL) {
-        mbedtls_pk_free(&ssl_client->client_key);
-    }    
-
     log_v("Free internal heap after TLS %u", ESP.getFreeHeap());
 
     return ssl_client->socket;
@@ -325,34 +614,36 @@ void stop_ssl_socket(sslclient_context *ssl_client, const char *rootCABuff, cons
         ssl_client->socket = -1;
     }
 
-    // avoid memory leak if ssl connection attempt failed
-    if (ssl_client->ssl_conf.ca_chain != NULL) {
-        mbedtls_x509_crt_free(&ssl_client->ca_cert);
-    }
-    if (ssl_client->ssl_conf.key_cert != NULL) {
-        mbedtls_x509_crt_free(&ssl_client->client_cert);
-        mbedtls_pk_free(&ssl_client->client_key);
-    }
     mbedtls_ssl_free(&ssl_client->ssl_ctx);
     mbedtls_ssl_config_free(&ssl_client->ssl_conf);
-    mbedtls_ctr_drbg_free(&ssl_client->drbg_ctx);
-    mbedtls_entropy_free(&ssl_client->entropy_ctx);
+
+    // the parsed certificates stay cached for the next connection
+    _cred_put(ssl_client->ca_cred);
+    _cred_put(ssl_client->cert_cred);
+    mbedtls_pk_free(&ssl_client->client_key);
     
     // save only interesting fields
     int handshake_timeout = ssl_client->handshake_timeout;
     int socket_timeout = ssl_client->socket_timeout;
+    bool session_resume = ssl_client->session_resume;
 
     // reset embedded pointers to zero
     memset(ssl_client, 0, sizeof(sslclient_context));
     
     ssl_client->handshake_timeout = handshake_timeout;
     ssl_client->socket_timeout = socket_timeout;
+    ssl_client->session_resume = session_resume;
 }
 
 
 int data_to_read(sslclient_context *ssl_client)
 {
     int ret, res;
+    res = mbedtls_ssl_get_bytes_avail(&ssl_client->ssl_ctx);
+    if (res > 0) {
+        // the current record is not read yet, no need to poll the socket
+        return res;
+    }
     ret = mbedtls_ssl_read(&ssl_client->ssl_ctx, NULL, 0);
     //log_e("RET: %i",ret);   //for low level debug
     res = mbedtls_ssl_get_bytes_avail(&ssl_client->ssl_ctx);
@@ -12,20 +12,23 @@
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/error.h"
 
+struct ssl_cached_cred;
+
 typedef struct sslclient_context {
     int socket;
     mbedtls_ssl_context ssl_ctx;
     mbedtls_ssl_config ssl_conf;
 
-    mbedtls_ctr_drbg_context drbg_ctx;
-    mbedtls_entropy_context entropy_ctx;
-
-    mbedtls_x509_crt ca_cert;
-    mbedtls_x509_crt client_cert;
+    // parsed certificates, shared between connections (see ssl_client.cpp)
+    struct ssl_cached_cred *ca_cred;
+    struct ssl_cached_cred *cert_cred;
+    // the private key is parsed per connection, signing updates its blinding values
     mbedtls_pk_context client_key;
+    uint8_t client_key_hash[32];
 
     unsigned long socket_timeout;
     unsigned long handshake_timeout;
+    bool session_resume;
 } sslclient_context;
 
 
@@ -38,4 +41,5 @@ int get_ssl_receive(sslclient_context *ssl_client, uint8_t *data, int length);
 bool verify_ssl_fingerprint(sslclient_context *ssl_client, const char* fp, const char* domain_name);
 bool verify_ssl_dn(sslclient_context *ssl_client, const char* domain_name);
 bool get_peer_fingerprint(sslclient_context *ssl_client, uint8_t sha256[32]);
+void ssl_clear_cache();
 #endif
@@ -0,0 +1,89 @@
+/* DNSServer test, the queries are sent to the soft AP address of the same device */
+#include <unity.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <DNSServer.h>
+
+DNSServer dnsServer;
+WiFiUDP client;
+IPAddress portalIP(192, 168, 4, 1);
+
+// sends a query for name and runs the server until the reply is received
+static int query(const char *name, uint16_t id, uint8_t *reply, size_t size){
+  uint8_t packet[64] = {(uint8_t)(id >> 8), (uint8_t)id, 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, 0};
+  size_t len = 12;
+  while(*name){
+    const char *dot = strchr(name, '.');
+    size_t label = dot ? (size_t)(dot - name) : strlen(name);
+    packet[len++] = label;
+    memcpy(packet + len, name, label);
+    len += label;
+    name += dot ? label + 1 : label;
+  }
+  packet[len++] = 0;
+  packet[len++] = 0;
+  packet[len++] = DNS_TYPE_A;
+  packet[len++] = 0;
+  packet[len++] = DNS_CLASS_IN;
+
+  client.beginPacket(WiFi.softAPIP(), 53);
+  client.write(packet, len);
+  client.endPacket();
+  unsigned long start = millis();
+  while(millis() - start < 1000){
+    dnsServer.processRequests();
+    if(client.parsePacket()){
+      return client.read(reply, size);
+    }
+    delay(1);
+  }
+  return 0;
+}
+
+void setUp(void){
+}
+
+void tearDown(void){
+}
+
+void answer_test(void){
+  uint8_t reply[128];
+  int len = query("www.Portal.LOCAL", 0x1234, reply, sizeof(reply));
+  // header, question (22 bytes) and one answer
+  TEST_ASSERT_EQUAL(12 + 22 + 16, len);
+  TEST_ASSERT_EQUAL_HEX8(0x12, reply[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x34, reply[1]);
+  TEST_ASSERT_EQUAL_HEX8(0x81, reply[2]);
+  TEST_ASSERT_EQUAL(1, reply[7]);
+  uint8_t answer[] = {0xC0, 0x0C, 0, DNS_TYPE_A, 0, DNS_CLASS_IN, 0, 0, 0, DNS_DEFAULT_TTL, 0, 4, 192, 168, 4, 1};
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(answer, reply + 34, sizeof(answer));
+}
+
+void other_domain_test(void){
+  uint8_t reply[128];
+  int len = query("captive.apple.com", 0x4321, reply, sizeof(reply));
+  TEST_ASSERT_EQUAL(12, len);
+  TEST_ASSERT_EQUAL_HEX8(0x43, reply[0]);
+  TEST_ASSERT_EQUAL((int)DNSReplyCode::NonExistentDomain, reply[3] & 0x0F);
+  TEST_ASSERT_EQUAL(0, reply[7]);
+}
+
+void setup(){
+  Serial.begin(115200);
+  while (!Serial) {
+    ;
+  }
+
+  WiFi.softAP("dns-server-test");
+  WiFi.softAPConfig(portalIP, portalIP, IPAddress(255, 255, 255, 0));
+  dnsServer.start(53, "portal.local", portalIP);
+  client.begin(5353);
+
+  UNITY_BEGIN();
+  RUN_TEST(answer_test);
+  RUN_TEST(other_domain_test);
+  UNITY_END();
+}
+
+void loop(){
+}
@@ -0,0 +1,25 @@
+// just enough of the core for building DNSServer on the host
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <string>
+
+#define log_e(format, ...) fprintf(stderr, "E: " format "\n", ##__VA_ARGS__)
+
+class String : public std::string {
+public:
+  String(const char *s = "") : std::string(s) {}
+  bool operator==(const char *s) const { return compare(s) == 0; }
+};
+
+class IPAddress {
+public:
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : _address{a, b, c, d} {}
+  IPAddress(const uint8_t *address) { memcpy(_address, address, 4); }
+  uint8_t operator[](int index) const { return _address[index]; }
+
+private:
+  uint8_t _address[4];
+};
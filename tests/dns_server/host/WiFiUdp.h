@@ -0,0 +1,41 @@
+// WiFiUDP that replays a query trace from memory and collects the replies
+#pragma once
+#include <Arduino.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+class WiFiUDP {
+public:
+  typedef std::function<void(const uint8_t *data, size_t len, IPAddress ip, uint16_t port)> PacketHandler;
+
+  const std::vector<std::string> *trace = nullptr;
+  size_t next = 0;
+  std::string *replies = nullptr;   // every reply, each preceded by its little endian 16 bit length
+  std::string packet;
+
+  uint8_t begin(uint16_t port) { return 1; }
+  void stop() {}
+  int recvBatch(PacketHandler handler, int max = 16)
+  {
+    int n = 0;
+    while (n < max && trace && next < trace->size()) {
+      // a copy, as the real receive buffer only holds the current packet
+      std::string query = (*trace)[next++];
+      handler((const uint8_t *)query.data(), query.size(), IPAddress(192, 168, 4, 2), 5353);
+      n++;
+    }
+    return n;
+  }
+  int beginPacket(const IPAddress &ip, uint16_t port) { packet.clear(); return 1; }
+  size_t write(const uint8_t *buffer, size_t size) { packet.append((const char *)buffer, size); return size; }
+  int endPacket()
+  {
+    if (replies) {
+      replies->push_back(packet.size() & 0xFF);
+      replies->push_back(packet.size() >> 8);
+      replies->append(packet);
+    }
+    return 1;
+  }
+};
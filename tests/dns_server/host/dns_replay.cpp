@@ -0,0 +1,45 @@
+// Replays a DNS query trace through DNSServer and writes the replies
+// usage: dns_replay <trace> <domain> <replies> [rounds]
+// The trace and the replies are packets preceded by their little endian 16 bit length.
+#include <DNSServer.h>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <stdlib.h>
+
+int main(int argc, char **argv)
+{
+  if (argc < 4) {
+    fprintf(stderr, "usage: %s <trace> <domain> <replies> [rounds]\n", argv[0]);
+    return 2;
+  }
+  std::ifstream in(argv[1], std::ios::binary);
+  std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  std::vector<std::string> trace;
+  for (size_t pos = 0; pos + 2 <= data.size();) {
+    size_t len = (uint8_t)data[pos] | (uint8_t)data[pos + 1] << 8;
+    trace.push_back(data.substr(pos + 2, len));
+    pos += 2 + len;
+  }
+  int rounds = argc > 4 ? atoi(argv[4]) : 1;
+
+  DNSServer dns;
+  if (!dns.start(53, argv[2], IPAddress(192, 168, 4, 1)))
+    return 1;
+  WiFiUDP &udp = *(WiFiUDP *)&dns;   // _udp is the first member
+  std::string replies;
+  udp.trace = &trace;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    udp.next = 0;
+    udp.replies = (r == 0) ? &replies : nullptr;
+    while (udp.next < trace.size())
+      dns.processRequests();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("%s %s: %zu queries x %d, %.3f us/query\n", argv[1], argv[2], trace.size(), rounds, seconds * 1e6 / ((double)rounds * trace.size()));
+
+  std::ofstream(argv[3], std::ios::binary) << replies;
+  return 0;
+}
@@ -0,0 +1,113 @@
+import hashlib
+import os
+import random
+import shutil
+import struct
+import subprocess
+
+import pytest
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.abspath(os.path.join(HERE, '..', '..'))
+DNS_SRC = os.path.join(ROOT, 'libraries', 'DNSServer', 'src')
+
+NAMES = ['connectivitycheck.gstatic.com', 'www.google.com', 'clients3.google.com', 'captive.apple.com',
+         'www.apple.com', 'www.msftconnecttest.com', 'dns.msftncsi.com', 'time.android.com',
+         'mtalk.google.com', 'graph.facebook.com', 'portal.local', 'www.portal.local',
+         'api.weather.com', 'play.googleapis.com', 'i.instagram.com', 'ocsp.digicert.com']
+
+# MD5 of the concatenated replies to the plain trace, recorded with the DNSServer that
+# copied every query into String objects, before queries were parsed in place
+PLAIN_REPLIES_MD5 = {
+    '*': '54f8bf35418b5bca80b497cf03b4866a',
+    'portal.local': '94dd2407f0bfddf5b508ec6c6527f6d1',
+}
+
+
+def test_dns_server(dut):
+    dut.expect_unity_test_output(timeout=120)
+
+
+def make_trace(count, edns_share, seed=1):
+    # captive portal probes of phones that just joined the AP, with 0x20 random casing
+    rnd = random.Random(seed)
+
+    def name(n):
+        out = b''
+        for label in n.split('.'):
+            label = ''.join(c.upper() if rnd.random() < 0.3 else c for c in label)
+            out += bytes([len(label)]) + label.encode()
+        return out + b'\0'
+
+    trace = []
+    for _ in range(count):
+        edns = rnd.random() < edns_share
+        qtype = rnd.choice([1, 1, 1, 28, 28, 65])
+        qname = rnd.choice(NAMES)
+        header = struct.pack('>HHHHHH', rnd.getrandbits(16), 0x0100, 1, 0, 0, 1 if edns else 0)
+        opt = b'\0' + struct.pack('>HHIH', 41, 1232, 0, 0) if edns else b''
+        trace.append((qname, header + name(qname) + struct.pack('>HH', qtype, 1) + opt))
+    return trace
+
+
+def write_packets(path, packets):
+    with open(path, 'wb') as f:
+        for p in packets:
+            f.write(struct.pack('<H', len(p)) + p)
+
+
+def read_packets(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    packets = []
+    pos = 0
+    while pos < len(data):
+        (length,) = struct.unpack_from('<H', data, pos)
+        packets.append(data[pos + 2:pos + 2 + length])
+        pos += 2 + length
+    return packets
+
+
+@pytest.fixture(scope='module')
+def dns_replay(tmp_path_factory):
+    cxx = shutil.which('g++') or shutil.which('c++')
+    if cxx is None:
+        pytest.skip('no host C++ compiler')
+    path = str(tmp_path_factory.mktemp('dns') / 'dns_replay')
+    subprocess.check_call([cxx, '-std=gnu++11', '-O2', '-I', os.path.join(HERE, 'host'), '-I', DNS_SRC,
+                           os.path.join(HERE, 'host', 'dns_replay.cpp'), os.path.join(DNS_SRC, 'DNSServer.cpp'),
+                           '-o', path])
+    return path
+
+
+def replay(dns_replay, tmp_path, trace, domain):
+    write_packets(str(tmp_path / 'trace.bin'), [query for _, query in trace])
+    output = subprocess.check_output([dns_replay, str(tmp_path / 'trace.bin'), domain, str(tmp_path / 'replies.bin'), '20'])
+    print(output.decode().strip())
+    replies = read_packets(str(tmp_path / 'replies.bin'))
+    assert len(replies) == len(trace)
+    return replies
+
+
+@pytest.mark.parametrize('domain', sorted(PLAIN_REPLIES_MD5))
+def test_dns_server_host_replay(dns_replay, tmp_path, domain):
+    # runs on the host: the replies to the plain trace are the ones the old DNSServer sent
+    replies = replay(dns_replay, tmp_path, make_trace(2000, 0), domain)
+    assert hashlib.md5(b''.join(replies)).hexdigest() == PLAIN_REPLIES_MD5[domain]
+
+
+def test_dns_server_host_replay_edns(dns_replay, tmp_path):
+    # queries with an EDNS OPT record get the same answer as plain ones, the old
+    # DNSServer replied NonExistentDomain to them
+    trace = make_trace(2000, 0.6)
+    replies = replay(dns_replay, tmp_path, trace, 'portal.local')
+    assert hashlib.md5(b''.join(replies)).hexdigest() == PLAIN_REPLIES_MD5['portal.local']
+    for (qname, query), reply in zip(trace, replies):
+        question = query[12:query.index(b'\0', 12) + 5]
+        if qname in ('portal.local', 'www.portal.local'):
+            assert reply[:2] == query[:2]
+            assert reply[2:12] == bytes([query[2] | 0x80, query[3]]) + struct.pack('>HHHH', 1, 1, 0, 0)
+            assert reply[12:] == question + struct.pack('>HHHIH', 0xC00C, 1, 1, 60, 4) + bytes([192, 168, 4, 1])
+        else:
+            # NonExistentDomain
+            assert reply == query[:2] + bytes([query[2] | 0x80, (query[3] & 0xF0) | 3]) + bytes(8)
@@ -0,0 +1,108 @@
+/* EEPROM test, nvs entries written per commit and the commit interval */
+#include <unity.h>
+#include <EEPROM.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+
+#define TEST_SIZE 4096    // 16 pages
+
+static size_t freeEntries(){
+  nvs_stats_t stats;
+  TEST_ASSERT_EQUAL(ESP_OK, nvs_get_stats(NULL, &stats));
+  return stats.free_entries;
+}
+
+// entries a commit() writes to nvs, rewritten entries are not freed until their nvs page is erased
+static size_t entriesWritten(){
+  size_t before = freeEntries();
+  TEST_ASSERT_TRUE(EEPROM.commit());
+  return before - freeEntries();
+}
+
+void setUp(){
+  nvs_flash_erase();
+  nvs_flash_init();
+  TEST_ASSERT_TRUE(EEPROM.begin(TEST_SIZE));
+  TEST_ASSERT_TRUE(EEPROM.commit());
+}
+
+void tearDown(){
+  EEPROM.setCommitInterval(0);
+  EEPROM.end();
+}
+
+void commit_bytes_test(){
+  // a whole rewrite stores every page
+  for(int i = 0; i < TEST_SIZE; i++){
+    EEPROM.write(i, i);
+  }
+  size_t full = entriesWritten();
+  Serial.printf("full rewrite: %u entries\n", full);
+
+  // one changed byte stores one page
+  EEPROM.write(1000, 0x55);
+  size_t single = entriesWritten();
+  Serial.printf("one byte: %u entries\n", single);
+  TEST_ASSERT_GREATER_THAN(0, single);
+  TEST_ASSERT_LESS_THAN(full / 8, single);
+
+  // unchanged data stores nothing
+  EEPROM.write(1000, 0x55);
+  TEST_ASSERT_EQUAL(0, entriesWritten());
+}
+
+void data_ptr_test(){
+  // getDataPtr() compares the pages with nvs, only the changed one is written
+  uint8_t *data = EEPROM.getDataPtr();
+  data[TEST_SIZE - 1] = 0x12;
+  size_t written = entriesWritten();
+  TEST_ASSERT_GREATER_THAN(0, written);
+  // the same as one changed byte
+  EEPROM.write(0, 0xAA);
+  TEST_ASSERT_EQUAL(entriesWritten(), written);
+}
+
+void commit_interval_test(){
+  // setUp() just wrote, within the interval commit() reports the changes as not written
+  EEPROM.setCommitInterval(60000);
+  EEPROM.write(10, 2);
+  size_t before = freeEntries();
+  TEST_ASSERT_FALSE(EEPROM.commit());
+  TEST_ASSERT_EQUAL(before, freeEntries());
+
+  // flush() always writes
+  TEST_ASSERT_TRUE(EEPROM.flush());
+  TEST_ASSERT_LESS_THAN(before, freeEntries());
+
+  EEPROM.end();
+  TEST_ASSERT_TRUE(EEPROM.begin(TEST_SIZE));
+  TEST_ASSERT_EQUAL(2, EEPROM.read(10));
+}
+
+void end_writes_test(){
+  EEPROM.setCommitInterval(60000);
+  EEPROM.write(20, 3);
+  TEST_ASSERT_FALSE(EEPROM.commit());
+
+  // end() writes the deferred changes
+  EEPROM.end();
+  TEST_ASSERT_TRUE(EEPROM.begin(TEST_SIZE));
+  TEST_ASSERT_EQUAL(3, EEPROM.read(20));
+}
+
+void setup(){
+  Serial.begin(115200);
+  while (!Serial) {
+    ;
+  }
+
+  UNITY_BEGIN();
+  RUN_TEST(commit_bytes_test);
+  RUN_TEST(data_ptr_test);
+  RUN_TEST(commit_interval_test);
+  RUN_TEST(end_writes_test);
+  UNITY_END();
+}
+
+void loop(){
+}
@@ -0,0 +1,76 @@
+/* SD CRC16 test, the sliced version against a bitwise reference */
+#include <unity.h>
+#include <SD.h>     // links the SD library
+
+extern "C" {
+    unsigned short CRC16(const char* data, int length);
+    unsigned short CRC16Update(unsigned short crc, const char* data, int length);
+}
+
+static char data[1024 + 8];
+
+static unsigned short crc16Reference(const char* buf, int length){
+  unsigned short crc = 0;
+  for(int i = 0; i < length; i++){
+    crc ^= (unsigned short)(uint8_t)buf[i] << 8;
+    for(int b = 0; b < 8; b++){
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+void crc16_known_test(){
+  // CRC-16/XMODEM check value
+  TEST_ASSERT_EQUAL_HEX16(0x31C3, CRC16("123456789", 9));
+  // 512 bytes of 0xFF, from the SD specification
+  memset(data, 0xFF, 512);
+  TEST_ASSERT_EQUAL_HEX16(0x7FA1, CRC16(data, 512));
+}
+
+void crc16_random_test(){
+  randomSeed(1);
+  for(int i = 0; i < sizeof(data); i++){
+    data[i] = random(256);
+  }
+  for(int i = 0; i < 500; i++){
+    int offset = random(8);
+    int length = random(1025);
+    TEST_ASSERT_EQUAL_HEX16(crc16Reference(data + offset, length), CRC16(data + offset, length));
+  }
+}
+
+void crc16_chunked_test(){
+  for(int i = 0; i < sizeof(data); i++){
+    data[i] = random(256);
+  }
+  unsigned short expected = CRC16(data, 512);
+  // same split as the SPI FIFO and a few odd ones
+  int chunks[] = { 64, 1, 3, 7, 13, 100 };
+  for(int c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++){
+    unsigned short crc = 0;
+    for(int pos = 0; pos < 512; pos += chunks[c]){
+      int n = (512 - pos < chunks[c]) ? 512 - pos : chunks[c];
+      crc = CRC16Update(crc, data + pos, n);
+    }
+    TEST_ASSERT_EQUAL_HEX16(expected, crc);
+  }
+}
+
+void setup(){
+
+  // Open serial communications and wait for port to open:
+  Serial.begin(115200);
+  while (!Serial) {
+    ;
+  }
+
+  UNITY_BEGIN();
+  RUN_TEST(crc16_known_test);
+  RUN_TEST(crc16_random_test);
+  RUN_TEST(crc16_chunked_test);
+  UNITY_END();
+}
+
+void loop(){
+}
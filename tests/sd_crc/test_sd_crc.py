@@ -0,0 +1,2 @@
+def test_sd_crc(dut):
+    dut.expect_unity_test_output(timeout=240)
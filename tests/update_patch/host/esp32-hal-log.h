@@ -0,0 +1,7 @@
+/* log macros of the core for building UpdatePatch.cpp on the host */
+#pragma once
+#include <stdio.h>
+#define log_e(format, ...) fprintf(stderr, "E: " format "\n", ##__VA_ARGS__)
+#define log_w(format, ...) fprintf(stderr, "W: " format "\n", ##__VA_ARGS__)
+#define log_d(format, ...)
+#define log_v(format, ...)
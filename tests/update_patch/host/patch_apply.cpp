@@ -0,0 +1,91 @@
+/*
+  Host side of the update patch round trip: applies a patch made by
+  tools/gen_update_patch.py with UpdatePatch, feeding it in chunks of
+  varying size as the network would.
+
+  patch_apply <source.bin> <patch.bin> <output.bin>
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "UpdatePatch.h"
+
+static bool readFile(const char *path, std::vector<uint8_t> &data){
+  FILE *f = fopen(path, "rb");
+  if(!f){
+    return false;
+  }
+  uint8_t buf[4096];
+  size_t n;
+  while((n = fread(buf, 1, sizeof(buf), f)) > 0){
+    data.insert(data.end(), buf, buf + n);
+  }
+  fclose(f);
+  return true;
+}
+
+// same as zlib's crc32(), which the patch header holds for the source
+static uint32_t crc32(const std::vector<uint8_t> &data){
+  uint32_t crc = 0xFFFFFFFF;
+  for(uint8_t b : data){
+    crc ^= b;
+    for(int i = 0; i < 8; i++){
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
+
+int main(int argc, char **argv){
+  if(argc != 4){
+    fprintf(stderr, "usage: %s <source.bin> <patch.bin> <output.bin>\n", argv[0]);
+    return 2;
+  }
+  std::vector<uint8_t> source, patch, target;
+  if(!readFile(argv[1], source) || !readFile(argv[2], patch)){
+    fprintf(stderr, "can not read input\n");
+    return 2;
+  }
+
+  bool headerOk = false;
+  UpdatePatch p(
+    [&](uint32_t offset, uint8_t *data, size_t len){
+      if(offset + len > source.size()){
+        return false;
+      }
+      memcpy(data, source.data() + offset, len);
+      return true;
+    },
+    [&](const uint8_t *data, size_t len){
+      target.insert(target.end(), data, data + len);
+      return true;
+    },
+    [&](uint32_t sourceSize, uint32_t sourceCrc, uint32_t targetSize){
+      headerOk = sourceSize == source.size() && sourceCrc == crc32(source);
+      return headerOk;
+    });
+
+  size_t pos = 0, step = 1;
+  while(pos < patch.size()){
+    size_t n = patch.size() - pos < step ? patch.size() - pos : step;
+    if(!p.write(patch.data() + pos, n)){
+      fprintf(stderr, "patch failed at %u\n", (unsigned)pos);
+      return 1;
+    }
+    pos += n;
+    step = step * 3 % 1461 + 1;
+  }
+  if(!headerOk || !p.isFinished() || target.size() != p.targetSize()){
+    fprintf(stderr, "patch incomplete\n");
+    return 1;
+  }
+
+  FILE *f = fopen(argv[3], "wb");
+  if(!f || fwrite(target.data(), 1, target.size(), f) != target.size()){
+    fprintf(stderr, "can not write %s\n", argv[3]);
+    return 2;
+  }
+  fclose(f);
+  return 0;
+}
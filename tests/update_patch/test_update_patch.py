@@ -0,0 +1,73 @@
+import hashlib
+import os
+import random
+import shutil
+import subprocess
+import sys
+
+import pytest
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.abspath(os.path.join(HERE, '..', '..'))
+UPDATE_SRC = os.path.join(ROOT, 'libraries', 'Update', 'src')
+
+
+def test_update_patch(dut):
+    dut.expect_unity_test_output(timeout=240)
+
+
+def make_images():
+    # image B is image A with the kind of changes a rebuild makes: inserted
+    # and removed code, moved blocks and shifted addresses
+    rnd = random.Random(1)
+    words = [bytes(rnd.getrandbits(8) for _ in range(4)) for _ in range(64)]
+    a = bytearray()
+    while len(a) < 128 * 1024:
+        a += words[rnd.randrange(len(words))] if rnd.random() < 0.7 else bytes([rnd.getrandbits(8)])
+    a = bytes(a)
+
+    b = bytearray(a[:20000])
+    b += bytes(rnd.getrandbits(8) for _ in range(3000))
+    shifted = bytearray(a[20000:60000])
+    for i in range(0, len(shifted), 32):
+        shifted[i] = (shifted[i] + 4) & 0xFF
+    b += shifted
+    b += a[90000:110000]
+    b += a[60000:90000]
+    b += a[115000:]
+    b += bytes(rnd.getrandbits(8) for _ in range(5000))
+    return a, bytes(b)
+
+
+def test_update_patch_host_roundtrip(tmp_path):
+    # runs on the host: a patch made by gen_update_patch.py, applied by UpdatePatch
+    cxx = shutil.which('g++') or shutil.which('c++')
+    if cxx is None:
+        pytest.skip('no host C++ compiler')
+
+    apply_bin = str(tmp_path / 'patch_apply')
+    subprocess.check_call([cxx, '-std=gnu++11', '-O1', '-I', os.path.join(HERE, 'host'), '-I', UPDATE_SRC,
+                           os.path.join(HERE, 'host', 'patch_apply.cpp'), os.path.join(UPDATE_SRC, 'UpdatePatch.cpp'),
+                           '-o', apply_bin])
+
+    a, b = make_images()
+    paths = {name: str(tmp_path / name) for name in ('a.bin', 'b.bin', 'patch.bin', 'out.bin')}
+    with open(paths['a.bin'], 'wb') as f:
+        f.write(a)
+    with open(paths['b.bin'], 'wb') as f:
+        f.write(b)
+
+    subprocess.check_call([sys.executable, os.path.join(ROOT, 'tools', 'gen_update_patch.py'),
+                           paths['a.bin'], paths['b.bin'], '-o', paths['patch.bin']])
+    assert os.path.getsize(paths['patch.bin']) < len(b) // 2
+
+    subprocess.check_call([apply_bin, paths['a.bin'], paths['patch.bin'], paths['out.bin']])
+    with open(paths['out.bin'], 'rb') as f:
+        out = f.read()
+    assert out == b
+    assert hashlib.md5(out).hexdigest() == hashlib.md5(b).hexdigest()
+
+    # a patch applied to a different source is rejected by the header check
+    with open(paths['a.bin'], 'wb') as f:
+        f.write(a[:-1] + bytes([a[-1] ^ 1]))
+    assert subprocess.call([apply_bin, paths['a.bin'], paths['patch.bin'], paths['out.bin']]) != 0
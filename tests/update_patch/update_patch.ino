@@ -0,0 +1,163 @@
+/* Update patch decoder test */
+#include <unity.h>
+#include <UpdatePatch.h>
+
+#define SOURCE_SIZE 2048
+
+static uint8_t source[SOURCE_SIZE];
+static uint8_t target[SOURCE_SIZE + 64];
+static uint8_t expected[SOURCE_SIZE + 64];
+static size_t targetLen;
+static size_t expectedLen;
+
+static uint8_t patch[1024];
+static size_t patchLen;
+
+static void putVarint(uint32_t value){
+  do {
+    uint8_t b = value & 0x7F;
+    value >>= 7;
+    patch[patchLen++] = value ? (b | 0x80) : b;
+  } while(value);
+}
+
+static void putLE32(uint32_t value){
+  for(int i = 0; i < 4; i++){
+    patch[patchLen++] = value >> (i * 8);
+  }
+}
+
+static bool readSource(uint32_t offset, uint8_t *data, size_t len){
+  if(offset + len > SOURCE_SIZE){
+    return false;
+  }
+  memcpy(data, source + offset, len);
+  return true;
+}
+
+static bool writeTarget(const uint8_t *data, size_t len){
+  memcpy(target + targetLen, data, len);
+  targetLen += len;
+  return true;
+}
+
+/*
+  target = source[0..500) + "hello" + source[500..1000) with every byte +1
+         + source[100..400) + source[1600..2048)
+*/
+static void buildPatch(){
+  patchLen = 0;
+  expectedLen = 0;
+
+  memcpy(patch, UPDATE_PATCH_MAGIC, 4);
+  patchLen = 4;
+  putLE32(SOURCE_SIZE);
+  putLE32(0);
+  putLE32(500 + 5 + 500 + 300 + 448);
+
+  putVarint(500 << 2 | 0);
+  memcpy(expected, source, 500);
+  expectedLen = 500;
+
+  putVarint(5 << 2 | 2);
+  memcpy(patch + patchLen, "hello", 5);
+  patchLen += 5;
+  memcpy(expected + expectedLen, "hello", 5);
+  expectedLen += 5;
+
+  putVarint(500 << 2 | 1);
+  for(int i = 0; i < 500; i++){
+    patch[patchLen++] = 1;
+    expected[expectedLen++] = source[500 + i] + 1;
+  }
+
+  // back from 1000 to 100
+  putVarint((899 << 1 | 1) << 2 | 3);
+  putVarint(300 << 2 | 0);
+  memcpy(expected + expectedLen, source + 100, 300);
+  expectedLen += 300;
+
+  // forward from 400 to 1600
+  putVarint((1200 << 1) << 2 | 3);
+  putVarint(448 << 2 | 0);
+  memcpy(expected + expectedLen, source + 1600, 448);
+  expectedLen += 448;
+}
+
+static bool applySplit(size_t step){
+  UpdatePatch p(readSource, writeTarget);
+  targetLen = 0;
+  for(size_t pos = 0; pos < patchLen; pos += step){
+    size_t n = (patchLen - pos < step) ? patchLen - pos : step;
+    if(!p.write(patch + pos, n)){
+      return false;
+    }
+  }
+  return p.isFinished() && !p.hasError();
+}
+
+void setUp(void){
+  for(int i = 0; i < SOURCE_SIZE; i++){
+    source[i] = (i * 7) ^ (i >> 3);
+  }
+  buildPatch();
+}
+
+void tearDown(void){
+}
+
+void patch_apply_test(void){
+  TEST_ASSERT_TRUE(applySplit(patchLen));
+  TEST_ASSERT_EQUAL(expectedLen, targetLen);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, target, expectedLen);
+}
+
+void patch_split_test(void){
+  TEST_ASSERT_TRUE(applySplit(1));
+  TEST_ASSERT_EQUAL(expectedLen, targetLen);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, target, expectedLen);
+
+  TEST_ASSERT_TRUE(applySplit(7));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, target, expectedLen);
+}
+
+void patch_error_test(void){
+  // wrong magic
+  patch[0] = 'X';
+  TEST_ASSERT_FALSE(applySplit(patchLen));
+  patch[0] = 'E';
+
+  // seek before the start of the source
+  UpdatePatch p(readSource, writeTarget);
+  targetLen = 0;
+  TEST_ASSERT_TRUE(p.write(patch, UPDATE_PATCH_HEADER_SIZE));
+  uint8_t seek[] = { ((1 << 1 | 1) << 2 | 3) };
+  TEST_ASSERT_FALSE(p.write(seek, sizeof(seek)));
+  TEST_ASSERT_TRUE(p.hasError());
+  TEST_ASSERT_FALSE(p.write(patch, 1));
+
+  // copy beyond the target size
+  UpdatePatch q(readSource, writeTarget);
+  targetLen = 0;
+  TEST_ASSERT_TRUE(q.write(patch, UPDATE_PATCH_HEADER_SIZE));
+  uint8_t copy[] = { 0x80 | 0, 0x40 };   // COPY 2048
+  TEST_ASSERT_FALSE(q.write(copy, sizeof(copy)));
+}
+
+void setup(){
+
+  // Open serial communications and wait for port to open:
+  Serial.begin(115200);
+  while (!Serial) {
+    ;
+  }
+
+  UNITY_BEGIN();
+  RUN_TEST(patch_apply_test);
+  RUN_TEST(patch_split_test);
+  RUN_TEST(patch_error_test);
+  UNITY_END();
+}
+
+void loop(){
+}
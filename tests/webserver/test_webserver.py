@@ -0,0 +1,2 @@
+def test_webserver(dut):
+    dut.expect_unity_test_output(timeout=60)
@@ -0,0 +1,91 @@
+/* WebServer connection handling test, the client connects to the soft AP address of the same device */
+#include <unity.h>
+#include <WiFi.h>
+#include <WebServer.h>
+
+#define KEEPALIVE_TIMEOUT 500
+
+WebServer server(80);
+
+// runs the server until the client has received the whole response or the timeout expires
+static String request(WiFiClient &client, const char *req, unsigned long timeout = 2000){
+  String response;
+  client.print(req);
+  unsigned long start = millis();
+  while(millis() - start < timeout && !response.endsWith("\r\n\r\nok")){
+    server.handleClient();
+    while(client.available()){
+      response += (char)client.read();
+    }
+  }
+  return response;
+}
+
+// runs the server for ms milliseconds, each handleClient() call has to return
+static void serve(unsigned long ms){
+  unsigned long start = millis();
+  while(millis() - start < ms){
+    server.handleClient();
+    delay(1);
+  }
+}
+
+void setUp(void){
+}
+
+void tearDown(void){
+}
+
+void keepalive_idle_test(void){
+  uint32_t timeouts = server.stats().timeouts;
+  WiFiClient client;
+  TEST_ASSERT_TRUE(client.connect(WiFi.softAPIP(), 80));
+  String response = request(client, "GET / HTTP/1.1\r\nHost: test\r\n\r\n");
+  TEST_ASSERT_TRUE(response.startsWith("HTTP/1.1 200"));
+  TEST_ASSERT_EQUAL(1, server.stats().activeConnections);
+
+  // a second request on the same connection
+  response = request(client, "GET / HTTP/1.1\r\nHost: test\r\n\r\n");
+  TEST_ASSERT_TRUE(response.startsWith("HTTP/1.1 200"));
+
+  // the client sends nothing more, the server closes the connection without counting a timeout
+  serve(KEEPALIVE_TIMEOUT + 500);
+  TEST_ASSERT_EQUAL(0, server.stats().activeConnections);
+  TEST_ASSERT_EQUAL(timeouts, server.stats().timeouts);
+  client.stop();
+}
+
+void disconnect_test(void){
+  WiFiClient client;
+  TEST_ASSERT_TRUE(client.connect(WiFi.softAPIP(), 80));
+  client.print("GET / HTTP/1.1\r\nHost: te");
+  serve(100);
+  TEST_ASSERT_EQUAL(1, server.stats().activeConnections);
+
+  // the peer goes away in the middle of the request headers
+  client.stop();
+  serve(200);
+  TEST_ASSERT_EQUAL(0, server.stats().activeConnections);
+}
+
+void setup(){
+  Serial.begin(115200);
+  while (!Serial) {
+    ;
+  }
+
+  WiFi.softAP("webserver-test");
+  server.on("/", [](){
+    server.send(200, "text/plain", "ok");
+  });
+  server.enableKeepAlive(true, KEEPALIVE_TIMEOUT);
+  server.begin();
+
+  UNITY_BEGIN();
+  RUN_TEST(keepalive_idle_test);
+  RUN_TEST(disconnect_test);
+  UNITY_END();
+}
+
+void loop(){
+}
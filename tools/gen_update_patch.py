@@ -0,0 +1,263 @@
+#!/usr/bin/env python
+#
+# Binary patch generator for the delta OTA mode of the Update library
+#
+# Creates a patch that rebuilds new.bin from old.bin, the firmware the device
+# is running. Upload the patch instead of new.bin with Update/HTTPUpdate, it is
+# detected by its header and applied against the running partition.
+#
+# The format is described in libraries/Update/src/UpdatePatch.h: a 16 byte
+# header ("ESPD", source size, source CRC32, target size) and a stream of
+# COPY / ADD / INSERT / SEEK operations. Matches are found bsdiff style, a
+# matching region may contain a few changed bytes (e.g. moved addresses),
+# those are stored as byte differences that are mostly zero.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+from __future__ import print_function
+
+import argparse
+import struct
+import sys
+import zlib
+
+MAGIC = b'ESPD'
+
+OP_COPY = 0
+OP_ADD = 1
+OP_INSERT = 2
+OP_SEEK = 3
+
+SEED_SIZE = 8           # bytes hashed to find match candidates
+SEED_STEP = 4           # source positions indexed
+MAX_CANDIDATES = 16     # positions kept per seed
+MIN_MATCH = 12          # shorter exact matches are stored as literals
+MAX_LOSS = 16           # mismatches more than matches ends a region
+MIN_ZERO_RUN = 8        # shorter unchanged runs stay inside an ADD
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        b = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(b | 0x80)
+        else:
+            out.append(b)
+            return out
+
+
+def op(code, value):
+    return varint((value << 2) | code)
+
+
+def build_index(src):
+    index = {}
+    for pos in range(0, len(src) - SEED_SIZE + 1, SEED_STEP):
+        positions = index.setdefault(src[pos:pos + SEED_SIZE], [])
+        if len(positions) < MAX_CANDIDATES:
+            positions.append(pos)
+    return index
+
+
+def match_length(src, s, dst, t):
+    # exact match length, compared in growing slices
+    length = 0
+    step = 16
+    limit = min(len(src) - s, len(dst) - t)
+    while length < limit:
+        n = min(step, limit - length)
+        if src[s + length:s + length + n] == dst[t + length:t + length + n]:
+            length += n
+            step = min(step * 2, 4096)
+        elif n > 1:
+            step = max(n // 2, 1)
+        else:
+            break
+    return length
+
+
+def extend_forward(src, s, dst, t, length):
+    # carry on past mismatches while matches still outweigh them
+    limit = min(len(src) - s, len(dst) - t)
+    best = length
+    score = 0
+    best_score = 0
+    i = length
+    while i < limit:
+        if src[s + i] == dst[t + i]:
+            run = match_length(src, s + i, dst, t + i)
+            score += run
+            i += run
+            if score > best_score:
+                best_score = score
+                best = i
+        else:
+            score -= 1
+            i += 1
+            if score < best_score - MAX_LOSS:
+                break
+    return best
+
+
+def find_match(index, src, dst, t, expected):
+    # prefer the source position that continues the previous match, no SEEK needed
+    best_pos = -1
+    best_len = 0
+    if 0 <= expected < len(src):
+        best_len = match_length(src, expected, dst, t)
+        best_pos = expected
+    for pos in index.get(dst[t:t + SEED_SIZE], ()):
+        length = match_length(src, pos, dst, t)
+        if length > best_len:
+            best_pos = pos
+            best_len = length
+    return best_pos, best_len
+
+
+def encode_region(src, s, dst, t, length):
+    out = bytearray()
+    delta = bytearray((dst[t + i] - src[s + i]) & 0xFF for i in range(length))
+    i = 0
+    while i < length:
+        # unchanged run
+        j = i
+        while j < length and not delta[j]:
+            j += 1
+        if j - i >= MIN_ZERO_RUN or j == length:
+            if j > i:
+                out += op(OP_COPY, j - i)
+            i = j
+            continue
+        # changed bytes up to the next long enough unchanged run
+        j = i
+        while j < length:
+            if delta[j]:
+                j += 1
+                continue
+            k = j
+            while k < length and not delta[k]:
+                k += 1
+            if k - j >= MIN_ZERO_RUN or k == length:
+                break
+            j = k
+        out += op(OP_ADD, j - i)
+        out += delta[i:j]
+        i = j
+    return out
+
+
+def diff(src, dst):
+    out = bytearray(struct.pack('<4sIII', MAGIC, len(src), zlib.crc32(src) & 0xFFFFFFFF, len(dst)))
+    index = build_index(src)
+    spos = 0        # decoder source position
+    literal = 0     # start of the pending INSERT
+    t = 0
+    while t + SEED_SIZE <= len(dst):
+        s, length = find_match(index, src, dst, t, spos + t - literal)
+        if length < MIN_MATCH:
+            t += 1
+            continue
+        # grow backwards into the pending literals
+        back = 0
+        while back < t - literal and back < s and src[s - back - 1] == dst[t - back - 1]:
+            back += 1
+        s -= back
+        t -= back
+        length = extend_forward(src, s, dst, t, length + back)
+
+        if t > literal:
+            out += op(OP_INSERT, t - literal)
+            out += dst[literal:t]
+        if s != spos:
+            move = s - spos
+            out += op(OP_SEEK, (move << 1) if move >= 0 else (((-move - 1) << 1) | 1))
+        out += encode_region(src, s, dst, t, length)
+        spos = s + length
+        t += length
+        literal = t
+    if literal < len(dst):
+        out += op(OP_INSERT, len(dst) - literal)
+        out += dst[literal:]
+    return bytes(out)
+
+
+def read_varint(patch, pos):
+    value = 0
+    shift = 0
+    while True:
+        b = patch[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return value, pos
+
+
+def apply(src, patch):
+    magic, source_size, source_crc, target_size = struct.unpack_from('<4sIII', patch)
+    if magic != MAGIC or source_size != len(src) or source_crc != zlib.crc32(src) & 0xFFFFFFFF:
+        raise ValueError('patch does not match the source')
+    out = bytearray()
+    spos = 0
+    pos = 16
+    while len(out) < target_size:
+        value, pos = read_varint(patch, pos)
+        code = value & 3
+        arg = value >> 2
+        if code == OP_COPY:
+            out += src[spos:spos + arg]
+            spos += arg
+        elif code == OP_ADD:
+            out += bytearray((src[spos + i] + patch[pos + i]) & 0xFF for i in range(arg))
+            spos += arg
+            pos += arg
+        elif code == OP_INSERT:
+            out += patch[pos:pos + arg]
+            pos += arg
+        else:
+            spos += -((arg >> 1) + 1) if arg & 1 else arg >> 1
+    if pos != len(patch) or len(out) != target_size:
+        raise ValueError('bad patch length')
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Creates a patch for the delta OTA mode of the Update library')
+    parser.add_argument('source', help='firmware running on the device (.bin)')
+    parser.add_argument('target', help='new firmware (.bin)')
+    parser.add_argument('-o', '--output', required=True, help='patch file to write')
+    parser.add_argument('--verify', action='store_true', help='apply the patch afterwards and compare')
+    args = parser.parse_args()
+
+    with open(args.source, 'rb') as f:
+        src = f.read()
+    with open(args.target, 'rb') as f:
+        dst = f.read()
+
+    patch = diff(src, dst)
+    with open(args.output, 'wb') as f:
+        f.write(patch)
+    print('%s: %d bytes, %.1f%% of %d' % (args.output, len(patch), 100.0 * len(patch) / max(len(dst), 1), len(dst)))
+
+    if args.verify:
+        if apply(src, patch) != dst:
+            print('verify failed', file=sys.stderr)
+            return 1
+        print('verify ok')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())